@@ -0,0 +1,251 @@
+#include "BrutHeaders.h"
+#include "ROOTSchema.h"
+#include "CompressionHelpers.h"
+#include "HashHelpers.h"
+#include "GeneratorHelpers.h"
+#include "RootFile.h"
+#include <stdint.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/** Benchmarks of the hot paths of brut, and of a few commands on whole
+    files, to catch performance regressions.
+
+        brut_bench [--filter=<substring>] [--min-time=<seconds>]
+                   [--brut=<brut-executable>] [--file=<root-file>]
+
+    Each benchmark is run for at least the given time (0.5s by default) and
+    prints one JSON object per line on stdout: its name, the number of
+    iterations, the time per iteration in ns and, where it applies, the
+    throughput in MB/s. Anything the benchmarked code prints goes to
+    /dev/null. The end to end benchmarks run the brut executable (by default
+    the one next to brut_bench) on the given file or, if there is none, on
+    a synthetic one written with the defaults of brut_gen, and compare it
+    with hashing the file in process with libbrut.
+  */
+
+// A key for the TObjString "name" at offset 100, with a 40 bytes object.
+constexpr char key[] = {
+  0, 0, 0, 104,           // Nbytes
+  0, 4,                   // Version
+  0, 0, 0, 40,            // ObjLen
+  0x5b, 0x1c, 0x1a, 0x2e, // Datetime
+  0, 64,                  // KeyLen
+  0, 1,                   // Cycle
+  0, 0, 0, 100,           // SeekKey
+  0, 0, 0, 0,             // SeekPdir
+  10, 'T', 'O', 'b', 'j', 'S', 't', 'r', 'i', 'n', 'g',
+  4, 'n', 'a', 'm', 'e',
+  11, 'a', ' ', 'T', 'O', 'b', 'j', 'S', 't', 'r', 'i', 'n', 'g'
+};
+
+FILE *results = stdout;
+char const *filter = "";
+double minTime = 0.5;
+// Where the results of the benchmarked code go, so that it is not
+// optimised away.
+volatile uint64_t sink;
+
+/** Run @a func until it took at least minTime, doubling the number of
+    iterations each time, and report the time per iteration of the last
+    run. @a bytes is the number of bytes processed by each iteration.
+  */
+template <class F>
+void bench(char const *name, size_t bytes, F const &func)
+{
+  if (!strstr(name, filter))
+    return;
+  double elapsed = 0;
+  size_t iterations = 1;
+  for (;; iterations *= 2)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+      func();
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (elapsed >= minTime)
+      break;
+  }
+  fprintf(results, "{\"benchmark\": \"%s\", \"iterations\": %lu, \"ns\": %.3f", name, iterations,
+          elapsed / iterations * 1e9);
+  if (bytes)
+    fprintf(results, ", \"MBps\": %.3f", bytes * iterations / elapsed / (1 << 20));
+  fprintf(results, "}\n");
+  fflush(results);
+}
+
+/** Run @a brut with @a command on @a file, with its output to /dev/null.
+    @return false if it could not be run or failed.
+  */
+bool runBrut(std::string const &brut, std::string const &command, std::string const &file)
+{
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, 1);
+    dup2(devNull, 2);
+    execl(brut.c_str(), brut.c_str(), "-c", command.c_str(), file.c_str(), (char *) 0);
+    _exit(127);
+  }
+  int status = 0;
+  return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Data which compresses about as well as physics payloads.
+void makeData(std::vector<unsigned char> &data, size_t size)
+{
+  data.resize(size);
+  uint64_t state = 1;
+  for (size_t i = 0; i < size; i += 4)
+  {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    float value = 100.f + (state >> 40) % 1000 / 10.f;
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    bits = bswap_32(bits);
+    memcpy(&data[i], &bits, std::min((size_t) 4, size - i));
+  }
+}
+
+// Compress @a data as a single ROOT chunk, with zlib or lzma.
+void makeChunk(std::vector<unsigned char> const &data, bool lzma, std::vector<unsigned char> &chunk)
+{
+  std::vector<unsigned char> zip(compressBound(data.size()) + lzma_stream_buffer_bound(data.size()));
+  size_t zipSize = zip.size();
+  if (lzma)
+  {
+    zipSize = 0;
+    if (lzma_easy_buffer_encode(1, LZMA_CHECK_CRC32, 0, &data[0], data.size(), &zip[0], &zipSize, zip.size()) != LZMA_OK)
+      abort();
+  }
+  else
+  {
+    uLongf size = zip.size();
+    if (compress(&zip[0], &size, &data[0], data.size()) != Z_OK)
+      abort();
+    zipSize = size;
+  }
+  unsigned char header[9] = {(unsigned char) (lzma ? 'X' : 'Z'), (unsigned char) (lzma ? 'Z' : 'L'),
+                             (unsigned char) (lzma ? 0 : Z_DEFLATED),
+                             (unsigned char) zipSize, (unsigned char) (zipSize >> 8), (unsigned char) (zipSize >> 16),
+                             (unsigned char) data.size(), (unsigned char) (data.size() >> 8),
+                             (unsigned char) (data.size() >> 16)};
+  chunk.assign(header, header + 9);
+  chunk.insert(chunk.end(), zip.begin(), zip.begin() + zipSize);
+}
+
+int
+main(int argc, char **argv)
+{
+  std::string brut = argv[0];
+  brut = brut.substr(0, brut.rfind('/') + 1) + "brut";
+  std::string file;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strncmp(argv[i], "--filter=", 9) == 0)
+      filter = argv[i] + 9;
+    else if (strncmp(argv[i], "--min-time=", 11) == 0)
+      minTime = atof(argv[i] + 11);
+    else if (strncmp(argv[i], "--brut=", 7) == 0)
+      brut = argv[i] + 7;
+    else if (strncmp(argv[i], "--file=", 7) == 0)
+      file = argv[i] + 7;
+    else
+    {
+      fprintf(stderr, "Syntax: brut_bench [--filter=<substring>] [--min-time=<seconds>] "
+                      "[--brut=<brut-executable>] [--file=<root-file>]\n");
+      return 1;
+    }
+  }
+  // Results go to the original stdout, everything else to /dev/null.
+  results = fdopen(dup(1), "w");
+  if (!results || !freopen("/dev/null", "w", stdout))
+    return 1;
+
+  bench("getInt/keyHeaderSpec/ObjLen", 0, [] { sink += getInt(keyHeaderSpec, key, "ObjLen"); });
+  bench("getShort/keyHeaderSpec/Cycle", 0, [] { sink += getShort(keyHeaderSpec, key, "Cycle"); });
+  bench("getString/keyHeaderSpec/Title", 0, [] { sink += *getString(keyHeaderSpec, key, "Title.value"); });
+  bench("specRealSize/keyHeaderSpec", 0, [] { sink += specRealSize(keyHeaderSpec, key); });
+  bench("printBuf/keyHeaderSpec", 0, [] { printBuf(keyHeaderSpec, key); });
+
+  std::vector<unsigned char> data;
+  makeData(data, 1 << 20);
+  bench("dump_hex/4kB", 4096, [&] { sink += dump_hex((char const *) &data[0], 4096, 0); });
+  bench("sha1/1MB", data.size(), [&] {
+    unsigned char digest[SHA1_SIZE];
+    sha1(&data[0], data.size(), digest);
+    sink += digest[0];
+  });
+  std::vector<unsigned char> output(data.size());
+  for (int lzma = 0; lzma < 2; ++lzma)
+  {
+    std::vector<unsigned char> chunk;
+    makeChunk(data, lzma, chunk);
+    uncompressObject(&output[0], output.size(), &chunk[0], chunk.size());
+    if (output != data)
+      abort();
+    bench(lzma ? "uncompress/lzma/1MB" : "uncompress/zlib/1MB", data.size(), [&] {
+      sink += uncompressObject(&output[0], output.size(), &chunk[0], chunk.size());
+    });
+  }
+
+  char generated[] = "/tmp/brut_bench_fileXXXXXX";
+  if (file.empty())
+  {
+    MerkleTree manifest;
+    int generatedFd = mkstemp(generated);
+    if (generatedFd < 0)
+      return 1;
+    close(generatedFd);
+    if (!generateFile(generated, generatorDefaults, manifest))
+    {
+      fprintf(stderr, "Unable to write %s.\n", generated);
+      unlink(generated);
+      return 1;
+    }
+    file = generated;
+  }
+  off_t size = 0;
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd >= 0)
+  {
+    size = lseek(fd, 0, SEEK_END);
+    close(fd);
+  }
+  char listing[] = "/tmp/brut_benchXXXXXX";
+  int listingFd = mkstemp(listing);
+  if (listingFd < 0)
+    return 1;
+  close(listingFd);
+  if (!runBrut(brut, "listkeys", file)
+      || system((brut + " -c listmerkle '" + file + "' > " + listing).c_str()) != 0)
+  {
+    fprintf(stderr, "Unable to run %s on %s.\n", brut.c_str(), file.c_str());
+    unlink(listing);
+    if (file == generated)
+      unlink(generated);
+    return 1;
+  }
+  bench("brut/listkeys", size, [&] { sink += runBrut(brut, "listkeys", file); });
+  bench("brut/listhashes", size, [&] { sink += runBrut(brut, "listhashes", file); });
+  bench("brut/comparemerkle", size, [&] { sink += runBrut(brut, std::string("comparemerkle ") + listing, file); });
+  // The same work as listhashes, in process with libbrut.
+  bench("libbrut/hash", size, [&] {
+    brut::RootFile rootFile;
+    if (!rootFile.open(file.c_str()))
+      abort();
+    rootFile.hash([](brut::Key const &, unsigned char const *digest) { sink += digest ? digest[0] : 0; });
+  });
+  unlink(listing);
+  if (file == generated)
+    unlink(generated);
+  return 0;
+}
@@ -0,0 +1,491 @@
+#ifndef __BASKET_HELPERS_H
+#define __BASKET_HELPERS_H
+#include "BrutHeaders.h"
+#include "ROOTSchema.h"
+#include "CompressionHelpers.h"
+#include "StatsHelpers.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+#include <unistd.h>
+
+/** Returns the TString @a label ("ClassName", "Name" or "Title") of the key
+    header in @a buffer.
+  */
+inline std::string keyString(char const *buffer, char const *label)
+{
+  std::string field(label);
+  return std::string(getString(keyHeaderSpec, buffer, (field + ".value").c_str()),
+                     (unsigned char) getChar(keyHeaderSpec, buffer, (field + ".size").c_str()));
+}
+
+inline bool keyClassIs(char const *className, char const *buffer)
+{
+  return keyString(buffer, "ClassName") == className;
+}
+
+/** The TBasket header (see basketHeaderSpec) starts right after the key Title. */
+inline char const *basketHeader(char const *buffer)
+{
+  return getString(keyHeaderSpec, buffer, "Title.value")
+         + (unsigned char) getChar(keyHeaderSpec, buffer, "Title.size");
+}
+
+/** What we need to know about a basket to process it without looking at the
+    file again.
+
+    - @a seekKey    position of the key in the file.
+    - @a branch     index of the branch in BasketScan::branches.
+    - @a nbytes     size of the key on disk, including the header.
+    - @a objLen     size of the uncompressed payload.
+    - @a keyLen     size of the key header, including the TBasket one.
+    - @a nevBuf     number of entries in the basket.
+    - @a nevBufSize size of an entry, for fixed size entries.
+    - @a last       end of the entries data, relative to the beginning of the
+                    key. Whatever follows, up to objLen, is the entry offsets
+                    array.
+  */
+struct BasketInfo {
+  size_t    seekKey;
+  size_t    branch;
+  unsigned  nbytes;
+  unsigned  objLen;
+  unsigned  keyLen;
+  int       nevBuf;
+  int       nevBufSize;
+  int       last;
+};
+
+/** Size of the entries data in the uncompressed payload of @a basket, i.e.
+    without the entry offsets array.
+  */
+inline size_t basketDataSize(BasketInfo const &basket)
+{
+  size_t dataSize = basket.last > (int) basket.keyLen ? basket.last - basket.keyLen : 0;
+  return dataSize && dataSize < basket.objLen ? dataSize : basket.objLen;
+}
+
+/** The baskets found while walking the keys of a file, grouped by branch.
+
+    - @a selection  the branches to consider, either as "branch" or as
+                    "tree/branch". All of them if empty.
+    - @a branches   the branches found, as "tree/branch".
+    - @a baskets    the baskets found, in file order. Baskets of a given
+                    branch are written as they get filled, so this is also
+                    their entry order.
+    - @a options    what follows the ':' of the branches in the selection,
+                    by branch as given in the selection, e.g. their type for
+                    export.
+    - @a argument   the argument of the command, if any: e.g. the listing to
+                    compare the results against.
+  */
+struct BasketScan {
+  std::vector<std::string>      selection;
+  std::vector<std::string>      branches;
+  std::map<std::string, size_t> branchIds;
+  std::vector<BasketInfo>       baskets;
+  std::map<std::string, std::string> options;
+  std::string                   argument;
+
+  void clear()
+  {
+    selection.clear();
+    branches.clear();
+    branchIds.clear();
+    baskets.clear();
+    options.clear();
+    argument.clear();
+  }
+
+  bool selected(std::string const &tree, std::string const &branch) const
+  {
+    if (selection.empty())
+      return true;
+    for (size_t i = 0; i < selection.size(); ++i)
+      if (selection[i] == branch || selection[i] == tree + "/" + branch)
+        return true;
+    return false;
+  }
+
+  // Same as above, for a "tree/branch" name, optionally followed by
+  // ":<something>" (e.g. the entry number).
+  bool selected(std::string const &name) const
+  {
+    std::string branch = name.substr(0, name.find(':'));
+    size_t slash = branch.find('/');
+    if (slash == std::string::npos)
+      return selected(std::string(), branch);
+    return selected(branch.substr(0, slash), branch.substr(slash + 1));
+  }
+
+  // The option given for the "tree/branch" @a name, either as "tree/branch"
+  // or as "branch", or an empty string.
+  std::string option(std::string const &name) const
+  {
+    std::map<std::string, std::string>::const_iterator i = options.find(name);
+    if (i == options.end())
+      i = options.find(name.substr(name.find('/') + 1));
+    return i == options.end() ? std::string() : i->second;
+  }
+
+  size_t branchId(std::string const &name)
+  {
+    std::map<std::string, size_t>::const_iterator i = branchIds.find(name);
+    if (i != branchIds.end())
+      return i->second;
+    branches.push_back(name);
+    return branchIds[name] = branches.size() - 1;
+  }
+};
+
+/** Find the entries in the uncompressed @a payload of @a basket and store
+    their [begin, end) ranges, relative to @a payload, in @a entries.
+
+    Entries are either fixed size, in which case fNevBufSize is their size,
+    or their (big endian) offsets, relative to the beginning of the key,
+    are stored in an array following the entries data. As written by
+    TBuffer::WriteArray the array is prefixed by its size, fNevBuf + 1.
+
+    @return false if the offsets do not fit in the payload.
+  */
+inline bool basketEntries(BasketInfo const &basket, char const *payload,
+                   std::vector<std::pair<size_t, size_t> > &entries)
+{
+  entries.clear();
+  if (basket.nevBuf <= 0)
+    return true;
+  size_t dataSize = basketDataSize(basket);
+  size_t nevBuf = basket.nevBuf;
+  if (dataSize == basket.objLen)
+  {
+    size_t entrySize = basket.nevBufSize;
+    if (entrySize * nevBuf > dataSize)
+      return false;
+    for (size_t i = 0; i < nevBuf; ++i)
+      entries.push_back(std::make_pair(i * entrySize, (i + 1) * entrySize));
+    return true;
+  }
+
+  if (dataSize + 4 * (nevBuf + 1) > basket.objLen)
+    return false;
+  char const *offsets = payload + dataSize + 4;
+  size_t begin = 0;
+  for (size_t i = 0; i < nevBuf; ++i)
+  {
+    unsigned int offset;
+    memcpy(&offset, offsets + 4 * i, 4);
+    offset = bswap_32(offset);
+    if (offset < basket.keyLen + begin || offset - basket.keyLen > dataSize)
+      return false;
+    if (i)
+      entries.push_back(std::make_pair(begin, (size_t) offset - basket.keyLen));
+    begin = offset - basket.keyLen;
+  }
+  entries.push_back(std::make_pair(begin, dataSize));
+  return true;
+}
+
+/** Record the basket whose key header is in @a buffer, at @a pos in the file,
+    if it belongs to one of the selected branches.
+
+    @return false if the key is not a TBasket or it was not selected.
+  */
+inline bool addBasket(BasketScan &scan, char const *buffer, size_t pos)
+{
+  if (!keyClassIs("TBasket", buffer))
+    return false;
+  std::string tree = keyString(buffer, "Title");
+  std::string branch = keyString(buffer, "Name");
+  if (!scan.selected(tree, branch))
+    return false;
+
+  char const *header = basketHeader(buffer);
+  BasketInfo basket;
+  basket.seekKey = pos;
+  basket.branch = scan.branchId(tree + "/" + branch);
+  basket.nbytes = getInt(keyHeaderSpec, buffer, "Nbytes");
+  basket.objLen = getInt(keyHeaderSpec, buffer, "ObjLen");
+  basket.keyLen = (unsigned short) getShort(keyHeaderSpec, buffer, "KeyLen");
+  basket.nevBuf = getInt(basketHeaderSpec, header, "fNevBuf");
+  basket.nevBufSize = getInt(basketHeaderSpec, header, "fNevBufSize");
+  basket.last = getInt(basketHeaderSpec, header, "fLast");
+  scan.baskets.push_back(basket);
+  return true;
+}
+
+/** pread exactly @a size bytes at @a offset of @a fd.
+  */
+inline bool preadAll(int fd, char *buffer, size_t size, size_t offset)
+{
+  TraceSpan span("read", offset);
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t n = pread(fd, buffer + done, size - done, offset + done);
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  statsAdd(STAT_BYTES_READ, size);
+  return true;
+}
+
+/** Read the payload of the object whose key is at @a seekKey into @a output,
+    decompressing it if needed. @a output must be @a objLen bytes long,
+    @a scratch is used to hold the compressed payload.
+
+    This only uses pread on @a fd, so it can be called from many threads.
+
+    @return false in case of read or decompression errors.
+  */
+inline bool readObject(int fd, size_t seekKey, unsigned keyLen, unsigned nbytes,
+                unsigned objLen, std::vector<char> &scratch, char *output)
+{
+  if (nbytes < keyLen)
+    return false;
+  size_t size = nbytes - keyLen;
+  // Uncompressed objects are read in place.
+  if (size == objLen)
+    return preadAll(fd, output, size, seekKey + keyLen);
+  scratch.resize(size);
+  if (!preadAll(fd, &scratch[0], size, seekKey + keyLen))
+    return false;
+  return uncompressObject((unsigned char *) output, objLen,
+                          (unsigned char *) &scratch[0], size) == 0;
+}
+
+/** Read the payload of the object whose key is at @a seekKey like
+    readObject, but hand it to @a sink, as sink(data, size), in pieces of
+    at most 16MB, one per compressed chunk, as they are decompressed. Only
+    one compressed chunk, in @a scratch, and its uncompressed bytes, in
+    @a piece, are in memory at a time, whatever the size of the object.
+
+    @return false in case of read or decompression errors, possibly after
+            some pieces were given to @a sink.
+  */
+template <class Sink>
+bool streamObject(int fd, size_t seekKey, unsigned keyLen, unsigned nbytes, unsigned objLen,
+                  std::vector<char> &scratch, std::vector<char> &piece, Sink sink)
+{
+  constexpr size_t uncompressedPieceSize = 1 << 24;
+  if (nbytes < keyLen)
+    return false;
+  size_t size = nbytes - keyLen;
+  size_t begin = seekKey + keyLen;
+  if (size == objLen)
+  {
+    for (size_t done = 0; done < size; done += piece.size())
+    {
+      piece.resize(std::min(size - done, uncompressedPieceSize));
+      if (!preadAll(fd, &piece[0], piece.size(), begin + done))
+        return false;
+      sink(&piece[0], piece.size());
+    }
+    return true;
+  }
+  size_t in = 0;
+  for (size_t out = 0; out < objLen;)
+  {
+    unsigned char header[compressedChunkHeaderSize];
+    if (in + sizeof(header) > size || !preadAll(fd, (char *) header, sizeof(header), begin + in))
+      return false;
+    CompressorFunc compressor = getCompressorFor(compressorSpecs, header);
+    size_t chunkIn, chunkOut;
+    compressedChunkSizes(header, chunkIn, chunkOut);
+    if (!compressor || in + sizeof(header) + chunkIn > size || out + chunkOut > objLen)
+      return false;
+    scratch.resize(sizeof(header) + chunkIn);
+    piece.resize(chunkOut + 1);
+    if (!preadAll(fd, &scratch[0], scratch.size(), begin + in))
+      return false;
+    int result = compressor((unsigned char *) &piece[0], chunkOut, (unsigned char *) &scratch[0], scratch.size());
+    if (result != 0 && result != 1)
+      return false;
+    sink(&piece[0], chunkOut);
+    in += scratch.size();
+    out += chunkOut;
+  }
+  return true;
+}
+
+inline bool readBasket(int fd, BasketInfo const &basket, std::vector<char> &scratch, char *output)
+{
+  return readObject(fd, basket.seekKey, basket.keyLen, basket.nbytes,
+                    basket.objLen, scratch, output);
+}
+
+/** What we need to know about any key to read its object without looking at
+    the file again.
+
+    - @a seekPdir    position of the key of the directory holding it.
+    - @a compression the first 3 bytes of the header of its first
+                     compressed chunk (e.g. "ZL\x08"), all 0 if the object
+                     is not compressed.
+  */
+struct KeyInfo {
+  size_t      seekKey;
+  size_t      seekPdir;
+  unsigned    nbytes;
+  unsigned    objLen;
+  unsigned    keyLen;
+  short       cycle;
+  std::string className;
+  std::string name;
+  std::string title;
+  char        compression[3];
+};
+
+/** Read the header of the key at @a pos of the file @a fd in @a key.
+
+    @return the Nbytes of the key, which is negative for the gaps left by
+            deleted objects, or 0 if there is no valid key at @a pos.
+  */
+inline int readKeyInfo(int fd, size_t pos, KeyInfo &key)
+{
+  char header[1024];
+  TraceSpan span("read key", pos);
+  ssize_t size = pread(fd, header, sizeof(header), pos);
+  if (size < 4)
+    return 0;
+  statsAdd(STAT_BYTES_READ, size);
+  int nbytes = getInt(keyHeaderSpec, header, "Nbytes");
+  if (nbytes <= 0)
+    return nbytes;
+  if (size < 18)
+    return 0;
+  key.seekKey = getShort(keyHeaderSpec, header, "Version") > 1000 ? getInt64(keyHeaderSpec, header, "SeekKey")
+                                                                  : getInt(keyHeaderSpec, header, "SeekKey");
+  key.seekPdir = getShort(keyHeaderSpec, header, "Version") > 1000 ? getInt64(keyHeaderSpec, header, "SeekPdir")
+                                                                   : getInt(keyHeaderSpec, header, "SeekPdir");
+  if (key.seekKey != pos)
+    return 0;
+  statsAdd(STAT_KEYS_VISITED, 1);
+  key.nbytes = nbytes;
+  key.objLen = getInt(keyHeaderSpec, header, "ObjLen");
+  key.keyLen = (unsigned short) getShort(keyHeaderSpec, header, "KeyLen");
+  key.cycle = getShort(keyHeaderSpec, header, "Cycle");
+  key.className = keyString(header, "ClassName");
+  key.name = keyString(header, "Name");
+  key.title = keyString(header, "Title");
+  memset(key.compression, 0, sizeof(key.compression));
+  if (key.nbytes - key.keyLen != key.objLen && key.nbytes >= key.keyLen + 9)
+  {
+    if (key.keyLen + 3 <= size)
+      memcpy(key.compression, header + key.keyLen, 3);
+    else if (pread(fd, key.compression, 3, pos + key.keyLen) != 3)
+      return 0;
+  }
+  return nbytes;
+}
+
+// The position @a label (fEND, fSeekFree or fSeekInfo) of the file header
+// @a header, which has 8 bytes in files larger than 2GB.
+inline size_t fileHeaderSeek(char const *header, char const *label)
+{
+  return getInt(fileHeaderSpec, header, "fVersion") >= 1000000 ? getInt64(fileHeaderSpec, header, label)
+                                                                : getInt(fileHeaderSpec, header, label);
+}
+
+// Sizes of the file header, up to its fUUID, with 4 or 8 bytes positions.
+size_t const fileHeaderSmallSize = 63;
+size_t const fileHeaderBigSize = 75;
+
+/** Read the file header of @a fd in @a header, which has room for at least
+    fileHeaderBigSize bytes.
+
+    @return the size of the header, or 0 if it could not be read.
+  */
+inline size_t readFileHeader(int fd, char *header)
+{
+  if (!preadAll(fd, header, fileHeaderSmallSize, 0))
+    return 0;
+  if (getInt(fileHeaderSpec, header, "fVersion") < 1000000)
+    return fileHeaderSmallSize;
+  return preadAll(fd, header + fileHeaderSmallSize, fileHeaderBigSize - fileHeaderSmallSize, fileHeaderSmallSize)
+         ? fileHeaderBigSize : 0;
+}
+
+/** Walk all the keys of the file @a fd, like IN_STREAM_KEY nodes do, but
+    using pread, so that any file can be scanned without moving the read
+    window. Gaps left by deleted objects are skipped.
+
+    @return false if @a fd is not a ROOT file or one of its keys is corrupted.
+  */
+inline bool readKeys(int fd, std::vector<KeyInfo> &keys)
+{
+  keys.clear();
+  char header[64];
+  if (!preadAll(fd, header, 64, 0) || strncmp(header, "root", 4) != 0)
+    return false;
+  size_t pos = getInt(fileHeaderSpec, header, "fBEGIN");
+  size_t seekFree = fileHeaderSeek(header, "fSeekFree");
+  while (pos < seekFree)
+  {
+    KeyInfo key;
+    int nbytes = readKeyInfo(fd, pos, key);
+    if (nbytes < 0)
+    {
+      pos -= nbytes;
+      continue;
+    }
+    if (nbytes == 0)
+      return false;
+    keys.push_back(key);
+    pos += nbytes;
+  }
+  return true;
+}
+
+inline bool readKey(int fd, KeyInfo const &key, std::vector<char> &scratch, char *output)
+{
+  return readObject(fd, key.seekKey, key.keyLen, key.nbytes, key.objLen, scratch, output);
+}
+
+template <class Sink>
+bool streamKey(int fd, KeyInfo const &key, std::vector<char> &scratch, std::vector<char> &piece, Sink sink)
+{
+  return streamObject(fd, key.seekKey, key.keyLen, key.nbytes, key.objLen, scratch, piece, sink);
+}
+
+/** The position of the record of the top directory, which follows the
+    name and title of the file in the TFile key at fBEGIN, according to the
+    file header @a header. @return 0 if there is no such key in @a keys.
+  */
+inline size_t topDirectoryPosition(char const *header, std::vector<KeyInfo> const &keys)
+{
+  size_t begin = getInt(fileHeaderSpec, header, "fBEGIN");
+  size_t nbytesName = getInt(fileHeaderSpec, header, "fNbytesName");
+  for (size_t i = 0; i < keys.size(); ++i)
+    if (keys[i].seekKey == begin)
+      return keys[i].className == "TFile" && nbytesName >= keys[i].keyLen && nbytesName < keys[i].nbytes
+             ? begin + nbytesName : 0;
+  return 0;
+}
+
+/** The path of the directory holding each of @a keys, empty for the top
+    directory. Directories are found through the SeekPdir of the keys, which
+    is the position of the key of their parent directory.
+  */
+inline void keyDirectories(std::vector<KeyInfo> const &keys, std::vector<std::string> &paths)
+{
+  std::map<size_t, KeyInfo const *> directories;
+  for (size_t i = 0; i < keys.size(); ++i)
+    if (keys[i].className == "TDirectory" || keys[i].className == "TDirectoryFile")
+      directories[keys[i].seekKey] = &keys[i];
+  paths.assign(keys.size(), std::string());
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    size_t seekPdir = keys[i].seekPdir;
+    for (size_t depth = 0; depth < 256; ++depth)
+    {
+      std::map<size_t, KeyInfo const *>::const_iterator d = directories.find(seekPdir);
+      if (d == directories.end())
+        break;
+      paths[i] = paths[i].empty() ? d->second->name : d->second->name + "/" + paths[i];
+      seekPdir = d->second->seekPdir;
+    }
+  }
+}
+
+#endif
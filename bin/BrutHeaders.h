@@ -17,7 +17,7 @@ struct ParseError
   char const *where_;
 };
 
-void print_hex(unsigned char const *buf, size_t size)
+inline void print_hex(unsigned char const *buf, size_t size, FILE *out = stdout)
 {
   char buffer[size*3+1];
   char *last = buffer;
@@ -31,40 +31,40 @@ void print_hex(unsigned char const *buf, size_t size)
     snprintf(last, 3, "%02x", ((int) buf[i]) & 0xff);
     last += 2;
   }
-  printf("%s", buffer);
+  fprintf(out, "%s", buffer);
 }
 
-int dump_hex(char const*s, size_t size, size_t offset, int maxlines = -1)
+inline int dump_hex(char const*s, size_t size, size_t offset, int maxlines = -1, FILE *out = stdout)
 {
   for (size_t i = 0; i < size; ++i)
   {
     if (maxlines >= 0 && (i/16) > (size_t) maxlines)
     {
-      printf("\n...\n");
+      fprintf(out, "\n...\n");
       break;
     }
     if ((i%16) == 0)
-      printf("\n%08d: ", (int)(i+offset));
-    printf("%02x ", ((unsigned int)s[i]) & 0xff);
+      fprintf(out, "\n%08d: ", (int)(i+offset));
+    fprintf(out, "%02x ", ((unsigned int)s[i]) & 0xff);
     if ((i%16) == 7)
-      printf("%s", " ");
+      fprintf(out, "%s", " ");
     if ((i%16) == 15)
     {
-      putchar('|');
+      fputc('|', out);
       for (size_t j =  0; j < 16; ++j)
       {
         char c = *(s + (i/16)*16 + j);
         if ((c >= 0x20) && (c <= 0x7e))
         {
-          putchar(c);
+          fputc(c, out);
         }
         else
-          putchar('.');
+          fputc('.', out);
       }
-      putchar('|');
+      fputc('|', out);
     }
   }
-  printf("\n");
+  fprintf(out, "\n");
   return size;
 }
 
@@ -123,7 +123,8 @@ struct FieldInfo
                        bool aBigEndian,
                        bool aDelimited, 
                        unsigned short aPosition,
-                       FieldSpec const*aRef)
+                       FieldSpec const*aRef,
+                       unsigned short aWidth = 1)
   : ref(aRef),
     conditionalField(0),
     conditionalBeginRange(0),
@@ -132,7 +133,8 @@ struct FieldInfo
     size(aSize),
     bigEndian(aBigEndian),
     delimited(aDelimited),
-    position(aPosition & 0x3fff)
+    position(aPosition & 0x3fff),
+    width(aWidth)
   {}
 
   constexpr FieldInfo(const FieldInfo info,
@@ -148,7 +150,8 @@ struct FieldInfo
     size(info.size),
     bigEndian(info.bigEndian),
     delimited(info.delimited),
-    position(info.position & 0x3fff)
+    position(info.position & 0x3fff),
+    width(info.width)
   {}
 
   constexpr FieldInfo()
@@ -164,6 +167,7 @@ struct FieldInfo
   unsigned  bigEndian : 1;
   unsigned  delimited : 1;
   signed    position : 14;
+  unsigned  width : 16;
 };
 
 constexpr bool is_null(FieldInfo info)
@@ -184,10 +188,12 @@ constexpr FieldInfo fixed_size(short size)
   return FieldInfo(size, 0, 0, 0, 0);
 }
 
-// To specify the fact that the field gets its size from another one.
-constexpr FieldInfo runtime_size(unsigned short position, short size, bool bigEndian)
+// To specify the fact that the field gets its size from another one, of
+// @a size bytes, @a position bytes away, which counts items of @a width
+// bytes, e.g. the values of a TArray.
+constexpr FieldInfo runtime_size(unsigned short position, short size, bool bigEndian, unsigned short width = 1)
 {
-  return FieldInfo(size, bigEndian, false, position, 0);
+  return FieldInfo(size, bigEndian, false, position, 0, width);
 }
 
 constexpr FieldInfo zero_delimited()
@@ -269,18 +275,18 @@ struct FieldSpec {
 
 
 
-char const *doThrow(char const *fmt, char const *message)
+/** Throw a ParseError from a constexpr expression, whose branches must all
+    have a value. The error only points to string literals, so it stays valid
+    once the stack is unwound, whichever thread catches it.
+  */
+inline char const *doThrow(char const *error, char const *where)
 {
-  char buffer[1024];
-  snprintf(buffer, 1024, fmt, message);
-  throw buffer;
+  throw ParseError(error, where);
 }
 
-short doThrow(char const *fmt, char const *message, short)
+inline short doThrow(char const *error, char const *where, short)
 {
-  char buffer[1024];
-  snprintf(buffer, 1024, fmt, message);
-  throw buffer;
+  throw ParseError(error, where);
 }
 
 
@@ -292,11 +298,10 @@ constexpr int getSizeBigEndian(FieldInfo info, char const *buf)
        :                        throw "wrong size";
 }
 
-constexpr unsigned int getSize(FieldInfo info, char const *buf)
+// The number of items of a field whose size comes from another one.
+constexpr unsigned int getCount(FieldInfo info, char const *buf)
 {
-  return info.delimited         ? strlen(buf) + 1
-       : size_offset(info) == 0 ? info.position
-       : info.size == 1         ? *(unsigned char*)(buf + size_offset(info))
+  return info.size == 1         ? *(unsigned char*)(buf + size_offset(info))
        : info.bigEndian         ? getSizeBigEndian(info, buf)
        : info.size == 2         ? *(unsigned short*)(buf + size_offset(info))
        : info.size == 4         ? *(unsigned int*)(buf + size_offset(info))
@@ -304,6 +309,13 @@ constexpr unsigned int getSize(FieldInfo info, char const *buf)
        :                              throw "wrong size";
 }
 
+constexpr unsigned int getSize(FieldInfo info, char const *buf)
+{
+  return info.delimited         ? strlen(buf) + 1
+       : size_offset(info) == 0 ? info.position
+       :                          info.width * getCount(info, buf);
+}
+
 /** This will return the fixed part of the spec size */
 constexpr int specSize(const FieldSpec *spec)
 {
@@ -334,7 +346,7 @@ constexpr char const *next(const FieldSpec *spec, char const *buf)
 }
 
 /** Return the POD size or the struct size accordingly */
-int moreRealSize(const FieldSpec *spec, char const *buf)
+inline int moreRealSize(const FieldSpec *spec, char const *buf)
 {
   return spec->info.ref         ? specRealSize(spec->info.ref, buf)
        :                          spec->info.size;
@@ -450,7 +462,7 @@ constexpr short getShortOffset(const FieldSpec *spec, char const *buf, int bufOf
        : sub(label, spec[specOff].name) == (char const *) -1        ? getShortOffset(spec, buf, bufOff + moreRealSize(spec+specOff, buf+bufOff), specOff + 1, label)
        : *sub(label, spec[specOff].name) == '.'                     ? getShortOffset(spec[specOff].info.ref, buf, bufOff, 0, sub(label, spec[specOff].name) + 1)
        : !*sub(label, spec[specOff].name)                           ? doGetShort(spec+specOff, buf + bufOff)
-       : /* default */                                                doThrow("Unsupported spec: %s\n", label, (short)0);
+       : /* default */                                                doThrow("Unsupported spec", label, (short)0);
 }
 
 constexpr int doGetInt(FieldSpec const*spec, const char*buf)
@@ -522,7 +534,7 @@ constexpr int64_t getInt64Offset(const FieldSpec *spec, char const *buf, int buf
            || getInt64Offset(spec, buf, 0, 0, spec[specOff].info.conditionalField) > spec[specOff].info.conditionalEndRange)
                                                                        ? getInt64Offset(spec, buf, bufOff, specOff + 1, label)
 
-       : !spec[specOff].name                                        ? throw ParseError("a", label) 
+       : !spec[specOff].name                                        ? throw ParseError("Field not found", label) 
        : sub(label, spec[specOff].name) == (char const *) -1        ? getInt64Offset(spec, buf, bufOff + moreRealSize(spec+specOff, buf+bufOff), specOff + 1, label)
        : *sub(label, spec[specOff].name) == '.'                     ? getInt64Offset(spec[specOff].info.ref, buf, bufOff, 0, sub(label, spec[specOff].name) + 1)
        : !*sub(label, spec[specOff].name)                           ? doGetInt64(spec+specOff, buf + bufOff) 
@@ -561,7 +573,7 @@ constexpr float getFloatOffset(const FieldSpec *spec, char const *buf, int bufOf
            || getInt64Offset(spec, buf, 0, 0, spec[specOff].info.conditionalField) > spec[specOff].info.conditionalEndRange)
                                                                        ? getFloatOffset(spec, buf, bufOff, specOff + 1, label)
 
-       : !spec[specOff].name                                        ? throw ParseError("a", label) 
+       : !spec[specOff].name                                        ? throw ParseError("Field not found", label) 
        : sub(label, spec[specOff].name) == (char const *) -1        ? getFloatOffset(spec, buf, bufOff + moreRealSize(spec+specOff, buf+bufOff), specOff + 1, label)
        : *sub(label, spec[specOff].name) == '.'                     ? getFloatOffset(spec[specOff].info.ref, buf, bufOff, 0, sub(label, spec[specOff].name) + 1)
        : !*sub(label, spec[specOff].name)                           ? doGetFloat(spec+specOff, buf + bufOff) 
@@ -600,7 +612,7 @@ constexpr double getDoubleOffset(const FieldSpec *spec, char const *buf, int buf
            || getInt64Offset(spec, buf, 0, 0, spec[specOff].info.conditionalField) > spec[specOff].info.conditionalEndRange)
                                                                        ? getDoubleOffset(spec, buf, bufOff, specOff + 1, label)
 
-       : !spec[specOff].name                                        ? throw ParseError("a", label) 
+       : !spec[specOff].name                                        ? throw ParseError("Field not found", label) 
        : sub(label, spec[specOff].name) == (char const *) -1        ? getDoubleOffset(spec, buf, bufOff + moreRealSize(spec+specOff, buf+bufOff), specOff + 1, label)
        : *sub(label, spec[specOff].name) == '.'                     ? getDoubleOffset(spec[specOff].info.ref, buf, bufOff, 0, sub(label, spec[specOff].name) + 1)
        : !*sub(label, spec[specOff].name)                           ? doGetDouble(spec+specOff, buf + bufOff) 
@@ -633,7 +645,7 @@ constexpr char const*getStringOffset(const FieldSpec *spec, char const *buf, int
            || getInt64Offset(spec, buf, 0, 0, spec[specOff].info.conditionalField) > spec[specOff].info.conditionalEndRange)
                                                                        ? getStringOffset(spec, buf, bufOff, specOff + 1, label)
  
-       : !spec->name                                   ? doThrow("Field not found %s", label)
+       : !spec[specOff].name                           ? doThrow("Field not found", label)
        : sub(label, spec[specOff].name) == (char const *) -1   ? getStringOffset(spec, buf, bufOff + moreRealSize(spec+specOff, buf+bufOff), specOff + 1, label)
        : (*sub(label, spec[specOff].name)) == '.'              ? getStringOffset(spec[specOff].info.ref, buf, bufOff, 0, sub(label, spec[specOff].name) + 1)
        :                                                 buf + bufOff;
@@ -681,7 +693,7 @@ constexpr char const*getString(const FieldSpec *spec, char const *buf, char cons
   return getStringOffset(spec, buf, 0, 0, label);
 } 
 
-void printScalar(const FieldSpec *specs, char const *buf)
+inline void printScalar(const FieldSpec *specs, char const *buf, FILE *out)
 {
   char buffer[16] = {0};
   switch (specs->info.size)
@@ -703,7 +715,7 @@ void printScalar(const FieldSpec *specs, char const *buf)
       memcpy(tmp, buf, specs->info.size < 16 ? specs->info.size : 16);
       snprintf(buffer, 16, "%s", tmp);
   }
-  printf("\"%s\": %s", specs->name, buffer);
+  fprintf(out, "\"%s\": %s", specs->name, buffer);
 }
 
 
@@ -714,7 +726,7 @@ void printScalar(const FieldSpec *specs, char const *buf)
 
     @return the number of bytes read.
 */
-int printString(const FieldSpec *specs, char const *buf)
+inline int printString(const FieldSpec *specs, char const *buf, FILE *out)
 {
   int size = size_size(specs->info);
   if (size_offset(specs->info) || specs->info.delimited)
@@ -723,15 +735,21 @@ int printString(const FieldSpec *specs, char const *buf)
     return 0;
   char buffer[size + 1];
   snprintf(buffer, size + 1, "%s", buf);
-  printf("\"%s\": \"%s\"", specs->name, buffer);
+  fprintf(out, "\"%s\": \"%s\"", specs->name, buffer);
   return size;
 }
 
-void printHex(const FieldSpec *specs, char const *buf)
+/** Print the bytes of a fixed size field, or of one whose size comes from
+    another field, e.g. the values of a TArray.
+
+    @return the number of bytes read.
+  */
+inline int printHex(const FieldSpec *specs, char const *buf, FILE *out)
 {
-  char buffer[specs->info.size*6+1];
-  char *last = buffer;
-  for (size_t i = 0; i < specs->info.size; ++i)
+  size_t size = size_offset(specs->info) ? getSize(specs->info, buf) : specs->info.size;
+  std::string buffer(size * 6 + 1, 0);
+  char *last = &buffer[0];
+  for (size_t i = 0; i < size; ++i)
   {
     if (i != 0)
     {
@@ -741,13 +759,14 @@ void printHex(const FieldSpec *specs, char const *buf)
     snprintf(last, 5, "0x%02x", ((int) buf[i]) & 0xff);
     last += 4;
   }
-  printf("\"%s\": [%s]", specs->name, buffer);
+  fprintf(out, "\"%s\": [%s]", specs->name, buffer.c_str());
+  return size;
 }
 
-void printDatetime(const FieldSpec *specs, char const* buf)
+inline void printDatetime(const FieldSpec *specs, char const* buf, FILE *out)
 {
   int datetime = bswap_32(*(int*)buf);
-  printf("\"%s\": %i/%i/%i %02i:%02i:%02i", specs->name, 
+  fprintf(out, "\"%s\": %i/%i/%i %02i:%02i:%02i", specs->name, 
                               (datetime >> 26) + 1995,
                               abs((datetime << 6) >> 28),
                               abs((datetime << 10) >> 27),
@@ -756,7 +775,7 @@ void printDatetime(const FieldSpec *specs, char const* buf)
                               abs(datetime << 26) >> 26);
 }
 
-char const *doPrintBuf(const FieldSpec *specs,  size_t specOff, char const* buf, size_t bufOff, int tabLevel)
+inline char const *doPrintBuf(const FieldSpec *specs,  size_t specOff, char const* buf, size_t bufOff, int tabLevel, FILE *out)
 {
   if (is_null(specs[specOff].info))
     return buf + bufOff;
@@ -766,75 +785,75 @@ char const *doPrintBuf(const FieldSpec *specs,  size_t specOff, char const* buf,
       && specs[specOff].info.conditionalType == CHAR
       && (getCharOffset(specs, buf, 0, 0, specs[specOff].info.conditionalField) < specs[specOff].info.conditionalBeginRange
           || getCharOffset(specs, buf, 0, 0, specs[specOff].info.conditionalField) > specs[specOff].info.conditionalEndRange))
-                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel);
+                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel, out);
   if (specs[specOff].info.conditionalField
       && specs[specOff].info.conditionalType == SHORT
       && (getShortOffset(specs, buf, 0, 0, specs[specOff].info.conditionalField) < specs[specOff].info.conditionalBeginRange
           || getShortOffset(specs, buf, 0, 0, specs[specOff].info.conditionalField) > specs[specOff].info.conditionalEndRange))
-                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel);
+                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel, out);
   if (specs[specOff].info.conditionalField
       && specs[specOff].info.conditionalType == INT
       && (getIntOffset(specs, buf, 0, 0, specs[specOff].info.conditionalField) < specs[specOff].info.conditionalBeginRange
           || getIntOffset(specs, buf, 0, 0, specs[specOff].info.conditionalField) > specs[specOff].info.conditionalEndRange))
-                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel);
+                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel, out);
   if (specs[specOff].info.conditionalField
       && specs[specOff].info.conditionalType == INT64
       && (getInt64Offset(specs, buf, 0, 0, specs[specOff].info.conditionalField) < specs[specOff].info.conditionalBeginRange
           || getInt64Offset(specs, buf, 0, 0, specs[specOff].info.conditionalField) > specs[specOff].info.conditionalEndRange))
-                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel);
+                                                                     return doPrintBuf(specs,  specOff + 1, buf, bufOff, tabLevel, out);
 
   int sizeRead = specs[specOff].info.size;
-  printf("%-*s", tabLevel, "");
+  fprintf(out, "%-*s", tabLevel, "");
   switch (specs[specOff].parseType)
   {
     case SCALAR:
     {
-      printScalar(specs + specOff, buf + bufOff);
+      printScalar(specs + specOff, buf + bufOff, out);
       break;
     }
     case STRING:
     {
-      sizeRead = printString(specs + specOff, buf + bufOff);
+      sizeRead = printString(specs + specOff, buf + bufOff, out);
       break;
     }
     case HEX:
     {
-      printHex(specs + specOff, buf + bufOff);
+      sizeRead = printHex(specs + specOff, buf + bufOff, out);
       break;
     }
     case HEXDATA:
     {
-      dump_hex(buf + bufOff, getSize(specs[specOff].info, buf + bufOff), bufOff);
+      dump_hex(buf + bufOff, getSize(specs[specOff].info, buf + bufOff), bufOff, -1, out);
       break;
     }      
     case DATETIME:
     {
-      printDatetime(specs + specOff, buf + bufOff);
+      printDatetime(specs + specOff, buf + bufOff, out);
       break;
     }
     case STRUCT:
     {
       // In case of structures we use a different spec
       // and get the number of bytes read from the new pointer.
-      printf("\"%s\": {\n", specs[specOff].name);
-      char const *newPos = doPrintBuf(specs[specOff].info.ref, 0, buf + bufOff, 0, tabLevel + 2);
-      printf("%*s", tabLevel+1, "}");
+      fprintf(out, "\"%s\": {\n", specs[specOff].name);
+      char const *newPos = doPrintBuf(specs[specOff].info.ref, 0, buf + bufOff, 0, tabLevel + 2, out);
+      fprintf(out, "%*s", tabLevel+1, "}");
       sizeRead = newPos - buf - bufOff;
       break;
     }
   }
   if (!is_null(specs[specOff + 1].info) && sizeRead)
-    printf(",");
+    fprintf(out, ",");
   if (sizeRead)
-    printf("\n");
-  return doPrintBuf(specs, specOff + 1, buf, bufOff + sizeRead, tabLevel);
+    fprintf(out, "\n");
+  return doPrintBuf(specs, specOff + 1, buf, bufOff + sizeRead, tabLevel, out);
 }
 
-void printBuf(const FieldSpec *specs, char const* buf, int tabLevel = 0)
+inline void printBuf(const FieldSpec *specs, char const* buf, int tabLevel = 0, FILE *out = stdout)
 {
-  printf("%*s", tabLevel+2, "{\n");
-  doPrintBuf(specs, 0, buf, 0, tabLevel+2);
-  printf("%*s", tabLevel+2, "}\n");
+  fprintf(out, "%*s", tabLevel+2, "{\n");
+  doPrintBuf(specs, 0, buf, 0, tabLevel+2, out);
+  fprintf(out, "%*s", tabLevel+2, "}\n");
 }
 
 constexpr FieldSpec LAST_FIELD = {FieldInfo(), 0, false, METADATA, SCALAR};
@@ -859,9 +878,9 @@ struct Object {
     return ::next(spec, buffer);
   }
 
-  void printBuf(int level = 0)
+  void printBuf(int level = 0, FILE *out = stdout)
   {
-    ::printBuf(spec, buffer, level);
+    ::printBuf(spec, buffer, level, out);
   }
 
   constexpr char const* getString(char const *key)
@@ -0,0 +1,2711 @@
+#include "BrutNodes.h"
+#include <stdlib.h>
+#include "CompressionHelpers.h"
+#include "HashHelpers.h"
+#include "ThreadHelpers.h"
+#include "ROOTSchema.h"
+#include "CMSSWSchema.h"
+#include "ExportHelpers.h"
+#include "SummaryHelpers.h"
+#include "MerkleHelpers.h"
+#include "ChunkHelpers.h"
+#include "LayoutHelpers.h"
+#include "DiffHelpers.h"
+#include "MetaHelpers.h"
+#include "CopyHelpers.h"
+#include "SampleHelpers.h"
+#include "CorpusHelpers.h"
+#include "UsageHelpers.h"
+#include "RecompressHelpers.h"
+#include "JsonHelpers.h"
+#include "StatsHelpers.h"
+#include "TraceHelpers.h"
+#include "RootFile.h"
+#include <cstdio>
+#include <cctype>
+#include <cassert>
+#include <climits>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// The nodes are only reached through processingSpecs.
+namespace {
+
+bool
+keyIsA(char const *label, FieldSpec const *spec, char const *buffer)
+{
+  bool result = strncmp(label,  getString(spec, buffer, "Name.value"), (size_t) getChar(spec, buffer, "Name.size")) == 0;
+  return result;
+}
+
+void
+hashKey(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  size_t keyStart = current.pos;
+
+  size_t seekKey = 0;
+  if (getShort(keyHeaderSpec, buffer, "Version") > 1000)
+    seekKey = getInt64(keyHeaderSpec, buffer, "SeekKey");
+  else
+    seekKey = getInt(keyHeaderSpec, buffer, "SeekKey");
+
+  if (seekKey != keyStart)
+  {
+    fprintf(context.out, "%lu: not a real key\n", keyStart);
+    dump_hex(buffer, specSize(keyHeaderSpec),(int) keyStart, -1, context.out);
+    states.clear();
+    return;
+  }
+
+  // Skipping metadata.
+  if (keyIsA("IdToParameterSetsBlobs",keyHeaderSpec, buffer) 
+      || strncmp("MetaData",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
+      || strncmp("Runs",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
+      || keyIsA("LuminosityBlockAuxiliary", keyHeaderSpec, buffer)
+      || keyIsA("EventAuxiliary", keyHeaderSpec, buffer))
+  {
+    size_t s = getChar(keyHeaderSpec, buffer, "Name.size") + 1; 
+    char buf[s];
+    snprintf(buf, s, "%s", getString(keyHeaderSpec, buffer, "Name.value"));
+    fprintf(context.out, "Ignoring %s\n", buf);
+    return;
+  }
+
+  size_t keySize = getShort(keyHeaderSpec, buffer, "KeyLen");
+  unsigned long objSize = getInt(keyHeaderSpec, buffer, "Nbytes")-keySize;
+  unsigned long uncompressedSize = getInt(keyHeaderSpec, buffer, "ObjLen");
+
+  char const*objBuffer = buffer + keySize;
+  char const*output = objBuffer;
+  // FIXME: Find a better way to decide if we need to uncompress buffers.
+  CompressorFunc compressor = getCompressorFor(compressorSpecs, (unsigned char*)objBuffer );
+
+  if (compressor)
+  {
+    output = new char[uncompressedSize];
+    int result = compressor((unsigned char*)output, uncompressedSize, 
+                                  (unsigned char*)objBuffer, objSize);
+    if (result != Z_OK &&  false)
+    {
+      fprintf(context.out, "\nError while decompressing object: %s (%i)\n", zError(result), result);
+      return;
+    }
+  }
+
+  unsigned char nameSize = (unsigned char) getChar(keyHeaderSpec, buffer, "Name.size");
+  char s[256];
+  memcpy(s, getString(keyHeaderSpec, buffer, "Name.value"), nameSize);
+  s[nameSize] = 0;
+  fprintf(context.out, "Hash for %s: ", s);
+  unsigned char digest[SHA1_SIZE];
+  sha1(output, uncompressedSize, digest);
+  for (size_t i = 0; i != SHA1_SIZE; ++i)
+    fprintf(context.out, "%x", digest[i]);
+  fprintf(context.out, "%s","\n");
+  if (compressor)
+   delete[] output;
+}
+
+void
+streamHash(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  int Nbytes = getInt(keyHeaderSpec, buffer, "Nbytes");
+  if ((current.pos + Nbytes) < context.fSeekFree)
+    states.push_back({0, IN_STREAM_HASH, current.pos + Nbytes});           
+  statsAdd(STAT_KEYS_VISITED, 1);
+  hashKey(buffer, current, states, context);  
+}
+
+void
+hashFile(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  context.fSeekFree = fileHeaderSeek(buffer, "fSeekFree");
+  states.push_back({0, IN_STREAM_HASH, (size_t) getInt(fileHeaderSpec, buffer, "fBEGIN")});            
+  //states.push_back({0, IN_STREAM_STREAMER_INFO, getInt(fileHeaderSpec, buffer, "fSeekInfo")});
+}
+
+void
+parseKey(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  size_t keyStart = current.pos;
+
+  size_t seekKey = 0;
+  if (getShort(keyHeaderSpec, buffer, "Version") > 1000)
+    seekKey = getInt64(keyHeaderSpec, buffer, "SeekKey");
+  else
+    seekKey = getInt(keyHeaderSpec, buffer, "SeekKey");
+
+  if (seekKey != keyStart)
+  {
+    fprintf(context.out, "%lu: not a real key\n", keyStart);
+    dump_hex(buffer, specSize(keyHeaderSpec),(int) keyStart, -1, context.out);
+    states.clear();
+    return;
+  }
+
+  // Skipping metadata.
+  if (keyIsA("IdToParameterSetsBlobs",keyHeaderSpec, buffer) 
+      || strncmp("MetaData",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
+      || strncmp("Runs",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
+      || keyIsA("LuminosityBlockAuxiliary", keyHeaderSpec, buffer)
+      || keyIsA("EventAuxiliary", keyHeaderSpec, buffer))
+  {
+    size_t s = getChar(keyHeaderSpec, buffer, "Name.size") + 1; 
+    char buf[s];
+    snprintf(buf, s, "%s", getString(keyHeaderSpec, buffer, "Name.value"));
+    fprintf(context.out, "Ignoring %s\n", buf);
+    return;
+  }
+  size_t keySize = getShort(keyHeaderSpec, buffer, "KeyLen");
+  unsigned long objSize = getInt(keyHeaderSpec, buffer, "Nbytes")-keySize;
+  unsigned long uncompressedSize = getInt(keyHeaderSpec, buffer, "ObjLen");
+
+  size_t keyHeaderSize = specRealSize(keyHeaderSpec, buffer);
+  fprintf(context.out, "Key of lenght %lu found:\n", keyHeaderSize);
+  printBuf(keyHeaderSpec, buffer, 0, context.out);
+  const size_t objectStart = seekKey + keySize;
+  fprintf(context.out, "Object contents (starting at %lu):\n", objectStart);
+  char const*objBuffer = buffer + keySize;
+  char const*output = objBuffer;
+  // FIXME: Find a better way to decide if we need to uncompress buffers.
+  size_t size = objSize;
+  CompressorFunc compressor = getCompressorFor(compressorSpecs, (unsigned char*)objBuffer );
+
+  if (compressor)
+  {
+    output = new char[uncompressedSize];
+    int result = compressor((unsigned char*)output, uncompressedSize, 
+                                  (unsigned char*)objBuffer, objSize);
+    size = uncompressedSize;
+    // Both zlib and lzma use 0 for OK and 1 for STREAM_END.
+    if (result != 0 && result != 1)
+    {
+      fprintf(context.out, "\nError while decompressing object (%i)\n", result);
+      delete[] output;
+      return;
+    }
+  }
+
+  if (keyIsA("FileFormatVersion", keyHeaderSpec, buffer))
+  {
+    printBuf(FileFormatVersionSpec, output, 0, context.out);
+  }
+  else
+  {
+    fprintf(context.out, "%s","Hash: ");
+    unsigned char digest[SHA1_SIZE];
+    sha1(output, uncompressedSize, digest);
+    for (size_t i = 0; i != SHA1_SIZE; ++i)
+      fprintf(context.out, "%x", digest[i]);
+    fprintf(context.out, "%s","\n");
+    dump_hex(output, size , 0, context.optMaxLinesInDump, context.out);
+  }
+  if (compressor)
+   delete[] output;
+}
+
+
+void
+parseSubDir(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  size_t subDirStart = current.pos;
+  if ((size_t) getInt(subDirSpec, buffer, "fSeekDir") != subDirStart)
+  {
+    fprintf(context.out, "Malformed subdir at %i.\n", (int)subDirStart);
+    dump_hex(buffer, subDirStart, getInt(subDirSpec, buffer, "fSeekDir"), -1, context.out);
+  }    
+  fprintf(context.out, "%s","Parsing subdir with contents:\n");
+  dump_hex(buffer, sizeof(buffer), (int) subDirStart, -1, context.out);
+  printBuf(subDirSpec, buffer, 0, context.out);
+}
+
+void
+parseTopDir(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  printBuf(topDirSpec, buffer, 0, context.out);
+}
+
+void
+parseStreamerInfo(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  fprintf(context.out, "---\n");
+  Object aList(TListSpec, buffer);
+  aList.printBuf(0, context.out);
+
+  size_t nObjects = (size_t) aList.getInt("nObjects");
+  Object aClass = aList.next(TClassSpec);
+
+  for (size_t i = 0 ; i < nObjects ; ++i)
+  {
+    aClass.printBuf(2, context.out);
+    char const *className = aClass.getString("Name");
+
+    if (strcmp(className, "TStreamerInfo") == 0)
+    {
+      Object aObj =  aClass.next(TStreamerInfoSpec); 
+      aObj.printBuf(2, context.out);
+      fprintf(context.out, "---\n");
+
+      Object arrayObjClass = aObj.next(TClassSpec);
+      size_t arraySize = (size_t) aObj.getInt("ObjectArray.nObjects");
+      for (size_t j = 0; j < arraySize; ++j)
+      {
+        fprintf(context.out, "_--- Element %lu, %s\n", j, arrayObjClass.getString("Name"));
+        char const *arrayObjClassName = arrayObjClass.getString("Name");
+        if (strcmp(arrayObjClassName, "TStreamerBase") == 0)
+        {
+          Object arrayObj = arrayObjClass.next(TStreamerBaseSpec);
+          arrayObj.printBuf(4, context.out);
+          arrayObjClass = arrayObj.next(TClassSpec);
+        }
+        else if (strcmp(arrayObjClassName, "TStreamerString") == 0)
+        {
+          Object arrayObj = arrayObjClass.next(TStreamerStringSpec);
+          arrayObj.printBuf(4, context.out);
+          arrayObjClass = arrayObj.next(TNamedSpec);
+          arrayObjClass.buffer += 20;
+          arrayObjClass.printBuf(4, context.out);
+          arrayObjClass = arrayObjClass.next(TClassSpec);
+          dump_hex(arrayObjClass.buffer, 100, 0, -1, context.out);
+        }
+        else
+        {
+          fprintf(context.out, "Unknown class %s\n", arrayObjClassName);
+        }
+      }
+    }
+    else
+    {
+      break;
+    }
+    // char const *nch = aObj.nextByte();
+    // int nbig = *nch;
+    // if (*nch == 255)  {
+    //   nbig = bswap_32(*(int *)(nch+1));
+    // }
+    // fprintf(context.out, "next at %i\n", nbig);
+    // aClass.buffer = nch + nbig;
+    break;
+  }
+}
+// TODO: decode the TObjArray
+// void
+// parseStreamerInfo(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &/*context*/)
+// {
+//   Object aInfo(StreamerInfoSpec, buffer);
+//   aInfo.printBuf();
+//   Object klass = aInfo.next(TClassSpec);
+//   klass.printBuf();
+//   printf("---\n");
+//   Object aList(TListSpec, buffer);
+//   aList.printBuf();
+
+//   int nObjects = aList.getInt("nObjects");
+//   Object aClass = aList.next(TClassSpec);
+//   for (size_t i = 0 ; i < nObjects ; ++i)
+//   {
+//     aClass.printBuf();
+//     char const *className = aClass.getString("Name");
+//     printf("Reading object %lu at %lx, %s\n", i, (size_t) aClass.buffer, className);
+    
+//     if (strcmp(className, "TStreamerInfo") == 0)
+//     {
+//       Object obj = aClass.next(TStreamerInfoSpec);
+//       obj.printBuf();
+//       int arraySize = obj.getInt("ObjectArray.nObjects");
+//       printf("_-- Object array has %i objects.\n", arraySize);
+//       Object arrayObjClass = obj.next(TClassSpec);
+      
+
+//       for (size_t j = 0; j < arraySize; ++j)
+//       {
+
+//         printf("_--- Element %lu, %s\n", j, arrayObjClass.getString("Name"));
+
+//         // Object obj = arrayObjClass.next(TStreamerBaseSpec);
+//         // obj.printBuf();
+//         // arrayObjClass = obj.next(TClassSpec);
+//         char const *className = arrayObjClass.getString("Name");
+//         if (strcmp(className, "TStreamerBase") == 0)
+//         {
+//             Object arrayObj = arrayObjClass.next(TStreamerBaseSpec);
+//             arrayObj.printBuf();
+//             arrayObjClass = arrayObj.next(TClassSpec);
+//         }
+//         else if (strcmp(className, "TStreamerString") == 0)
+//         {
+//            Object arrayObj = arrayObjClass.next(TStreamerStringSpec);
+//            arrayObj.printBuf();
+//            arrayObjClass = arrayObj.next(TClassSpec);
+//         }
+//         else if (strcmp(className, "TStreamerBasicType") == 0)
+//         {
+//            Object arrayObj = arrayObjClass.next(TStreamerBasicTypeSpec);
+//            arrayObj.printBuf();
+//            arrayObjClass = arrayObj.next(TClassSpec);
+//         }
+//         else
+//         {
+// //          printf("Unknown object %s\n", className);
+//           j--;
+//           arrayObjClass.buffer += 1;
+//         }
+//       }
+//       aClass.buffer = arrayObjClass.nextByte();
+//       dump_hex(aClass.buffer, 200, 0);
+//       // Object streamerBase = obj.next(TStreamerBaseSpec);
+//       // streamerBase.printBuf();
+//       // aClass = streamerBase.next(TClassSpec);
+//     }
+//     else
+//     {
+//       i--;
+//       printf("Unknown object %s\n", className);      
+//       aClass.buffer += 1;
+//     }
+//   }
+
+//   // if (strcmp(infoSpec.getString("Class.Name"), "TStreamerInfo") == 0)
+//   // {
+//   //   Object header = infoSpec.next(TStreamerInfoSpec);
+//   //   header.printBuf();
+//   //   Object klass = header.next(TClassSpec); 
+//   //   dump_hex(klass.buffer, 200, 0);
+//   //   for (size_t i = 0; i < header.getInt("ObjectArray.nObjects"); ++i)
+//   //   {
+//   //     dump_hex(klass.buffer, 200, (size_t)klass.buffer);
+//   //     char const *className = klass.getString("Name");
+//   //     printf("Reading object %lu at %lx, %s\n", i, (size_t) klass.buffer, className);
+//   //     // FIXME: make it a map.
+//   //     if (strcmp(className, "TStreamerBase") == 0)
+//   //     {
+//   //       Object streamerBase = klass.next(TStreamerBaseSpec);
+//   //       streamerBase.printBuf();
+//   //       printf("StreamerElement.Version.value: %i\n", streamerBase.getShort("StreamerElement.Version.value"));
+//   //       klass = streamerBase.next(TClassSpec);
+//   //     }
+//   //     else if (strcmp(className, "TStreamerString") == 0)
+//   //     {
+//   //       Object stringStreamer = klass.next(TStreamerStringSpec);
+//   //       stringStreamer.printBuf();
+//   //       klass = stringStreamer.next(TClassSpec);
+//   //     }
+//   //     else
+//   //     {
+//   //       printf("Reading a generic object\n");
+//   //     }
+//   //   }
+//   //  }
+// }
+
+void
+streamStreamerInfo(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  ParserContext newContext = context;
+  newContext.optMaxLinesInDump = 20;
+  parseKey(buffer, current, states, newContext);
+
+  size_t keySize = getShort(keyHeaderSpec, buffer, "KeyLen");
+  unsigned long objSize = getInt(keyHeaderSpec, buffer, "Nbytes")-keySize;
+  unsigned long uncompressedSize = getInt(keyHeaderSpec, buffer, "ObjLen");
+  char const*objBuffer = buffer + keySize;
+  char const*output = objBuffer;
+  CompressorFunc compressor = getCompressorFor(compressorSpecs, (unsigned char*)objBuffer ); 
+
+  if (compressor)
+  {
+    output = new char[uncompressedSize];
+    int result = compressor((unsigned char*)output, uncompressedSize, 
+                                  (unsigned char*)objBuffer, objSize);
+    if (result != Z_OK &&  false)
+    {
+      fprintf(context.out, "\nError while decompressing object: %s (%i)\n", zError(result), result);
+      return;
+    }
+  }
+  // Output now contains a streamer info object.
+  parseStreamerInfo(output, current, states, context);
+}
+
+void
+listStreamerInfo(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  context.fSeekFree = fileHeaderSeek(buffer, "fSeekFree");
+  states.push_back({0, IN_STREAM_STREAMER_INFO, fileHeaderSeek(buffer, "fSeekInfo")});
+}
+
+void
+parseRandomRange(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  dump_hex(buffer, current.size, 0, -1, context.out);
+}
+
+void
+parseFileHeader(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  dump_hex(buffer, specSize(fileHeaderSpec), 0, -1, context.out);
+  printBuf(fileHeaderSpec, buffer, 0, context.out);
+}
+
+void
+streamFile(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  fprintf(context.out, "Streaming all the keys for the file\n");
+  context.fSeekFree = fileHeaderSeek(buffer, "fSeekFree");
+  // Get all the streamer infos.
+  states.push_back({0, IN_STREAM_KEY, (size_t) getInt(fileHeaderSpec, buffer, "fBEGIN")});            
+  //states.push_back({0, IN_STREAM_STREAMER_INFO, getInt(fileHeaderSpec, buffer, "fSeekInfo")});
+}
+
+void
+streamKey(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  int Nbytes = getInt(keyHeaderSpec, buffer, "Nbytes");
+  if ((current.pos + Nbytes) < context.fSeekFree)
+    states.push_back({0, IN_STREAM_KEY, current.pos + Nbytes});           
+  statsAdd(STAT_KEYS_VISITED, 1);
+  ParserContext newContext = context;
+  newContext.optMaxLinesInDump = 10;
+  parseKey(buffer, current, states, newContext);
+}
+
+// Walk all the keys, like streamKey does, but only collect the TBaskets
+// of the selected branches, so that they can be processed at the end.
+void
+streamBasket(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  int Nbytes = getInt(keyHeaderSpec, buffer, "Nbytes");
+  if ((current.pos + Nbytes) < context.fSeekFree)
+    states.push_back({0, IN_STREAM_BASKET, current.pos + Nbytes});
+  statsAdd(STAT_KEYS_VISITED, 1);
+
+  size_t seekKey = 0;
+  if (getShort(keyHeaderSpec, buffer, "Version") > 1000)
+    seekKey = getInt64(keyHeaderSpec, buffer, "SeekKey");
+  else
+    seekKey = getInt(keyHeaderSpec, buffer, "SeekKey");
+
+  if (seekKey != current.pos)
+  {
+    fprintf(context.out, "%lu: not a real key\n", current.pos);
+    states.clear();
+    return;
+  }
+  addBasket(*context.basketScan, buffer, current.pos);
+}
+
+// Collect all the baskets of the file. Commands push the node which 
+// processes them below this one, so that it runs once all the keys have
+// been visited.
+void
+scanBaskets(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  context.fSeekFree = fileHeaderSeek(buffer, "fSeekFree");
+  states.push_back({0, IN_STREAM_BASKET, (size_t) getInt(fileHeaderSpec, buffer, "fBEGIN")});
+}
+
+// Compare the digests in @a digests with the ones read from the @a reference
+// listing and report the differences for items of the given @a kind.
+void
+compareDigests(char const *kind, char const *reference,
+               std::map<std::string, std::string> referenceDigests,
+               DigestList const &digests, FILE *out)
+{
+  size_t differ = 0;
+  for (DigestList::const_iterator i = digests.begin(); i != digests.end(); ++i)
+  {
+    std::map<std::string, std::string>::iterator r = referenceDigests.find(i->first);
+    if (r == referenceDigests.end())
+    {
+      fprintf(out, "%s %s only in this file\n", kind, i->first.c_str());
+      ++differ;
+      continue;
+    }
+    if (r->second != i->second)
+    {
+      fprintf(out, "%s %s differs\n", kind, i->first.c_str());
+      ++differ;
+    }
+    referenceDigests.erase(r);
+  }
+  for (std::map<std::string, std::string>::const_iterator r = referenceDigests.begin(); r != referenceDigests.end(); ++r)
+  {
+    fprintf(out, "%s %s only in %s\n", kind, r->first.c_str(), reference);
+    ++differ;
+  }
+  fprintf(out, "%lu compared, %lu differ.\n", digests.size(), differ);
+}
+
+// Print the digests of the items of the given @a kind, or compare them with
+// the reference listing if there is one. Item names must start with the 
+// "tree/branch" they belong to.
+void
+reportDigests(BasketScan &scan, char const *kind, char const *prefix, DigestList const &digests, FILE *out)
+{
+  if (scan.argument.empty())
+  {
+    for (DigestList::const_iterator i = digests.begin(); i != digests.end(); ++i)
+      fprintf(out, "%s%s: %s\n", prefix, i->first.c_str(), i->second.c_str());
+    scan.clear();
+    return;
+  }
+
+  std::map<std::string, std::string> referenceDigests;
+  if (!loadDigests(scan.argument.c_str(), prefix, referenceDigests))
+    fprintf(out, "Unable to read %s.\n", scan.argument.c_str());
+  else
+  {
+    for (std::map<std::string, std::string>::iterator i = referenceDigests.begin(); i != referenceDigests.end();)
+      if (scan.selected(i->first))
+        ++i;
+      else
+        referenceDigests.erase(i++);
+    compareDigests(kind, scan.argument.c_str(), referenceDigests, digests, out);
+  }
+  scan.clear();
+}
+
+// Same as above, for the digests of each branch. Branches with @a unreadable
+// baskets have no digest, as it would not be the one of their data.
+// @a hashers are deleted.
+void
+reportBranchDigests(BasketScan &scan, char const *prefix, std::vector<SHA1Hasher *> &hashers,
+                    std::vector<char> const &unreadable, FILE *out)
+{
+  std::map<std::string, std::string> sorted;
+  for (size_t i = 0; i < hashers.size(); ++i)
+  {
+    unsigned char digest[SHA1_SIZE];
+    hashers[i]->digest(digest);
+    if (unreadable[i])
+      fprintf(out, "Branch %s not hashed, some of its baskets are unreadable.\n", scan.branches[i].c_str());
+    else
+      sorted[scan.branches[i]] = digestToHex(digest);
+    delete hashers[i];
+  }
+  hashers.clear();
+  reportDigests(scan, "branch", prefix, DigestList(sorted.begin(), sorted.end()), out);
+}
+
+// Hash every basket on its own, in parallel, then build the digest of each
+// branch out of the digests of its baskets, in entry order. As TTree and
+// TBranch objects are not decoded, that is the order of the basket keys in
+// the file, which is the one they were written in.
+void
+branchHashDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  std::vector<BasketInfo> const &baskets = scan.baskets;
+  std::vector<unsigned char> basketDigests(baskets.size() * SHA1_SIZE);
+  std::vector<char> failed(baskets.size(), 0);
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > payloads(parallelThreads());
+
+  parallelFor(baskets.size(), [&](size_t i, unsigned thread) {
+    std::vector<char> &payload = payloads[thread];
+    payload.resize(baskets[i].objLen + 1);
+    if (!readBasket(context.fd, baskets[i], scratch[thread], &payload[0]))
+    {
+      failed[i] = 1;
+      return;
+    }
+    sha1(&payload[0], baskets[i].objLen, &basketDigests[i * SHA1_SIZE]);
+  });
+
+  std::vector<SHA1Hasher *> hashers(scan.branches.size());
+  for (size_t i = 0; i < hashers.size(); ++i)
+    hashers[i] = new SHA1Hasher;
+  std::vector<char> unreadable(scan.branches.size(), 0);
+  for (size_t i = 0; i < baskets.size(); ++i)
+  {
+    if (failed[i])
+    {
+      fprintf(context.out, "Unable to read basket at %lu of branch %s\n", baskets[i].seekKey, scan.branches[baskets[i].branch].c_str());
+      unreadable[baskets[i].branch] = 1;
+    }
+    else
+      hashers[baskets[i].branch]->update(&basketDigests[i * SHA1_SIZE], SHA1_SIZE);
+  }
+
+  reportBranchDigests(scan, "Hash for branch ", hashers, unreadable, context.out);
+}
+
+// Hash the entries data of each branch as a single stream, so that the
+// digest does not depend on how the entries were split in baskets.
+//
+// Baskets are decompressed in parallel, in batches of at most
+// streamHashBatchSize bytes, so that memory usage stays bounded. Each batch
+// is then fed to the hashers of its branches, one thread per branch.
+void
+streamHashDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  constexpr size_t streamHashBatchSize = 1 << 28; // 256 MB of uncompressed baskets.
+  BasketScan &scan = *context.basketScan;
+  std::vector<BasketInfo> const &baskets = scan.baskets;
+  std::vector<SHA1Hasher *> hashers(scan.branches.size());
+  for (size_t i = 0; i < hashers.size(); ++i)
+    hashers[i] = new SHA1Hasher;
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<char> arena;
+  std::vector<size_t> offsets;
+  std::vector<char> failed;
+  std::vector<char> unreadable(scan.branches.size(), 0);
+  // The baskets of the batch, grouped by branch.
+  std::map<size_t, std::vector<size_t> > branchBaskets;
+
+  for (size_t begin = 0, end = 0; begin < baskets.size(); begin = end)
+  {
+    offsets.clear();
+    size_t batchSize = 0;
+    for (end = begin; end < baskets.size(); ++end)
+    {
+      if (end != begin && batchSize + baskets[end].objLen > streamHashBatchSize)
+        break;
+      offsets.push_back(batchSize);
+      batchSize += baskets[end].objLen;
+    }
+    arena.resize(batchSize + 1);
+    failed.assign(end - begin, 0);
+
+    parallelFor(end - begin, [&](size_t i, unsigned thread) {
+      if (!readBasket(context.fd, baskets[begin + i], scratch[thread], &arena[offsets[i]]))
+        failed[i] = 1;
+    });
+
+    branchBaskets.clear();
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (failed[i - begin])
+      {
+        fprintf(context.out, "Unable to read basket at %lu of branch %s\n", baskets[i].seekKey, scan.branches[baskets[i].branch].c_str());
+        unreadable[baskets[i].branch] = 1;
+      }
+      else
+        branchBaskets[baskets[i].branch].push_back(i);
+    }
+    std::vector<std::vector<size_t> const *> work;
+    for (std::map<size_t, std::vector<size_t> >::const_iterator i = branchBaskets.begin(); i != branchBaskets.end(); ++i)
+      work.push_back(&i->second);
+
+    parallelFor(work.size(), [&](size_t w, unsigned) {
+      std::vector<size_t> const &items = *work[w];
+      for (size_t i = 0; i < items.size(); ++i)
+      {
+        BasketInfo const &basket = baskets[items[i]];
+        hashers[basket.branch]->update(&arena[offsets[items[i] - begin]], basketDataSize(basket));
+      }
+    });
+  }
+  reportBranchDigests(scan, "Stream hash for branch ", hashers, unreadable, context.out);
+}
+
+// Hash each entry of each basket on its own, using the entry offsets array.
+// Baskets are processed in parallel, and the entries of each basket 8 at
+// the time with AVX-512, when available. The digests of the entries of each
+// branch are stored in @a digests in entry order. Entries of baskets which
+// could not be decoded get a 0 digest.
+void
+hashEntries(ParserContext &context, std::map<std::string, std::vector<uint64_t> > &digests)
+{
+  BasketScan &scan = *context.basketScan;
+  std::vector<BasketInfo> const &baskets = scan.baskets;
+  // The digests of the entries of all the baskets, one after the other.
+  std::vector<size_t> firstEntry(baskets.size() + 1, 0);
+  for (size_t i = 0; i < baskets.size(); ++i)
+    firstEntry[i + 1] = firstEntry[i] + std::max(baskets[i].nevBuf, 0);
+  std::vector<uint64_t> entryDigests(firstEntry.back(), 0);
+  std::vector<char> failed(baskets.size(), 0);
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > payloads(parallelThreads());
+  std::vector<std::vector<std::pair<size_t, size_t> > > entries(parallelThreads());
+  EntryHashKernel kernel = entryHashKernel(bestSimdLevel());
+
+  parallelFor(baskets.size(), [&](size_t i, unsigned thread) {
+    std::vector<char> &payload = payloads[thread];
+    payload.resize(baskets[i].objLen + 1);
+    if (!readBasket(context.fd, baskets[i], scratch[thread], &payload[0])
+        || !basketEntries(baskets[i], &payload[0], entries[thread]))
+    {
+      failed[i] = 1;
+      return;
+    }
+    // basketEntries gives nevBuf entries when it succeeds.
+    std::vector<std::pair<size_t, size_t> > const &ranges = entries[thread];
+    kernel(&payload[0], ranges.data(), ranges.size(), &entryDigests[firstEntry[i]]);
+  });
+
+  for (size_t i = 0; i < baskets.size(); ++i)
+  {
+    if (failed[i])
+      fprintf(context.out, "Unable to decode basket at %lu of branch %s\n", baskets[i].seekKey, scan.branches[baskets[i].branch].c_str());
+    std::vector<uint64_t> &branchDigests = digests[scan.branches[baskets[i].branch]];
+    branchDigests.insert(branchDigests.end(), entryDigests.begin() + firstEntry[i], entryDigests.begin() + firstEntry[i + 1]);
+  }
+}
+
+// Report the digest of each entry of each branch, so that one can tell which
+// entries of a branch differ, or compare them with the reference listing if
+// there is one. Entries are numbered per branch.
+void
+entryHashDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  typedef std::map<std::string, std::vector<uint64_t> > BranchDigests;
+  BranchDigests branchDigests;
+  hashEntries(context, branchDigests);
+
+  if (scan.argument.empty())
+  {
+    for (BranchDigests::const_iterator b = branchDigests.begin(); b != branchDigests.end(); ++b)
+      for (size_t entry = 0; entry < b->second.size(); ++entry)
+        fprintf(context.out, "Hash for entry %s:%lu: %016llx\n", b->first.c_str(), entry,
+                             (unsigned long long) b->second[entry]);
+    scan.clear();
+    return;
+  }
+
+  char const *reference = scan.argument.c_str();
+  BranchDigests referenceDigests;
+  size_t rejected;
+  if (!loadEntryDigests(reference, "Hash for entry ", referenceDigests, rejected))
+  {
+    fprintf(context.out, "Unable to read %s.\n", reference);
+    scan.clear();
+    return;
+  }
+  if (rejected)
+    fprintf(context.out, "Ignoring %lu malformed or out of order entries of %s.\n", rejected, reference);
+  size_t compared = 0, differ = 0;
+  for (BranchDigests::const_iterator b = branchDigests.begin(); b != branchDigests.end(); ++b)
+  {
+    BranchDigests::iterator r = referenceDigests.find(b->first);
+    size_t referenceEntries = r == referenceDigests.end() ? 0 : r->second.size();
+    for (size_t entry = 0; entry < b->second.size(); ++entry)
+    {
+      if (entry >= referenceEntries)
+        fprintf(context.out, "entry %s:%lu only in this file\n", b->first.c_str(), entry);
+      else if (b->second[entry] != r->second[entry])
+        fprintf(context.out, "entry %s:%lu differs\n", b->first.c_str(), entry);
+      else
+        continue;
+      ++differ;
+    }
+    compared += b->second.size();
+    if (r == referenceDigests.end())
+      continue;
+    for (size_t entry = b->second.size(); entry < referenceEntries; ++entry, ++differ)
+      fprintf(context.out, "entry %s:%lu only in %s\n", b->first.c_str(), entry, reference);
+    referenceDigests.erase(r);
+  }
+  for (BranchDigests::const_iterator r = referenceDigests.begin(); r != referenceDigests.end(); ++r)
+    if (scan.selected(r->first))
+      for (size_t entry = 0; entry < r->second.size(); ++entry, ++differ)
+        fprintf(context.out, "entry %s:%lu only in %s\n", r->first.c_str(), entry, reference);
+  fprintf(context.out, "%lu compared, %lu differ.\n", compared, differ);
+  scan.clear();
+}
+
+// Decode the (run, lumi, event) of each entry of the EventAuxiliary branch
+// and build ParserContext::events, the sorted index of the events of the
+// file, unless an earlier command did.
+// @return false if there are no events in the file.
+bool
+buildEventIndex(ParserContext &context)
+{
+  EventIndex &index = *context.events;
+  if (index.built)
+  {
+    if (index.unknown)
+      fprintf(context.out, "Unable to decode %lu entries of %s.\n", index.unknown, eventAuxiliaryBranch);
+    return true;
+  }
+  BasketScan &scan = *context.basketScan;
+  std::map<std::string, size_t>::const_iterator aux = scan.branchIds.find(eventAuxiliaryBranch);
+  if (aux == scan.branchIds.end())
+  {
+    fprintf(context.out, "No %s branch found.\n", eventAuxiliaryBranch);
+    return false;
+  }
+  std::vector<size_t> auxBaskets;
+  for (size_t i = 0; i < scan.baskets.size(); ++i)
+    if (scan.baskets[i].branch == aux->second)
+      auxBaskets.push_back(i);
+
+  // The ids of the entries of each basket, 0 for those we could not decode.
+  std::vector<std::vector<EventId> > ids(auxBaskets.size());
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > payloads(parallelThreads());
+  std::vector<std::vector<std::pair<size_t, size_t> > > entries(parallelThreads());
+  parallelFor(auxBaskets.size(), [&](size_t i, unsigned thread) {
+    BasketInfo const &basket = scan.baskets[auxBaskets[i]];
+    std::vector<char> &payload = payloads[thread];
+    payload.resize(basket.objLen + 1);
+    EventId unknown = {0, 0, 0};
+    ids[i].assign(std::max(basket.nevBuf, 0), unknown);
+    if (!readBasket(context.fd, basket, scratch[thread], &payload[0])
+        || !basketEntries(basket, &payload[0], entries[thread]))
+      return;
+    for (size_t e = 0; e < entries[thread].size(); ++e)
+    {
+      try
+      {
+        if (!decodeEventAuxiliary(&payload[entries[thread][e].first], ids[i][e]))
+          ids[i][e] = unknown;
+      }
+      catch (...)
+      {
+        ids[i][e] = unknown;
+      }
+    }
+  });
+
+  uint64_t entry = 0;
+  size_t unknown = 0;
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    for (size_t e = 0; e < ids[i].size(); ++e, ++entry)
+    {
+      if (ids[i][e].run == 0 && ids[i][e].event == 0)
+        ++unknown;
+      else
+        index.add(ids[i][e], entry);
+    }
+  }
+  if (unknown)
+    fprintf(context.out, "Unable to decode %lu entries of %s.\n", unknown, eventAuxiliaryBranch);
+  index.sort();
+  index.built = true;
+  index.unknown = unknown;
+  return true;
+}
+
+void
+listEventsDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  EventIndex const &index = *context.events;
+  if (buildEventIndex(context))
+    for (size_t i = 0; i < index.items.size(); ++i)
+      fprintf(context.out, "Event %u:%u:%llu at entry %llu\n", index.items[i].id.run, index.items[i].id.lumi,
+                           (unsigned long long) index.items[i].id.event, (unsigned long long) index.items[i].entry);
+  context.basketScan->clear();
+}
+
+void
+findEventDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  EventIndex const &index = *context.events;
+  EventId id;
+  if (!parseEventId(context.basketScan->argument.c_str(), id))
+    fprintf(context.out, "Wrong event %s, expecting <run>:<lumi>:<event>.\n", context.basketScan->argument.c_str());
+  else if (buildEventIndex(context))
+  {
+    int64_t entry = index.find(id);
+    if (entry < 0)
+      fprintf(context.out, "Event %s not found.\n", context.basketScan->argument.c_str());
+    else
+      fprintf(context.out, "Event %s at entry %lld\n", context.basketScan->argument.c_str(), (long long) entry);
+  }
+  context.basketScan->clear();
+}
+
+// One digest per event, out of the digests of the entry of the event in all
+// the (selected) branches of the Events tree. Events are reported in 
+// (run, lumi, event) order and are compared with the reference listing by
+// id, so that files whose events are stored in a different order can be 
+// compared.
+void
+eventHashDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  EventIndex const &index = *context.events;
+  if (!buildEventIndex(context))
+  {
+    scan.clear();
+    return;
+  }
+  std::map<std::string, std::vector<uint64_t> > branchDigests;
+  hashEntries(context, branchDigests);
+  // The EventAuxiliary itself has process specific information. 
+  branchDigests.erase(eventAuxiliaryBranch);
+  std::string treePrefix = std::string(eventsTree) + "/";
+  std::vector<std::vector<uint64_t> const *> eventBranches;
+  for (std::map<std::string, std::vector<uint64_t> >::const_iterator b = branchDigests.begin(); b != branchDigests.end(); ++b)
+    if (b->first.compare(0, treePrefix.size(), treePrefix) == 0)
+      eventBranches.push_back(&b->second);
+
+  std::vector<std::pair<EventId, uint64_t> > digests(index.items.size());
+  std::vector<uint64_t> parts(eventBranches.size());
+  for (size_t i = 0; i < index.items.size(); ++i)
+  {
+    for (size_t b = 0; b < eventBranches.size(); ++b)
+      parts[b] = index.items[i].entry < eventBranches[b]->size() ? (*eventBranches[b])[index.items[i].entry] : 0;
+    digests[i].first = index.items[i].id;
+    digests[i].second = fastHash64(parts.empty() ? 0 : &parts[0], parts.size() * sizeof(uint64_t));
+  }
+
+  if (scan.argument.empty())
+  {
+    for (size_t i = 0; i < digests.size(); ++i)
+      fprintf(context.out, "Hash for event %u:%u:%llu: %016llx\n", digests[i].first.run, digests[i].first.lumi,
+                           (unsigned long long) digests[i].first.event, (unsigned long long) digests[i].second);
+    scan.clear();
+    return;
+  }
+
+  // Hash join with the events of the reference listing.
+  std::map<std::string, std::string> listing;
+  if (!loadDigests(scan.argument.c_str(), "Hash for event ", listing))
+  {
+    fprintf(context.out, "Unable to read %s.\n", scan.argument.c_str());
+    scan.clear();
+    return;
+  }
+  std::unordered_map<EventId, uint64_t, EventIdHash> referenceDigests;
+  for (std::map<std::string, std::string>::const_iterator i = listing.begin(); i != listing.end(); ++i)
+  {
+    EventId id;
+    if (parseEventId(i->first.c_str(), id))
+      referenceDigests[id] = strtoull(i->second.c_str(), 0, 16);
+  }
+  size_t differ = 0;
+  for (size_t i = 0; i < digests.size(); ++i)
+  {
+    EventId const &id = digests[i].first;
+    std::unordered_map<EventId, uint64_t, EventIdHash>::iterator r = referenceDigests.find(id);
+    if (r == referenceDigests.end() || r->second != digests[i].second)
+    {
+      fprintf(context.out, "event %u:%u:%llu %s\n", id.run, id.lumi, (unsigned long long) id.event,
+                           r == referenceDigests.end() ? "only in this file" : "differs");
+      ++differ;
+    }
+    if (r != referenceDigests.end())
+      referenceDigests.erase(r);
+  }
+  std::vector<EventId> missing;
+  for (std::unordered_map<EventId, uint64_t, EventIdHash>::const_iterator r = referenceDigests.begin(); r != referenceDigests.end(); ++r)
+    missing.push_back(r->first);
+  std::sort(missing.begin(), missing.end());
+  for (size_t i = 0; i < missing.size(); ++i)
+    fprintf(context.out, "event %u:%u:%llu only in %s\n", missing[i].run, missing[i].lumi,
+                         (unsigned long long) missing[i].event, scan.argument.c_str());
+  fprintf(context.out, "%lu compared, %lu differ.\n", digests.size(), differ + missing.size());
+  scan.clear();
+}
+
+// Write the values of the selected branches to a columnar file (see
+// ExportHelpers.h). The output is mapped and baskets are decompressed in
+// parallel, in file order, straight into their place, then converted to
+// native order in place.
+void
+exportDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  if (scan.selection.empty())
+  {
+    fprintf(context.out, "Please specify the branches to export, as <branch>:<type>.\n");
+    scan.clear();
+    return;
+  }
+  std::vector<ExportColumn> columns;
+  size_t size = planExport(scan, columns, context.out);
+  if (!size)
+  {
+    fprintf(context.out, "Nothing to export.\n");
+    scan.clear();
+    return;
+  }
+  int out = open(scan.argument.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (out < 0 || ftruncate(out, size) != 0)
+  {
+    fprintf(context.out, "Unable to write %s.\n", scan.argument.c_str());
+    if (out >= 0)
+      close(out);
+    scan.clear();
+    return;
+  }
+  char *output = (char *) mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, out, 0);
+  if (output == MAP_FAILED)
+  {
+    fprintf(context.out, "Unable to map %s.\n", scan.argument.c_str());
+    close(out);
+    scan.clear();
+    return;
+  }
+  writeExportHeaders(scan, columns, output);
+
+  // (basket, column, index of the basket in the column), in file order.
+  struct ExportItem {
+    size_t basket;
+    size_t column;
+    size_t index;
+  };
+  std::vector<ExportItem> items;
+  for (size_t c = 0; c < columns.size(); ++c)
+    for (size_t i = 0; i < columns[c].baskets.size(); ++i)
+      items.push_back({columns[c].baskets[i], c, i});
+  std::sort(items.begin(), items.end(), [](ExportItem const &a, ExportItem const &b) {
+    return a.basket < b.basket;
+  });
+
+  std::vector<char> failed(items.size(), 0);
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  parallelFor(items.size(), [&](size_t i, unsigned thread) {
+    ExportColumn const &column = columns[items[i].column];
+    BasketInfo const &basket = scan.baskets[items[i].basket];
+    char *data = output + column.offsets[items[i].index];
+    if (!readBasket(context.fd, basket, scratch[thread], data))
+    {
+      memset(data, 0, basket.objLen);
+      failed[i] = 1;
+      return;
+    }
+    toNativeOrder(data, basket.objLen / column.type->size, column.type->size);
+  });
+
+  for (size_t i = 0; i < items.size(); ++i)
+    if (failed[i])
+      fprintf(context.out, "Unable to read basket at %lu of branch %s\n", scan.baskets[items[i].basket].seekKey,
+                           scan.branches[scan.baskets[items[i].basket].branch].c_str());
+  if (munmap(output, size) != 0 || close(out) != 0)
+    fprintf(context.out, "Error while writing %s.\n", scan.argument.c_str());
+  for (size_t c = 0; c < columns.size(); ++c)
+    fprintf(context.out, "Exported %llu entries of %s as %s.\n", (unsigned long long) columns[c].entries,
+                         scan.branches[columns[c].branch].c_str(), columns[c].type->label);
+  scan.clear();
+}
+
+// Summarize the values of the selected branches in a single pass over their
+// baskets. Baskets are decoded and reduced in parallel, each into its own
+// partial summary, which are merged in entry order at the end, so that only
+// one basket per thread is in memory at any time.
+void
+summarizeDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  if (scan.selection.empty())
+  {
+    fprintf(context.out, "Please specify the branches to summarize, as <branch>:<type>.\n");
+    scan.clear();
+    return;
+  }
+  std::vector<BasketInfo> const &baskets = scan.baskets;
+  std::vector<ColumnType const *> types(scan.branches.size());
+  for (size_t b = 0; b < types.size(); ++b)
+    types[b] = selectedColumnType(scan, b);
+
+  enum { SUMMARIZED, NO_TYPE, NOT_VALUES, READ_ERROR };
+  std::vector<Summary> partials(baskets.size(), emptySummary());
+  std::vector<char> status(baskets.size(), SUMMARIZED);
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > payloads(parallelThreads());
+  parallelFor(baskets.size(), [&](size_t i, unsigned thread) {
+    ColumnType const *type = types[baskets[i].branch];
+    if (!type)
+    {
+      status[i] = NO_TYPE;
+      return;
+    }
+    if (!isValueArray(baskets[i], type))
+    {
+      status[i] = NOT_VALUES;
+      return;
+    }
+    std::vector<char> &payload = payloads[thread];
+    payload.resize(baskets[i].objLen + 1);
+    if (!readBasket(context.fd, baskets[i], scratch[thread], &payload[0]))
+    {
+      status[i] = READ_ERROR;
+      return;
+    }
+    size_t count = baskets[i].objLen / type->size;
+    toNativeOrder(&payload[0], count, type->size);
+    summarize(type, &payload[0], count, partials[i]);
+  });
+
+  std::vector<Summary> summaries(scan.branches.size(), emptySummary());
+  std::vector<char> valid(scan.branches.size(), 1);
+  for (size_t i = 0; i < baskets.size(); ++i)
+  {
+    size_t branch = baskets[i].branch;
+    if (status[i] == NOT_VALUES && valid[branch])
+      fprintf(context.out, "Branch %s does not have fixed size %s entries.\n", scan.branches[branch].c_str(), types[branch]->label);
+    if (status[i] == READ_ERROR)
+      fprintf(context.out, "Unable to read basket at %lu of branch %s\n", baskets[i].seekKey, scan.branches[branch].c_str());
+    if (status[i] == NO_TYPE || status[i] == NOT_VALUES)
+      valid[branch] = 0;
+    mergeSummary(summaries[branch], partials[i]);
+  }
+  for (std::map<std::string, size_t>::const_iterator b = scan.branchIds.begin(); b != scan.branchIds.end(); ++b)
+  {
+    if (!valid[b->second])
+      continue;
+    Summary const &summary = summaries[b->second];
+    uint64_t finite = summary.count - summary.nans - summary.infs;
+    fprintf(context.out, "Summary for branch %s: %llu values, %llu NaN, %llu Inf", b->first.c_str(),
+                         (unsigned long long) summary.count, (unsigned long long) summary.nans, (unsigned long long) summary.infs);
+    if (finite)
+      fprintf(context.out, ", min %.17g, max %.17g, sum %.17g, mean %.17g", summary.min, summary.max, summary.sum, summary.sum / finite);
+    fprintf(context.out, "\n");
+  }
+  scan.clear();
+}
+
+/** Open @a path with libbrut in @a file, and give its keys as KeyInfo, for
+    the helpers, with the directory holding each of them.
+    @return false if it is not a ROOT file.
+  */
+bool rootFileKeys(char const *path, brut::RootFile &file, std::vector<KeyInfo> &keys,
+                  std::vector<std::string> &directories)
+{
+  if (!file.open(path))
+    return false;
+  keys.resize(file.size());
+  directories.resize(file.size());
+  for (size_t i = 0; i < file.size(); ++i)
+  {
+    brut::Key const &key = file[i];
+    KeyInfo &info = keys[i];
+    info.seekKey = key.offset;
+    info.seekPdir = key.parent;
+    info.nbytes = key.nbytes;
+    info.objLen = key.objLen;
+    info.keyLen = key.keyLen;
+    info.cycle = key.cycle;
+    info.className = key.className.str();
+    info.name = key.name.str();
+    info.title = key.title.str();
+    memcpy(info.compression, key.compression, sizeof(info.compression));
+    directories[i] = key.directory.str();
+  }
+  return true;
+}
+
+// Build the Merkle tree of the objects of the file (see MerkleHelpers.h),
+// hashing them in parallel, and print it or compare it, top down, with the
+// listing of another file. Identical files only need the root of the
+// listing to be read.
+void
+merkleDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  brut::RootFile file;
+  std::vector<KeyInfo> keys;
+  std::vector<std::string> directories;
+  if (!rootFileKeys(context.filename, file, keys, directories))
+  {
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+    scan.clear();
+    return;
+  }
+  std::vector<std::string> leaves;
+  std::vector<brut::Key> objects;
+  std::map<std::string, size_t> basketIndex;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    if (merkleIgnored(keys[i]))
+      continue;
+    leaves.push_back(merkleLeaf(keys[i], directories[i], basketIndex[keys[i].title + "/" + keys[i].name]++));
+    objects.push_back(file[i]);
+  }
+
+  MerkleTree tree;
+  size_t leaf = 0;
+  file.hash([&](brut::Key const &key, unsigned char const *digest) {
+    if (!digest)
+      fprintf(context.out, "Unable to read object at %llu\n", (unsigned long long) key.offset);
+    tree.addLeaf(leaves[leaf++], digest ? digestToHex(digest) : std::string());
+  }, &objects);
+  std::string const &root = tree.update();
+
+  if (scan.argument.empty())
+  {
+    tree.print(merkleRoot, context.out);
+    scan.clear();
+    return;
+  }
+  char const *reference = scan.argument.c_str();
+  std::string referenceRoot;
+  std::map<std::string, std::string> listing;
+  if (!loadMerkleRoot(reference, referenceRoot))
+    fprintf(context.out, "Unable to read %s.\n", reference);
+  else if (referenceRoot == root)
+    fprintf(context.out, "Files are identical.\n");
+  else if (!loadDigests(reference, merklePrefix, listing))
+    fprintf(context.out, "Unable to read %s.\n", reference);
+  else
+  {
+    MerkleTree referenceTree;
+    referenceTree.digests.swap(listing);
+    for (std::map<std::string, std::string>::const_iterator i = referenceTree.digests.begin(); i != referenceTree.digests.end(); ++i)
+      referenceTree.addNode(i->first);
+    size_t visited = 0, differ = 0;
+    compareMerkle(tree, referenceTree, reference, merkleRoot, visited, differ, context.out);
+    fprintf(context.out, "%lu compared, %lu differ.\n", visited, differ);
+  }
+  scan.clear();
+}
+
+void
+chunksDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  std::vector<KeyInfo> keys;
+  if (!readKeys(context.fd, keys))
+  {
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+    scan.clear();
+    return;
+  }
+  std::vector<std::string> directories;
+  keyDirectories(keys, directories);
+  // Objects are named as the leaves of listmerkle.
+  std::vector<std::string> names(keys.size());
+  std::map<std::string, size_t> basketIndex;
+  for (size_t i = 0; i < keys.size(); ++i)
+    if (!merkleIgnored(keys[i]))
+      names[i] = merkleLeaf(keys[i], directories[i], basketIndex[keys[i].title + "/" + keys[i].name]++);
+
+  // Objects are chunked as they are decompressed, so that each thread only
+  // holds one compressed chunk of them at a time.
+  std::vector<std::vector<Chunk> > chunks(keys.size());
+  std::vector<char> failed(keys.size(), 0);
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > pieces(parallelThreads());
+  parallelFor(keys.size(), [&](size_t i, unsigned thread) {
+    if (names[i].empty())
+      return;
+    ChunkStream stream(chunks[i]);
+    failed[i] = !streamKey(context.fd, keys[i], scratch[thread], pieces[thread],
+                           [&stream](char const *data, size_t size) { stream.update(data, size); });
+    stream.finish();
+  });
+
+  std::map<std::string, std::vector<Chunk> > reference;
+  char const *referenceName = scan.argument.c_str();
+  bool comparing = !scan.argument.empty();
+  if (comparing && !loadChunks(referenceName, reference))
+  {
+    fprintf(context.out, "Unable to read %s.\n", referenceName);
+    scan.clear();
+    return;
+  }
+  size_t compared = 0, differ = 0;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    if (names[i].empty())
+      continue;
+    if (failed[i])
+    {
+      fprintf(context.out, "Unable to read object at %lu\n", keys[i].seekKey);
+      continue;
+    }
+    if (!comparing)
+    {
+      printChunks(names[i], chunks[i], context.out);
+      continue;
+    }
+    ++compared;
+    std::map<std::string, std::vector<Chunk> >::iterator r = reference.find(names[i]);
+    if (r == reference.end())
+    {
+      fprintf(context.out, "%s only in this file\n", names[i].c_str());
+      ++differ;
+      continue;
+    }
+    std::vector<Chunk> const &theirs = r->second;
+    bool same = theirs.size() == chunks[i].size();
+    for (size_t c = 0; same && c < theirs.size(); ++c)
+      same = theirs[c].digest == chunks[i][c].digest;
+    reference.erase(r);
+    if (same)
+      continue;
+    ++differ;
+    std::vector<std::pair<size_t, size_t> > ranges;
+    differingRanges(chunks[i], theirs, ranges);
+    if (ranges.empty())
+      fprintf(context.out, "%s has bytes removed or moved\n", names[i].c_str());
+    for (size_t d = 0; d < ranges.size(); ++d)
+      fprintf(context.out, "%s differs in bytes %lu-%lu\n", names[i].c_str(), ranges[d].first, ranges[d].second);
+  }
+  for (std::map<std::string, std::vector<Chunk> >::const_iterator r = reference.begin(); r != reference.end(); ++r, ++differ)
+    fprintf(context.out, "%s only in %s\n", r->first.c_str(), referenceName);
+  if (comparing)
+    fprintf(context.out, "%lu compared, %lu differ.\n", compared, differ);
+  scan.clear();
+}
+
+/** Hash a sample of the objects of the file (see SampleHelpers.h), chosen
+    with the seed and budget of BasketScan::options, and list it or, if there
+    is a reference listing, hash the objects sampled there and compare them.
+    The headers of all the keys are still read, so that objects added,
+    removed or resized are always found.
+  */
+void
+sampleDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  brut::RootFile file;
+  std::vector<KeyInfo> keys;
+  std::vector<std::string> directories;
+  if (!rootFileKeys(context.filename, file, keys, directories))
+  {
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+    scan.clear();
+    return;
+  }
+  std::vector<std::string> names(keys.size());
+  std::map<std::string, size_t> basketIndex;
+  for (size_t i = 0; i < keys.size(); ++i)
+    if (!merkleIgnored(keys[i]))
+      names[i] = merkleLeaf(keys[i], directories[i], basketIndex[keys[i].title + "/" + keys[i].name]++);
+
+  char const *referenceName = scan.argument.c_str();
+  bool comparing = !scan.argument.empty();
+  std::map<std::string, std::string> referenceObjects, referenceSample;
+  if (comparing && (!loadDigests(referenceName, sampleObjectPrefix, referenceObjects)
+                    || !loadDigests(referenceName, samplePrefix, referenceSample)))
+  {
+    fprintf(context.out, "Unable to read %s.\n", referenceName);
+    scan.clear();
+    return;
+  }
+
+  // When comparing, the objects sampled in the listing are the ones to hash.
+  std::vector<size_t> sampled;
+  if (comparing)
+  {
+    for (size_t i = 0; i < keys.size(); ++i)
+      if (!names[i].empty() && referenceSample.count(names[i]))
+        sampled.push_back(i);
+  }
+  else
+  {
+    uint64_t seed = strtoull(scan.options["seed"].c_str(), 0, 10);
+    uint64_t budget = scan.options.count("budget") ? strtoull(scan.options["budget"].c_str(), 0, 10)
+                                                   : sampleDefaultBudget;
+    std::vector<SampleCandidate> candidates;
+    std::vector<size_t> candidateKeys;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      if (names[i].empty())
+        continue;
+      SampleCandidate candidate = {sampleStratum(keys[i].className, keys[i].objLen),
+                                   sampleRank(names[i], seed), keys[i].objLen};
+      candidates.push_back(candidate);
+      candidateKeys.push_back(i);
+    }
+    std::vector<size_t> selected;
+    selectSample(candidates, budget, selected);
+    for (size_t s = 0; s < selected.size(); ++s)
+      sampled.push_back(candidateKeys[selected[s]]);
+    fprintf(context.out, "Sampling seed %llu budget %llu\n", (unsigned long long) seed, (unsigned long long) budget);
+  }
+
+  std::vector<brut::Key> sampledKeys;
+  for (size_t s = 0; s < sampled.size(); ++s)
+    sampledKeys.push_back(file[sampled[s]]);
+  std::vector<std::string> digests;
+  file.hash([&digests](brut::Key const &, unsigned char const *digest) {
+    digests.push_back(digest ? digestToHex(digest) : std::string());
+  }, &sampledKeys);
+
+  size_t objects = 0, differ = 0, sampledBytes = 0, totalBytes = 0;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    if (names[i].empty())
+      continue;
+    ++objects;
+    totalBytes += keys[i].objLen;
+    if (!comparing)
+    {
+      fprintf(context.out, "%s%s: %u\n", sampleObjectPrefix, names[i].c_str(), keys[i].objLen);
+      continue;
+    }
+    std::map<std::string, std::string>::iterator r = referenceObjects.find(names[i]);
+    if (r == referenceObjects.end())
+    {
+      fprintf(context.out, "%s only in this file\n", names[i].c_str());
+      ++differ;
+      continue;
+    }
+    if (strtoul(r->second.c_str(), 0, 10) != keys[i].objLen)
+    {
+      fprintf(context.out, "%s has size %u rather than %s\n", names[i].c_str(), keys[i].objLen, r->second.c_str());
+      ++differ;
+    }
+    referenceObjects.erase(r);
+  }
+  for (std::map<std::string, std::string>::const_iterator r = referenceObjects.begin(); r != referenceObjects.end(); ++r, ++differ)
+    fprintf(context.out, "%s only in %s\n", r->first.c_str(), referenceName);
+
+  size_t hashed = 0;
+  for (size_t s = 0; s < sampled.size(); ++s)
+  {
+    KeyInfo const &key = keys[sampled[s]];
+    std::string const &name = names[sampled[s]];
+    if (digests[s].empty())
+    {
+      fprintf(context.out, "Unable to read object at %lu\n", key.seekKey);
+      continue;
+    }
+    ++hashed;
+    sampledBytes += key.objLen;
+    if (!comparing)
+      fprintf(context.out, "%s%s: %s\n", samplePrefix, name.c_str(), digests[s].c_str());
+    else if (referenceSample[name] != digests[s])
+    {
+      fprintf(context.out, "%s differs\n", name.c_str());
+      ++differ;
+    }
+  }
+  if (!comparing)
+  {
+    scan.clear();
+    return;
+  }
+  fprintf(context.out, "%lu objects, %lu sampled, %lu of %lu bytes, %lu differ.\n", objects, hashed, sampledBytes, totalBytes, differ);
+  if (!differ)
+    fprintf(context.out, "No difference found: with %.0f%% confidence, less than %.2g%% of the objects differ.\n",
+                         sampleConfidence * 100, sampleBound(hashed) * 100);
+  scan.clear();
+}
+
+/** Add the objects of the file, and of the files in BasketScan::selection,
+    to the corpus store BasketScan::argument (see CorpusHelpers.h), then
+    report how many of their bytes are shared, per class and per file.
+    Files already in the store are skipped, so that it can be updated as new
+    files arrive. Files are opened corpusOpenFiles at a time, or fewer if
+    the limit of descriptors is low, and the objects of all the files open
+    are read and hashed in one parallel pass.
+
+    A file is only listed in the store once all its objects are in it. One
+    with an object which cannot be read is left out whole, and the objects
+    of one which cannot be listed are taken out again, so that the next
+    update does not count them twice.
+  */
+constexpr size_t corpusOpenFiles = 64;
+
+void
+corpusDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  char const *storeName = scan.argument.c_str();
+  CorpusStore store;
+  std::vector<std::string> known;
+  if (!store.open(storeName) || !loadCorpusFiles(storeName, known))
+  {
+    fprintf(context.out, "Unable to open the store %s.\n", storeName);
+    scan.clear();
+    return;
+  }
+  std::vector<std::string> paths(1, context.filename);
+  paths.insert(paths.end(), scan.selection.begin(), scan.selection.end());
+  std::set<std::string> seen(known.begin(), known.end());
+  std::vector<std::string> pending;
+  for (size_t f = 0; f < paths.size(); ++f)
+  {
+    char *resolved = realpath(paths[f].c_str(), 0);
+    std::string path = resolved ? resolved : paths[f];
+    free(resolved);
+    if (seen.insert(path).second)
+      pending.push_back(path);
+    else
+      fprintf(context.out, "%s is already in the store.\n", path.c_str());
+  }
+
+  // What the report needs of each object added.
+  struct AddedObject {
+    unsigned char digest[SHA1_SIZE];
+    uint32_t      file;
+    uint32_t      classId;
+    uint64_t      offset;
+    uint64_t      size;
+  };
+  std::vector<AddedObject> added;
+  std::vector<std::string> files;
+  std::vector<std::string> classNames;
+  std::map<std::string, uint32_t> classIds;
+  std::vector<std::vector<char> > payload(parallelThreads());
+  size_t window = corpusOpenFiles;
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+    window = std::max<size_t>(1, std::min<size_t>(window, limit.rlim_cur / 4));
+  bool valid = true;
+  for (size_t first = 0; valid && first < pending.size(); first += window)
+  {
+    size_t n = std::min(window, pending.size() - first);
+    std::vector<brut::RootFile> rootFiles(n);
+    std::vector<std::vector<KeyInfo> > keys(n);
+    std::vector<char> opened(n, 0);
+    parallelFor(n, [&](size_t f, unsigned) {
+      std::vector<std::string> directories;
+      opened[f] = rootFileKeys(pending[first + f].c_str(), rootFiles[f], keys[f], directories);
+    });
+
+    // The objects of all the files open, as (file, key) pairs.
+    std::vector<std::pair<size_t, size_t> > objects;
+    for (size_t f = 0; f < n; ++f)
+      for (size_t k = 0; opened[f] && k < keys[f].size(); ++k)
+        if (!merkleIgnored(keys[f][k]))
+          objects.push_back(std::make_pair(f, k));
+    std::vector<unsigned char> digests(objects.size() * SHA1_SIZE);
+    std::vector<char> failed(objects.size(), 0);
+    parallelFor(objects.size(), [&](size_t i, unsigned thread) {
+      brut::RootFile const &file = rootFiles[objects[i].first];
+      if (!file.read(file[objects[i].second], payload[thread]))
+        failed[i] = 1;
+      else
+        sha1(payload[thread].data(), payload[thread].size(), &digests[i * SHA1_SIZE]);
+    });
+
+    // Objects are added file by file, so that the first location of each
+    // one is the first file, in the order given, where it is found.
+    size_t end = 0;
+    for (size_t f = 0; valid && f < n; ++f)
+    {
+      std::string const &path = pending[first + f];
+      if (!opened[f])
+      {
+        fprintf(context.out, "Unable to read the keys of %s.\n", path.c_str());
+        continue;
+      }
+      size_t begin = end;
+      bool readable = true;
+      for (; end < objects.size() && objects[end].first == f; ++end)
+        if (failed[end])
+        {
+          fprintf(context.out, "Unable to read object at %lu of %s\n", keys[f][objects[end].second].seekKey, path.c_str());
+          readable = false;
+        }
+      if (!readable)
+      {
+        fprintf(context.out, "%s is left out of the store.\n", path.c_str());
+        continue;
+      }
+      uint32_t fileId = known.size() + files.size();
+      size_t inserted = begin;
+      if (store.reserve(end - begin))
+        for (; inserted < end; ++inserted)
+        {
+          KeyInfo const &key = keys[f][objects[inserted].second];
+          if (!store.insert(&digests[inserted * SHA1_SIZE], fileId, key.seekKey, key.objLen))
+            break;
+          AddedObject object;
+          memcpy(object.digest, &digests[inserted * SHA1_SIZE], SHA1_SIZE);
+          object.file = fileId;
+          object.classId = classIds.insert(std::make_pair(key.className, classNames.size())).first->second;
+          if (object.classId == classNames.size())
+            classNames.push_back(key.className);
+          object.offset = key.seekKey;
+          object.size = key.objLen;
+          added.push_back(object);
+        }
+      if (inserted == end && addCorpusFile(storeName, path))
+      {
+        files.push_back(path);
+        continue;
+      }
+      while (inserted-- > begin)
+        store.release(&digests[inserted * SHA1_SIZE]);
+      valid = false;
+    }
+  }
+  if (!valid)
+  {
+    fprintf(context.out, "Unable to update the store %s.\n", storeName);
+    scan.clear();
+    return;
+  }
+
+  // Duplicate bytes are those of the copies found after the first one,
+  // shared bytes those of the objects found more than once in the store.
+  struct Usage {
+    size_t objects;
+    size_t bytes;
+    size_t duplicate;
+    size_t shared;
+  };
+  Usage const none = {0, 0, 0, 0};
+  std::map<std::string, Usage> classes;
+  std::vector<Usage> perFile(files.size(), none);
+  for (size_t i = 0; i < added.size(); ++i)
+  {
+    AddedObject const &object = added[i];
+    CorpusEntry const &entry = *store.slot(object.digest);
+    bool duplicate = entry.file != object.file || entry.offset != object.offset;
+    Usage &usage = classes.insert(std::make_pair(classNames[object.classId], none)).first->second;
+    Usage &fileUsage = perFile[object.file - known.size()];
+    for (Usage *u : {&usage, &fileUsage})
+    {
+      u->objects += 1;
+      u->bytes += object.size;
+      u->duplicate += duplicate ? object.size : 0;
+      u->shared += entry.refs > 1 ? object.size : 0;
+    }
+  }
+  std::vector<std::pair<size_t, std::string> > byDuplicate;
+  for (std::map<std::string, Usage>::const_iterator c = classes.begin(); c != classes.end(); ++c)
+    byDuplicate.push_back(std::make_pair(c->second.duplicate, c->first));
+  std::sort(byDuplicate.rbegin(), byDuplicate.rend());
+  for (size_t c = 0; c < byDuplicate.size(); ++c)
+  {
+    Usage const &usage = classes[byDuplicate[c].second];
+    fprintf(context.out, "Class %s: %lu objects, %lu bytes, %lu shared, %lu duplicate\n", byDuplicate[c].second.c_str(),
+                         usage.objects, usage.bytes, usage.shared, usage.duplicate);
+  }
+  for (size_t f = 0; f < files.size(); ++f)
+    fprintf(context.out, "File %s: %lu objects, %lu bytes, %lu shared, %lu duplicate\n", files[f].c_str(),
+                         perFile[f].objects, perFile[f].bytes, perFile[f].shared, perFile[f].duplicate);
+  uint64_t distinct = 0, distinctBytes = 0, totalBytes = 0;
+  for (uint64_t i = 0; i < store.header().capacity; ++i)
+  {
+    CorpusEntry const &entry = store.entries()[i];
+    if (!entry.refs)
+      continue;
+    ++distinct;
+    distinctBytes += entry.size;
+    totalBytes += entry.size * entry.refs;
+  }
+  fprintf(context.out, "Store %s: %lu files, %llu distinct objects, %llu distinct of %llu bytes.\n", storeName,
+                       known.size() + files.size(), (unsigned long long) distinct, (unsigned long long) distinctBytes,
+                       (unsigned long long) totalBytes);
+  scan.clear();
+}
+
+/** Answer the query in BasketScan::selection (see CatalogHelpers.h) on the
+    catalog of the keys of the file, which is built at the first query.
+  */
+void
+queryDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  KeyCatalog &catalog = *context.catalog;
+  if (!catalog.size())
+  {
+    std::vector<KeyInfo> keys;
+    if (!readKeys(context.fd, keys))
+    {
+      fprintf(context.out, "Unable to read the keys of the file.\n");
+      scan.clear();
+      return;
+    }
+    for (size_t i = 0; i < keys.size(); ++i)
+      catalog.add(keys[i]);
+  }
+  CatalogQuery query;
+  if (!parseQuery(catalog, scan.selection, query, context.out))
+  {
+    scan.clear();
+    return;
+  }
+  std::vector<uint64_t> selected;
+  selectKeys(catalog, query.where, selected);
+
+  if (query.group == CATALOG_COLUMNS)
+  {
+    std::vector<size_t> keys;
+    selectedKeys(selected, keys);
+    CatalogColumn order = catalogColumn(catalogColumnSpecs, query.order.c_str());
+    if (order != CATALOG_COLUMNS)
+    {
+      std::vector<uint64_t> const &values = catalog.columns[order];
+      bool interned = catalogColumnSpecs[order].interned;
+      bool descending = query.descending;
+      auto before = [&](size_t a, size_t b) {
+        if (values[a] == values[b])
+          return a < b;
+        bool less = interned ? catalog.strings[values[a]] < catalog.strings[values[b]] : values[a] < values[b];
+        return descending ? !less : less;
+      };
+      size_t sorted = std::min(query.limit, keys.size());
+      std::partial_sort(keys.begin(), keys.begin() + sorted, keys.end(), before);
+    }
+    for (size_t k = 0; k < keys.size() && k < query.limit; ++k)
+    {
+      size_t i = keys[k];
+      fprintf(context.out, "Key at %s: %s %s;%s, %s bytes, %s uncompressed, %s\n", catalog.format(CATALOG_OFFSET, i).c_str(),
+                           catalog.format(CATALOG_CLASS, i).c_str(), catalog.format(CATALOG_NAME, i).c_str(),
+                           catalog.format(CATALOG_CYCLE, i).c_str(), catalog.format(CATALOG_NBYTES, i).c_str(),
+                           catalog.format(CATALOG_OBJLEN, i).c_str(), catalog.format(CATALOG_ALGORITHM, i).c_str());
+    }
+    fprintf(context.out, "%lu of %lu keys selected.\n", keys.size(), catalog.size());
+    scan.clear();
+    return;
+  }
+
+  std::vector<CatalogGroup> groups;
+  groupKeys(catalog, selected, query.group, groups);
+  std::string const &order = query.order;
+  bool descending = query.descending;
+  auto before = [&](CatalogGroup const &a, CatalogGroup const &b) {
+    double x = order == "keys" ? a.keys : order == "nbytes" ? a.nbytes : order == "objlen" ? a.objLen
+             : order == "ratio" ? (double) a.objLen / std::max(a.nbytes, (uint64_t) 1) : 0;
+    double y = order == "keys" ? b.keys : order == "nbytes" ? b.nbytes : order == "objlen" ? b.objLen
+             : order == "ratio" ? (double) b.objLen / std::max(b.nbytes, (uint64_t) 1) : 0;
+    if (x == y)
+      return descending ? catalog.strings[a.value] > catalog.strings[b.value]
+                        : catalog.strings[a.value] < catalog.strings[b.value];
+    return descending ? x > y : x < y;
+  };
+  std::sort(groups.begin(), groups.end(), before);
+  for (size_t g = 0; g < groups.size() && g < query.limit; ++g)
+    fprintf(context.out, "%s %s: %llu keys, %llu bytes, %llu uncompressed, ratio %.2f\n", catalogColumnSpecs[query.group].label,
+                         catalog.strings[groups[g].value].c_str(), (unsigned long long) groups[g].keys,
+                         (unsigned long long) groups[g].nbytes, (unsigned long long) groups[g].objLen,
+                         (double) groups[g].objLen / std::max(groups[g].nbytes, (uint64_t) 1));
+  scan.clear();
+}
+
+/** Sum the size on disk and uncompressed of the keys of the file, by
+    directory, class and branch, and by compression, from their headers
+    only. With "verify" (BasketScan::argument), all the objects are also
+    decompressed, in parallel, to check that their uncompressed size is the
+    one of their header.
+  */
+void
+duDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  brut::RootFile file;
+  std::vector<KeyInfo> keys;
+  std::vector<std::string> directories;
+  if (!rootFileKeys(context.filename, file, keys, directories))
+  {
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+    scan.clear();
+    return;
+  }
+  UsageTree tree;
+  std::map<std::string, Usage> compressions;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    tree.add(usageNode(keys[i], directories[i]), keys[i]);
+    compressions[usageCompression(keys[i])].add(keys[i]);
+  }
+  tree.print(usageRoot, 0, context.out);
+  for (std::map<std::string, Usage>::const_iterator c = compressions.begin(); c != compressions.end(); ++c)
+    c->second.print(("Compression " + c->first).c_str(), 0, context.out);
+
+  if (scan.argument.empty())
+  {
+    scan.clear();
+    return;
+  }
+  std::vector<char> failed(keys.size(), 0);
+  std::vector<std::vector<char> > payloads(parallelThreads());
+  parallelFor(keys.size(), [&](size_t i, unsigned thread) {
+    failed[i] = !file.read(file[i], payloads[thread]);
+  });
+  size_t verified = 0;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    if (failed[i])
+      fprintf(context.out, "Object at %lu does not decompress to %u bytes.\n", keys[i].seekKey, keys[i].objLen);
+    else
+      ++verified;
+  }
+  fprintf(context.out, "%lu of %lu objects verified.\n", verified, keys.size());
+  scan.clear();
+}
+
+/** Decompress the objects of the file, or a sample of them within the
+    budget of BasketScan::options, and compress them again with each of the
+    codecs, at each of their levels, in parallel, with one CodecContext per
+    thread. The ratio and the compression and decompression throughputs are
+    reported per class, and also written as NDJSON if requested.
+  */
+void
+recompressBenchDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  std::vector<KeyInfo> keys;
+  if (!readKeys(context.fd, keys))
+  {
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+    scan.clear();
+    return;
+  }
+  std::vector<std::string> directories;
+  keyDirectories(keys, directories);
+  std::vector<size_t> objects;
+  std::vector<SampleCandidate> candidates;
+  std::map<std::string, size_t> basketIndex;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    if (merkleIgnored(keys[i]))
+      continue;
+    std::string name = merkleLeaf(keys[i], directories[i], basketIndex[keys[i].title + "/" + keys[i].name]++);
+    SampleCandidate candidate = {sampleStratum(keys[i].className, keys[i].objLen), sampleRank(name, 0), keys[i].objLen};
+    candidates.push_back(candidate);
+    objects.push_back(i);
+  }
+  if (scan.options.count("budget"))
+  {
+    std::vector<size_t> selected;
+    selectSample(candidates, strtoull(scan.options["budget"].c_str(), 0, 10), selected);
+    for (size_t s = 0; s < selected.size(); ++s)
+      selected[s] = objects[selected[s]];
+    objects.swap(selected);
+  }
+  FILE *ndjson = 0;
+  if (scan.options.count("ndjson") && !(ndjson = fopen(scan.options["ndjson"].c_str(), "w")))
+  {
+    fprintf(context.out, "Unable to write %s.\n", scan.options["ndjson"].c_str());
+    scan.clear();
+    return;
+  }
+
+  // All the (codec, level) pairs to try.
+  std::vector<std::pair<Codec const *, int> > settings;
+  for (Codec const *codec = codecs; codec->name; ++codec)
+    for (int const *level = codec->levels; *level; ++level)
+      settings.push_back(std::make_pair(codec, *level));
+  CodecResult const none = {0, 0, 0, 0, 0, 0};
+  typedef std::map<std::string, std::vector<CodecResult> > ClassResults;
+  std::vector<ClassResults> partials(parallelThreads());
+  std::vector<CodecContext> contexts(parallelThreads());
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > payloads(parallelThreads());
+  std::vector<std::vector<unsigned char> > compressed(parallelThreads());
+  std::vector<std::vector<unsigned char> > checks(parallelThreads());
+  std::vector<char> unreadable(objects.size(), 0);
+  parallelFor(objects.size(), [&](size_t o, unsigned thread) {
+    KeyInfo const &key = keys[objects[o]];
+    std::vector<char> &payload = payloads[thread];
+    payload.resize(key.objLen + 1);
+    if (!readKey(context.fd, key, scratch[thread], &payload[0]))
+    {
+      unreadable[o] = 1;
+      return;
+    }
+    std::vector<CodecResult> &results = partials[thread][key.className];
+    results.resize(settings.size(), none);
+    std::vector<unsigned char> &check = checks[thread];
+    check.resize(key.objLen + 1);
+    for (size_t s = 0; s < settings.size(); ++s)
+    {
+      Codec const &codec = *settings[s].first;
+      CodecResult &result = results[s];
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      bool valid = codec.compress(contexts[thread], settings[s].second, (unsigned char const *) &payload[0],
+                                  key.objLen, compressed[thread]);
+      std::chrono::steady_clock::time_point compressedAt = std::chrono::steady_clock::now();
+      valid = valid && codec.decompress(contexts[thread], &compressed[thread][0], compressed[thread].size(),
+                                        &check[0], key.objLen);
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+      if (!valid || memcmp(&check[0], &payload[0], key.objLen) != 0)
+      {
+        result.failed += 1;
+        continue;
+      }
+      result.objects += 1;
+      result.bytes += key.objLen;
+      result.compressed += compressed[thread].size();
+      result.compressTime += std::chrono::duration<double>(compressedAt - start).count();
+      result.decompressTime += std::chrono::duration<double>(end - compressedAt).count();
+    }
+  });
+  for (size_t o = 0; o < objects.size(); ++o)
+    if (unreadable[o])
+      fprintf(context.out, "Unable to read object at %lu\n", keys[objects[o]].seekKey);
+
+  // The totals of all the classes go first, with an empty class name.
+  ClassResults totals;
+  std::vector<CodecResult> &all = totals[""];
+  all.resize(settings.size(), none);
+  for (size_t t = 0; t < partials.size(); ++t)
+    for (ClassResults::const_iterator c = partials[t].begin(); c != partials[t].end(); ++c)
+    {
+      std::vector<CodecResult> &results = totals[c->first];
+      results.resize(settings.size(), none);
+      for (size_t s = 0; s < settings.size(); ++s)
+      {
+        results[s].merge(c->second[s]);
+        all[s].merge(c->second[s]);
+      }
+    }
+  for (ClassResults::const_iterator c = totals.begin(); c != totals.end(); ++c)
+    for (size_t s = 0; s < settings.size(); ++s)
+    {
+      CodecResult const &r = c->second[s];
+      double ratio = (double) r.bytes / std::max(r.compressed, (uint64_t) 1);
+      double compressSpeed = r.bytes / std::max(r.compressTime, 1e-9) / (1 << 20);
+      double decompressSpeed = r.bytes / std::max(r.decompressTime, 1e-9) / (1 << 20);
+      fprintf(context.out, "%s%s, %s level %i: %llu objects, %llu bytes, ratio %.2f, compression %.1f MB/s, decompression %.1f MB/s",
+                           c->first.empty() ? "All classes" : "Class ", c->first.c_str(), settings[s].first->name, settings[s].second, (unsigned long long) r.objects,
+                           (unsigned long long) r.bytes, ratio, compressSpeed, decompressSpeed);
+      if (r.failed)
+        fprintf(context.out, ", %llu failed", (unsigned long long) r.failed);
+      fprintf(context.out, "\n");
+      if (ndjson)
+        fprintf(ndjson, "{\"class\": \"%s\", \"algorithm\": \"%s\", \"level\": %i, \"objects\": %llu, \"bytes\": %llu, "
+                        "\"compressed\": %llu, \"compressSeconds\": %.9f, \"decompressSeconds\": %.9f, \"failed\": %llu}\n",
+                c->first.empty() ? "*" : jsonString(c->first).c_str(), settings[s].first->name, settings[s].second,
+                (unsigned long long) r.objects, (unsigned long long) r.bytes, (unsigned long long) r.compressed,
+                r.compressTime, r.decompressTime, (unsigned long long) r.failed);
+    }
+  if (ndjson && fclose(ndjson) != 0)
+    fprintf(context.out, "Unable to write %s.\n", scan.options["ndjson"].c_str());
+  scan.clear();
+}
+
+// The layout of the objects of a few classes, for diffobj.
+struct ObjectSpec {
+  char const      *className;
+  FieldSpec const *spec;
+};
+
+constexpr ObjectSpec objectSpecs[] = {
+  {"TDirectory", topDirSpec},
+  {"TDirectoryFile", topDirSpec},
+  {0, 0}
+};
+
+FieldSpec const *objectSpec(std::string const &className)
+{
+  for (ObjectSpec const *s = objectSpecs; s->className; ++s)
+    if (className == s->className)
+      return s->spec;
+  return 0;
+}
+
+// The most lines of each range and the most ranges shown by diffobj.
+constexpr int diffMaxLines = 8;
+constexpr size_t diffMaxRanges = 64;
+
+// Print the fields overlapping [@a begin, @a end) of @a a, laid out as
+// @a fields, which differ from the same fields of @a b, laid out as
+// @a otherFields.
+void printFieldDiffs(std::vector<FieldLayout> const &fields, char const *a,
+                     std::vector<FieldLayout> const &otherFields, char const *b,
+                     size_t begin, size_t end, char const *what, FILE *out)
+{
+  for (size_t i = 0; i < fields.size() && i < otherFields.size(); ++i)
+  {
+    FieldLayout const &field = fields[i];
+    if (field.offset >= end || field.offset + field.size <= begin)
+      continue;
+    std::string value = formatField(field, a);
+    std::string otherValue = formatField(otherFields[i], b);
+    if (field.name == otherFields[i].name && value == otherValue)
+      continue;
+    fprintf(out, "%s field %s: %s | %s\n", what, field.name.c_str(), value.c_str(), otherValue.c_str());
+  }
+}
+
+// The layout of the key header @a header, including the TBasket part.
+void keyLayout(KeyInfo const &key, char const *header, std::vector<FieldLayout> &fields)
+{
+  size_t used = specLayout(keyHeaderSpec, header, key.keyLen, fields);
+  if (key.className == "TBasket")
+    specLayout(basketHeaderSpec, header + used, key.keyLen - used, fields, "TBasket.", used);
+}
+
+/** Compare byte by byte the object whose key is at current.pos with the one
+    whose key is at current.size, in the file BasketScan::argument, if given,
+    in this file otherwise. Key headers are compared field by field, payloads
+    are decompressed and shown where they differ.
+  */
+void
+diffObjectDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  char const *otherName = scan.argument.empty() ? "this file" : scan.argument.c_str();
+  int otherFd = scan.argument.empty() ? context.fd : open(otherName, O_RDONLY);
+  KeyInfo key, otherKey;
+  if (readKeyInfo(context.fd, current.pos, key) <= 0)
+    fprintf(context.out, "No key at %lu.\n", current.pos);
+  else if (otherFd < 0)
+    fprintf(context.out, "Unable to read %s.\n", otherName);
+  else if (readKeyInfo(otherFd, current.size, otherKey) <= 0)
+    fprintf(context.out, "No key at %lu in %s.\n", current.size, otherName);
+  else
+  {
+    fprintf(context.out, "Comparing %s %s/%s at %lu with %s %s/%s at %lu in %s.\n",
+                         key.className.c_str(), key.title.c_str(), key.name.c_str(), key.seekKey,
+                         otherKey.className.c_str(), otherKey.title.c_str(), otherKey.name.c_str(), otherKey.seekKey, otherName);
+    std::vector<char> header(key.keyLen), otherHeader(otherKey.keyLen);
+    std::vector<char> payload(key.objLen + 1), otherPayload(otherKey.objLen + 1);
+    std::vector<char> scratch;
+    if (!preadAll(context.fd, &header[0], key.keyLen, key.seekKey)
+        || !preadAll(otherFd, &otherHeader[0], otherKey.keyLen, otherKey.seekKey)
+        || !readKey(context.fd, key, scratch, &payload[0])
+        || !readKey(otherFd, otherKey, scratch, &otherPayload[0]))
+      fprintf(context.out, "Unable to read the objects.\n");
+    else
+    {
+      std::vector<FieldLayout> fields, otherFields;
+      keyLayout(key, &header[0], fields);
+      keyLayout(otherKey, &otherHeader[0], otherFields);
+      printFieldDiffs(fields, &header[0], otherFields, &otherHeader[0], 0, key.keyLen, "key", context.out);
+
+      size_t size = std::min(key.objLen, otherKey.objLen);
+      if (key.objLen != otherKey.objLen)
+        fprintf(context.out, "Objects have different sizes: %u | %u.\n", key.objLen, otherKey.objLen);
+      std::vector<DiffRange> ranges;
+      diffRanges(&payload[0], &otherPayload[0], size, ranges);
+      fields.clear();
+      otherFields.clear();
+      FieldSpec const *spec = key.className == otherKey.className ? objectSpec(key.className) : 0;
+      if (spec)
+      {
+        specLayout(spec, &payload[0], key.objLen, fields);
+        specLayout(spec, &otherPayload[0], otherKey.objLen, otherFields);
+      }
+      size_t bytes = 0;
+      for (size_t r = 0; r < ranges.size(); ++r)
+      {
+        DiffRange const &range = ranges[r];
+        bytes += range.end - range.begin;
+        if (r >= diffMaxRanges)
+          continue;
+        fprintf(context.out, "Bytes %lu-%lu differ, in this file:", range.begin, range.end);
+        dump_hex(&payload[range.begin], range.end - range.begin, range.begin, diffMaxLines - 1, context.out);
+        fprintf(context.out, "and in %s:", otherName);
+        dump_hex(&otherPayload[range.begin], range.end - range.begin, range.begin, diffMaxLines - 1, context.out);
+        printFieldDiffs(fields, &payload[0], otherFields, &otherPayload[0], range.begin, range.end, "object", context.out);
+      }
+      if (ranges.size() > diffMaxRanges)
+        fprintf(context.out, "... %lu more ranges.\n", ranges.size() - diffMaxRanges);
+      if (ranges.empty() && key.objLen == otherKey.objLen)
+        fprintf(context.out, "Objects are identical.\n");
+      else
+        fprintf(context.out, "%lu bytes differ, in %lu ranges.\n", bytes, ranges.size());
+    }
+  }
+  if (otherFd >= 0 && otherFd != context.fd)
+    close(otherFd);
+  scan.clear();
+}
+
+// Add to @a records the record @a name of both files, @a size bytes at
+// @a a and @a b, laid out according to @a spec, if their layouts are the
+// same. Otherwise report the fields which differ. @return whether it was
+// added.
+bool addMetaRecord(MetaRecords &records, std::string const &name, FieldSpec const *spec,
+                   char const *a, size_t size, char const *b, size_t otherSize, FILE *out)
+{
+  std::vector<FieldLayout> fields, otherFields;
+  size_t used = specLayout(spec, a, size, fields);
+  size_t otherUsed = specLayout(spec, b, otherSize, otherFields);
+  if (used == otherUsed && sameLayout(fields, otherFields))
+  {
+    records.add(name, a, b, used, fields);
+    return true;
+  }
+  printFieldDiffs(fields, a, otherFields, b, 0, used, name.c_str(), out);
+  return false;
+}
+
+/** The names of @a keys for comparemeta: their Merkle leaf, followed by
+    "#<n>" for the n-th key after the first one with the same leaf, e.g. the
+    keys list and the free segments, which have the name and cycle of the
+    TFile key.
+  */
+void metaKeyNames(std::vector<KeyInfo> const &keys, std::vector<std::string> &names)
+{
+  std::vector<std::string> directories;
+  keyDirectories(keys, directories);
+  std::map<std::string, size_t> basketIndex, occurrences;
+  names.clear();
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    std::string name = merkleLeaf(keys[i], directories[i], basketIndex[keys[i].title + "/" + keys[i].name]++);
+    if (size_t n = occurrences[name]++)
+    {
+      char suffix[32];
+      snprintf(suffix, sizeof(suffix), "#%lu", (unsigned long) n);
+      name += suffix;
+    }
+    names.push_back(name);
+  }
+}
+
+/** Compare the metadata of this file with the one of the file
+    BasketScan::argument: file headers, top directories, and the key headers
+    and directory records of the keys with the same name, as given by
+    merkleLeaf. MUTABLE fields are ignored.
+  */
+void
+compareMetaDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  char const *reference = scan.argument.c_str();
+  int referenceFd = open(reference, O_RDONLY);
+  std::vector<KeyInfo> keys, referenceKeys;
+  char header[128], referenceHeader[128], topDir[128], referenceTopDir[128];
+  size_t headerSize = 0, referenceHeaderSize = 0;
+  if (!readKeys(context.fd, keys) || !(headerSize = readFileHeader(context.fd, header)))
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+  else if (referenceFd < 0 || !readKeys(referenceFd, referenceKeys)
+           || !(referenceHeaderSize = readFileHeader(referenceFd, referenceHeader)))
+    fprintf(context.out, "Unable to read %s.\n", reference);
+  else
+  {
+    size_t differ = 0, compared = 1;
+    MetaRecords records;
+    differ += !addMetaRecord(records, "file header", fileHeaderSpec, header, headerSize,
+                             referenceHeader, referenceHeaderSize, context.out);
+    size_t top = topDirectoryPosition(header, keys);
+    size_t referenceTop = topDirectoryPosition(referenceHeader, referenceKeys);
+    if (top || referenceTop)
+    {
+      ++compared;
+      ssize_t topDirSize = top ? pread(context.fd, topDir, sizeof(topDir), top) : 0;
+      ssize_t referenceTopDirSize = referenceTop ? pread(referenceFd, referenceTopDir, sizeof(referenceTopDir), referenceTop) : 0;
+      differ += !addMetaRecord(records, "top directory", topDirSpec, topDir, std::max(topDirSize, (ssize_t) 0),
+                               referenceTopDir, std::max(referenceTopDirSize, (ssize_t) 0), context.out);
+    }
+
+    std::vector<std::string> names, referenceNames;
+    metaKeyNames(keys, names);
+    metaKeyNames(referenceKeys, referenceNames);
+    std::map<std::string, size_t> referenceIndex;
+    for (size_t i = 0; i < referenceKeys.size(); ++i)
+      referenceIndex[referenceNames[i]] = i;
+    std::vector<char> a, b, scratch;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      std::string const &name = names[i];
+      std::map<std::string, size_t>::iterator r = referenceIndex.find(name);
+      if (r == referenceIndex.end())
+      {
+        fprintf(context.out, "%s only in this file\n", name.c_str());
+        ++differ;
+        continue;
+      }
+      KeyInfo const &key = keys[i];
+      KeyInfo const &referenceKey = referenceKeys[r->second];
+      referenceIndex.erase(r);
+      ++compared;
+      a.resize(key.keyLen);
+      b.resize(referenceKey.keyLen);
+      if (!preadAll(context.fd, &a[0], a.size(), key.seekKey)
+          || !preadAll(referenceFd, &b[0], b.size(), referenceKey.seekKey))
+      {
+        fprintf(context.out, "Unable to read key %s.\n", name.c_str());
+        ++differ;
+        continue;
+      }
+      std::vector<FieldLayout> fields, referenceFields;
+      keyLayout(key, &a[0], fields);
+      keyLayout(referenceKey, &b[0], referenceFields);
+      if (a.size() == b.size() && sameLayout(fields, referenceFields))
+        records.add(name + " key", &a[0], &b[0], a.size(), fields);
+      else
+      {
+        printFieldDiffs(fields, &a[0], referenceFields, &b[0], 0, a.size(), (name + " key").c_str(), context.out);
+        ++differ;
+      }
+      if (key.className != "TDirectory" && key.className != "TDirectoryFile")
+        continue;
+      ++compared;
+      a.resize(key.objLen + 1);
+      b.resize(referenceKey.objLen + 1);
+      if (!readKey(context.fd, key, scratch, &a[0]) || !readKey(referenceFd, referenceKey, scratch, &b[0]))
+      {
+        fprintf(context.out, "Unable to read directory %s.\n", name.c_str());
+        ++differ;
+        continue;
+      }
+      differ += !addMetaRecord(records, name + " directory", topDirSpec, &a[0], key.objLen, &b[0], referenceKey.objLen, context.out);
+    }
+    for (std::map<std::string, size_t>::const_iterator r = referenceIndex.begin(); r != referenceIndex.end(); ++r, ++differ)
+      fprintf(context.out, "%s only in %s\n", r->first.c_str(), reference);
+
+    std::vector<size_t> differing;
+    records.compare(differing);
+    for (size_t d = 0; d < differing.size(); ++d)
+    {
+      MetaRecord const &record = records.records[differing[d]];
+      char const *a = &records.a[record.offset];
+      char const *b = &records.b[record.offset];
+      for (size_t f = 0; f < record.fields.size(); ++f)
+      {
+        FieldLayout const &field = record.fields[f];
+        if (field.spec->type == MUTABLE || memcmp(a + field.offset, b + field.offset, field.size) == 0)
+          continue;
+        fprintf(context.out, "%s field %s: %s | %s\n", record.name.c_str(), field.name.c_str(),
+                             formatField(field, a).c_str(), formatField(field, b).c_str());
+      }
+    }
+    differ += differing.size();
+    fprintf(context.out, "%lu compared, %lu differ.\n", compared, differ);
+  }
+  if (referenceFd >= 0)
+    close(referenceFd);
+  scan.clear();
+}
+
+/** Append to @a ranges the MUTABLE fields of the key headers in the keys
+    list of a directory, whose key is @a key: the number of keys followed by
+    a copy of their headers.
+  */
+void keysListMutableRanges(int fd, KeyInfo const &key, std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  std::vector<char> list(key.objLen);
+  if (key.nbytes - key.keyLen != key.objLen || list.size() < 4
+      || !preadAll(fd, &list[0], list.size(), key.seekKey + key.keyLen))
+    return;
+  size_t nKeys = (unsigned) bswap_32(*(unsigned *) &list[0]);
+  size_t pos = 4;
+  for (size_t i = 0; i < nKeys && pos < list.size(); ++i)
+  {
+    std::vector<FieldLayout> fields;
+    specLayout(keyHeaderSpec, &list[pos], list.size() - pos, fields);
+    size_t keyLen = fieldValue(fields, &list[pos], "KeyLen");
+    if (!keyLen)
+      break;
+    mutableRanges(fields, key.seekKey + key.keyLen + pos, ranges);
+    pos += keyLen;
+  }
+}
+
+/** Write to BasketScan::argument a copy of the file with all the MUTABLE
+    fields zeroed: in the file header, in the directory records and in the
+    key headers, including their copies in the keys lists. The file is
+    copied by the kernel, possibly sharing its blocks, and then only the
+    MUTABLE fields are overwritten.
+  */
+void
+canonicalizeDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  char const *output = scan.argument.c_str();
+  std::vector<KeyInfo> keys;
+  char header[fileHeaderBigSize];
+  size_t headerSize = 0;
+  if (!readKeys(context.fd, keys) || !(headerSize = readFileHeader(context.fd, header)))
+  {
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+    scan.clear();
+    return;
+  }
+  // Truncating the output would lose the file itself.
+  struct stat info, outputInfo;
+  if (stat(output, &outputInfo) == 0 && fstat(context.fd, &info) == 0
+      && outputInfo.st_dev == info.st_dev && outputInfo.st_ino == info.st_ino)
+  {
+    fprintf(context.out, "%s is the file itself.\n", output);
+    scan.clear();
+    return;
+  }
+  std::vector<std::pair<size_t, size_t> > ranges;
+  std::vector<FieldLayout> fields;
+  specLayout(fileHeaderSpec, header, headerSize, fields);
+  mutableRanges(fields, 0, ranges);
+
+  std::map<size_t, KeyInfo const *> keysByPosition;
+  for (size_t i = 0; i < keys.size(); ++i)
+    keysByPosition[keys[i].seekKey] = &keys[i];
+  // The directory records: the top one, after the name of the file in the
+  // TFile key, and the ones of the subdirectories, which are their objects.
+  std::vector<size_t> directories;
+  if (size_t top = topDirectoryPosition(header, keys))
+    directories.push_back(top);
+  std::vector<char> data;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    KeyInfo const &key = keys[i];
+    data.resize(key.keyLen);
+    if (!preadAll(context.fd, &data[0], key.keyLen, key.seekKey))
+      continue;
+    fields.clear();
+    keyLayout(key, &data[0], fields);
+    mutableRanges(fields, key.seekKey, ranges);
+    if (key.className != "TDirectory" && key.className != "TDirectoryFile")
+      continue;
+    if (key.nbytes - key.keyLen == key.objLen)
+      directories.push_back(key.seekKey + key.keyLen);
+    else
+      fprintf(context.out, "Directory %s is compressed, its dates are left as they are.\n", key.name.c_str());
+  }
+  for (size_t d = 0; d < directories.size(); ++d)
+  {
+    data.resize(128);
+    ssize_t size = pread(context.fd, &data[0], data.size(), directories[d]);
+    if (size <= 0)
+      continue;
+    fields.clear();
+    specLayout(topDirSpec, &data[0], size, fields);
+    mutableRanges(fields, directories[d], ranges);
+    std::map<size_t, KeyInfo const *>::const_iterator list = keysByPosition.find(fieldValue(fields, &data[0], "fSeekKeys"));
+    if (list != keysByPosition.end())
+      keysListMutableRanges(context.fd, *list->second, ranges);
+  }
+
+  int out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = out >= 0 && fstat(context.fd, &info) == 0 && copyRange(context.fd, 0, out, 0, info.st_size);
+  std::vector<char> zeros;
+  for (size_t r = 0; ok && r < ranges.size(); ++r)
+  {
+    zeros.resize(ranges[r].second);
+    ok = pwrite(out, &zeros[0], zeros.size(), ranges[r].first) == (ssize_t) zeros.size();
+  }
+  if (out >= 0)
+    close(out);
+  if (ok)
+    fprintf(context.out, "%lu fields zeroed in %s.\n", ranges.size(), output);
+  else
+    fprintf(context.out, "Unable to write %s.\n", output);
+  scan.clear();
+}
+
+/** Whether @a key is selected by one of @a selection: its offset, its name,
+    or class=<its class>.
+  */
+bool keySelected(KeyInfo const &key, std::vector<std::string> const &selection)
+{
+  char offset[32];
+  snprintf(offset, sizeof(offset), "%lu", key.seekKey);
+  for (size_t i = 0; i < selection.size(); ++i)
+    if (selection[i] == offset || selection[i] == key.name || selection[i] == "class=" + key.className)
+      return true;
+  return false;
+}
+
+/** Format in the @a size bytes of @a name the file the object of @a key is
+    extracted to: <offset>.<class>.<name>.
+    @return false if it does not fit.
+  */
+bool formatExtractedName(KeyInfo const &key, char *name, size_t size)
+{
+  int length = snprintf(name, size, "%lu.%s.%s", key.seekKey, key.className.c_str(), key.name.c_str());
+  if (length < 0 || (size_t) length >= size)
+    return false;
+  for (char *c = name; *c; ++c)
+    if (*c == '/' || *c == ' ')
+      *c = '_';
+  return true;
+}
+
+/** Write the uncompressed objects of the keys selected by
+    BasketScan::selection to files in the directory BasketScan::argument.
+    Uncompressed objects are copied by the kernel, compressed ones are
+    decompressed, in parallel, straight into their mapped output files.
+  */
+void
+extractDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  std::vector<KeyInfo> keys;
+  if (!readKeys(context.fd, keys))
+  {
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+    scan.clear();
+    return;
+  }
+  std::vector<size_t> selected;
+  for (size_t i = 0; i < keys.size(); ++i)
+    if (keySelected(keys[i], scan.selection))
+      selected.push_back(i);
+
+  std::vector<char> failed(selected.size(), 0);
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  parallelFor(selected.size(), [&](size_t s, unsigned thread) {
+    KeyInfo const &key = keys[selected[s]];
+    // The output file name is formatted on the stack of each thread.
+    char filename[PATH_MAX];
+    int directory = snprintf(filename, sizeof(filename), "%s/", scan.argument.c_str());
+    if (directory < 0 || (size_t) directory >= sizeof(filename)
+        || !formatExtractedName(key, filename + directory, sizeof(filename) - directory))
+    {
+      failed[s] = 1;
+      return;
+    }
+    int out = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+    {
+      failed[s] = 1;
+      return;
+    }
+    if (key.nbytes - key.keyLen == key.objLen)
+      failed[s] = !copyRange(context.fd, key.seekKey + key.keyLen, out, 0, key.objLen);
+    else if (ftruncate(out, key.objLen) != 0)
+      failed[s] = 1;
+    else if (key.objLen)
+    {
+      char *output = (char *) mmap(0, key.objLen, PROT_READ | PROT_WRITE, MAP_SHARED, out, 0);
+      if (output == MAP_FAILED)
+        failed[s] = 1;
+      else
+      {
+        failed[s] = !readKey(context.fd, key, scratch[thread], output);
+        failed[s] |= munmap(output, key.objLen) != 0;
+      }
+    }
+    failed[s] |= close(out) != 0;
+  });
+
+  size_t bytes = 0, extracted = 0;
+  char filename[PATH_MAX];
+  for (size_t s = 0; s < selected.size(); ++s)
+  {
+    KeyInfo const &key = keys[selected[s]];
+    if (failed[s])
+    {
+      fprintf(context.out, "Unable to extract %s at %lu.\n", key.name.c_str(), key.seekKey);
+      continue;
+    }
+    formatExtractedName(key, filename, sizeof(filename));
+    fprintf(context.out, "Extracted %s %s at %lu to %s.\n", key.className.c_str(), key.name.c_str(), key.seekKey,
+                         filename);
+    bytes += key.objLen;
+    ++extracted;
+  }
+  fprintf(context.out, "%lu objects, %lu bytes, extracted to %s.\n", extracted, bytes, scan.argument.c_str());
+  scan.clear();
+}
+
+// Decode the histograms of @a paths in @a histograms, in parallel. Those
+// which cannot be decoded are reported and get an empty class name.
+void
+decodeHistograms(int fd, char const *filename, std::map<std::string, KeyInfo> const &histograms,
+                 std::vector<std::string> const &paths, std::vector<Histogram> &decoded, FILE *out)
+{
+  decoded.assign(paths.size(), Histogram());
+  std::vector<std::string> errors(paths.size());
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > payloads(parallelThreads());
+  parallelFor(paths.size(), [&](size_t i, unsigned thread) {
+    KeyInfo const &key = histograms.find(paths[i])->second;
+    std::vector<char> &payload = payloads[thread];
+    payload.resize(key.objLen + 1);
+    if (!readKey(fd, key, scratch[thread], &payload[0]))
+    {
+      errors[i] = "unable to read it";
+      return;
+    }
+    try
+    {
+      decodeHistogram(key.className, &payload[0], key.objLen, decoded[i]);
+    }
+    catch (char const *error)
+    {
+      decoded[i].className.clear();
+      errors[i] = error;
+    }
+  });
+  for (size_t i = 0; i < paths.size(); ++i)
+    if (!errors[i].empty())
+      fprintf(out, "Unable to decode histogram %s in %s: %s.\n", paths[i].c_str(), filename, errors[i].c_str());
+}
+
+// List the histograms of the file or, if there is a reference file, compare
+// them bin by bin with its histograms of the same path, within the tolerance
+// of the context.
+void
+histogramsDone(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  BasketScan &scan = *context.basketScan;
+  std::vector<KeyInfo> keys;
+  std::map<std::string, KeyInfo> histograms;
+  if (!readKeys(context.fd, keys))
+    fprintf(context.out, "Unable to read the keys of the file.\n");
+  findHistograms(keys, histograms);
+  std::vector<std::string> paths;
+  for (std::map<std::string, KeyInfo>::const_iterator h = histograms.begin(); h != histograms.end(); ++h)
+    paths.push_back(h->first);
+
+  if (scan.argument.empty())
+  {
+    std::vector<Histogram> decoded;
+    decodeHistograms(context.fd, "this file", histograms, paths, decoded, context.out);
+    for (size_t i = 0; i < paths.size(); ++i)
+      if (!decoded[i].className.empty())
+        fprintf(context.out, "Histogram %s: %s, %lu bins, %.17g entries\n", paths[i].c_str(), decoded[i].className.c_str(),
+                             decoded[i].contents.size(), decoded[i].entries);
+    scan.clear();
+    return;
+  }
+
+  char const *reference = scan.argument.c_str();
+  int referenceFd = open(reference, O_RDONLY);
+  std::vector<KeyInfo> referenceKeys;
+  if (referenceFd < 0 || !readKeys(referenceFd, referenceKeys))
+  {
+    fprintf(context.out, "Unable to read %s.\n", reference);
+    if (referenceFd >= 0)
+      close(referenceFd);
+    scan.clear();
+    return;
+  }
+  std::map<std::string, KeyInfo> referenceHistograms;
+  findHistograms(referenceKeys, referenceHistograms);
+
+  size_t differ = 0;
+  std::vector<std::string> common;
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    if (referenceHistograms.count(paths[i]))
+      common.push_back(paths[i]);
+    else
+    {
+      fprintf(context.out, "histogram %s only in this file\n", paths[i].c_str());
+      ++differ;
+    }
+  }
+  std::vector<Histogram> decoded;
+  std::vector<Histogram> referenceDecoded;
+  decodeHistograms(context.fd, "this file", histograms, common, decoded, context.out);
+  decodeHistograms(referenceFd, reference, referenceHistograms, common, referenceDecoded, context.out);
+  close(referenceFd);
+
+  std::vector<std::string> results(common.size());
+  parallelFor(common.size(), [&](size_t i, unsigned) {
+    if (decoded[i].className.empty() || referenceDecoded[i].className.empty())
+      results[i] = "not decoded";
+    else
+      results[i] = compareHistograms(decoded[i], referenceDecoded[i], context.tolerance);
+  });
+  for (size_t i = 0; i < common.size(); ++i)
+  {
+    if (results[i].empty())
+      continue;
+    fprintf(context.out, "histogram %s differs: %s\n", common[i].c_str(), results[i].c_str());
+    ++differ;
+  }
+  for (std::map<std::string, KeyInfo>::const_iterator h = referenceHistograms.begin(); h != referenceHistograms.end(); ++h)
+  {
+    if (histograms.count(h->first))
+      continue;
+    fprintf(context.out, "histogram %s only in %s\n", h->first.c_str(), reference);
+    ++differ;
+  }
+  fprintf(context.out, "%lu compared, %lu differ.\n", common.size(), differ);
+  scan.clear();
+}
+
+void
+parseUnknownNode(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  fprintf(context.out, "Unknown node.\n");
+  states.clear();
+}
+
+constexpr NodeProcessingSpec const *processingSpec(NodeProcessingSpec const*specs, NodeType type)
+{
+  return specs->type == UNKNOWN_NODE    ? specs
+       : specs->type == type            ? specs
+       :                                  processingSpec(specs + 1, type); 
+}
+
+void
+prepareToQuit(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
+{
+  context.quit = true;
+}
+
+}
+
+NodeProcessingSpec const processingSpecs[] = {
+  {IN_FILE_HEADER, parseFileHeader, "parseFileHeader"},
+  {IN_KEY_HEADER, parseKey, "parseKey"},
+  {IN_SUBDIR_HEADER, parseSubDir, "parseSubDir"},
+  {IN_TOP_DIR_HEADER, parseTopDir, "parseTopDir"},
+  {IN_STREAMER_INFO, parseStreamerInfo, "parseStreamerInfo"},
+  {IN_RANDOM_RANGE, parseRandomRange, "parseRandomRange"},
+  {IN_STREAM_FILE, streamFile, "streamFile"},
+  {IN_STREAM_KEY, streamKey, "streamKey"},
+  {IN_HASH_FILE, hashFile, "hashFile"},
+  {IN_STREAM_HASH, streamHash, "streamHash"},
+  {IN_HASH_KEY, hashKey, "hashKey"},
+  {IN_STREAM_STREAMER_INFO, streamStreamerInfo, "streamStreamerInfo"},
+  {IN_LIST_STREAMER_INFO, listStreamerInfo, "listStreamerInfo"},
+  {IN_STREAM_BASKET, streamBasket, "streamBasket"},
+  {IN_SCAN_BASKETS, scanBaskets, "scanBaskets"},
+  {IN_BRANCH_HASH_DONE, branchHashDone, "branchHashDone"},
+  {IN_STREAM_HASH_DONE, streamHashDone, "streamHashDone"},
+  {IN_ENTRY_HASH_DONE, entryHashDone, "entryHashDone"},
+  {IN_LIST_EVENTS_DONE, listEventsDone, "listEventsDone"},
+  {IN_FIND_EVENT_DONE, findEventDone, "findEventDone"},
+  {IN_EVENT_HASH_DONE, eventHashDone, "eventHashDone"},
+  {IN_EXPORT_DONE, exportDone, "exportDone"},
+  {IN_HISTOGRAMS_DONE, histogramsDone, "histogramsDone"},
+  {IN_SUMMARIZE_DONE, summarizeDone, "summarizeDone"},
+  {IN_MERKLE_DONE, merkleDone, "merkleDone"},
+  {IN_CHUNKS_DONE, chunksDone, "chunksDone"},
+  {IN_SAMPLE_DONE, sampleDone, "sampleDone"},
+  {IN_CORPUS_DONE, corpusDone, "corpusDone"},
+  {IN_QUERY_DONE, queryDone, "queryDone"},
+  {IN_DU_DONE, duDone, "duDone"},
+  {IN_RECOMPRESS_BENCH_DONE, recompressBenchDone, "recompressBenchDone"},
+  {IN_DIFF_OBJECT_DONE, diffObjectDone, "diffObjectDone"},
+  {IN_COMPARE_META_DONE, compareMetaDone, "compareMetaDone"},
+  {IN_CANONICALIZE_DONE, canonicalizeDone, "canonicalizeDone"},
+  {IN_EXTRACT_DONE, extractDone, "extractDone"},
+  {PREPARE_TO_QUIT, prepareToQuit, "prepareToQuit"},
+  {UNKNOWN_NODE, parseUnknownNode, "parseUnknownNode"},
+};
+
+char const *mapWindow(ParserContext &context, size_t pos)
+{
+  ReadWindow &window = context.window;
+  off_t nextSubwindow = pos & (~(windowMask>>1));
+  if (window.data && window.offset == nextSubwindow)
+    return window.data + pos - window.offset;
+
+  TraceSpan span("map", nextSubwindow);
+  if (window.data && munmap(window.data, window.size))
+    return 0;
+  window.offset = nextSubwindow;
+  window.data = (char*) mmap(0, window.size, PROT_READ, MAP_SHARED, context.fd, window.offset);
+  if (window.data == MAP_FAILED)
+  {
+    window.data = 0;
+    return 0;
+  }
+  statsAdd(STAT_WINDOWS_MAPPED, 1);
+  statsAdd(STAT_BYTES_MAPPED, window.size);
+  return window.data + pos - window.offset;
+}
+
+void unmapWindow(ReadWindow &window)
+{
+  if (window.data)
+    munmap(window.data, window.size);
+  window.data = 0;
+}
+
+bool runParser(std::vector<ParserState> &states, ParserContext &context)
+{
+  while (!states.empty() && !context.quit)
+  {
+    try
+    {
+      // Move to the next node. Obsolete API.
+      ParserState state = states.back();
+      states.pop_back();
+
+      char const*readBuffer = state.buffer ? state.buffer : mapWindow(context, state.pos);
+      if (!readBuffer)
+      {
+        fprintf(context.out, "%s", "File error.\n");
+        states.clear();
+        return false;
+      }
+      NodeProcessingSpec const *spec = processingSpec(processingSpecs, state.type);
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      TraceSpan span(spec->label, state.pos);
+      spec->func(readBuffer, state, states, context);
+      statsStage(state.type, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count());
+    }
+    catch(ParseError const&error)
+    {
+      fprintf(context.out, "%s:%s\n", error.error_, error.where_);
+    }
+    catch(char const *str)
+    {
+      fprintf(context.out, "%s\n", str);
+    }
+  }
+  return true;
+}
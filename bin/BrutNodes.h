@@ -0,0 +1,173 @@
+#ifndef __BRUT_NODES_H
+#define __BRUT_NODES_H
+#include "BrutHeaders.h"
+#include "BasketHelpers.h"
+#include "CatalogHelpers.h"
+#include "EventHelpers.h"
+#include "HistogramHelpers.h"
+#include <cstdio>
+#include <vector>
+#include <sys/types.h>
+
+/** The parser of brut: the nodes it visits, the functions processing them,
+    and runParser, which runs them until done. They are built in libbrut,
+    from BrutNodes.cc. All the state of a parser is in its ParserContext,
+    so that programs, like the shell in brut.cc, can have as many of them
+    as they like, on as many threads.
+  */
+enum NodeType
+{
+  UNKNOWN_NODE = 0,
+  IN_FILE_HEADER,
+  IN_KEY_HEADER,
+  IN_SUBDIR_HEADER,
+  IN_TOP_DIR_HEADER,
+  IN_STREAMER_INFO,
+  IN_RANDOM_RANGE,
+  IN_STREAM_FILE,
+  IN_HASH_FILE,
+  IN_STREAM_KEY,
+  IN_STREAM_HASH,
+  IN_HASH_KEY,
+  IN_STREAM_STREAMER_INFO,
+  IN_LIST_STREAMER_INFO,
+  IN_STREAM_BASKET,
+  IN_SCAN_BASKETS,
+  IN_BRANCH_HASH_DONE,
+  IN_STREAM_HASH_DONE,
+  IN_ENTRY_HASH_DONE,
+  IN_LIST_EVENTS_DONE,
+  IN_FIND_EVENT_DONE,
+  IN_EVENT_HASH_DONE,
+  IN_EXPORT_DONE,
+  IN_HISTOGRAMS_DONE,
+  IN_SUMMARIZE_DONE,
+  IN_MERKLE_DONE,
+  IN_CHUNKS_DONE,
+  IN_SAMPLE_DONE,
+  IN_CORPUS_DONE,
+  IN_QUERY_DONE,
+  IN_DU_DONE,
+  IN_RECOMPRESS_BENCH_DONE,
+  IN_DIFF_OBJECT_DONE,
+  IN_COMPARE_META_DONE,
+  IN_CANONICALIZE_DONE,
+  IN_EXTRACT_DONE,
+  PREPARE_TO_QUIT
+};
+
+struct NodeInfo {
+  const char    *label;
+  enum NodeType type;
+};
+
+constexpr NodeInfo nodeSpecs[] = {
+  {"key", IN_KEY_HEADER},
+  {"subdir", IN_SUBDIR_HEADER},
+  {"file", IN_FILE_HEADER},
+  {"topdir", IN_TOP_DIR_HEADER},
+  {"StreamerInfo", IN_STREAMER_INFO},
+  {0, UNKNOWN_NODE}
+};
+
+/** A structure holding the current parsing state.
+
+    - @a buffer pointer to the buffer to be parsed.
+    - @a type   type of the node to be parsed.
+    - @a pos    position of the node inside the buffer.
+    - @a size   dimension of the buffer.
+  */
+struct ParserState {
+  char const    *buffer; 
+  NodeType      type;    
+  size_t        pos;
+  size_t        size;
+};
+
+/** The part of the file mapped in memory, which nodes read their buffer
+    from. It is only moved when a node is outside of its first half.
+  */
+struct ReadWindow {
+  char          *data;
+  off_t         offset;
+  size_t        size;
+};
+
+/** A structure holding the environment of one parser. Nothing in it is
+    shared with other parsers, so that many of them can run at the same time,
+    on different threads, on different files or on the same one.
+  
+    - @a fSeekFree  Position of the free space inside the buffer.
+    - @a fd         The file being parsed, for those nodes which read 
+                    payloads on their own rather than via the read window.
+    - @a basketScan The baskets collected by IN_STREAM_BASKET nodes.
+    - @a tolerance  How much values can differ in comparisons.
+    - @a filename   The path of the file being parsed.
+    - @a catalog    The catalog of its keys, built by the first query.
+    - @a events     The index of its events, built by the first command
+                    looking events up.
+    - @a out        Where nodes print what they find.
+    - @a window     The read window on @a fd.
+    - @a quit       Set once the nodes of the last command are done.
+  */
+struct ParserContext {
+  size_t        fSeekFree;  
+  int           optMaxLinesInDump;
+  int           fd;
+  BasketScan    *basketScan;
+  Tolerance     tolerance;
+  char const    *filename;
+  KeyCatalog    *catalog;
+  EventIndex    *events;
+  FILE          *out;
+  ReadWindow    window;
+  bool          quit;
+};
+
+// The prototype for all the node visiting functions.
+typedef void (*NodeProcessing)(char const * /*buffer*/,
+                               ParserState const &/*current*/,
+                               std::vector<ParserState> &/*states*/,
+                               ParserContext &/*context*/);
+
+constexpr enum NodeType nodeId(const NodeInfo *specs, char const *label)
+{
+  return specs->label == 0            ? UNKNOWN_NODE
+       : !same(specs->label, label)   ? nodeId(specs+1, label)
+       :                                specs->type;
+}
+
+
+struct NodeProcessingSpec {
+  NodeType        type;
+  NodeProcessing  func;
+  char const      *label;
+};
+
+// The function processing each node type, ending with UNKNOWN_NODE.
+extern NodeProcessingSpec const processingSpecs[];
+
+// The idea is to use a sliding mmap window to read the
+// file rather than fread.
+constexpr off_t defaultWindowSize = 1<<24; // 16 MB of read window.
+constexpr off_t windowMask = defaultWindowSize-1; // Mask for the read window.
+
+/** The buffer at @a pos in the file of @a context. The read window is
+    always aligned to half its size, and moved so that @a pos is in its first
+    half, if it is not already, so that nodes can read up to half a window
+    from where they start.
+    @return 0 if the file could not be mapped.
+  */
+char const *mapWindow(ParserContext &context, size_t pos);
+
+void unmapWindow(ReadWindow &window);
+
+/** Process the nodes in @a states, last first, until none are left or one
+    of them asks to quit. Everything is read from and written to @a context,
+    so that parsers with different contexts can run concurrently. Errors
+    are reported to its output, and parsing goes on with the next node.
+    @return false if the file could not be read, leaving no node.
+  */
+bool runParser(std::vector<ParserState> &states, ParserContext &context);
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef __BYTE_SWAP_HELPERS_H
+#define __BYTE_SWAP_HELPERS_H
+#include "BrutHeaders.h"
+#include <stdint.h>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define __HAVE_X86_SIMD__ 1
+# include <immintrin.h>
+#elif defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
+/** Bulk conversion of big endian arrays (baskets payloads, TArray contents)
+    to native order.
+
+    The scalar accessors of BrutHeaders.h decode one value at the time. For
+    whole arrays we byte swap 16 to 64 bytes at the time with a byte shuffle,
+    using the widest instruction set the CPU supports. The choice is done
+    once, at the first use. Source and destination need not be aligned and
+    can be the same buffer, but must not otherwise overlap.
+  */
+enum SimdLevel {
+  SIMD_SCALAR = 0,
+  SIMD_SSSE3,
+  SIMD_AVX2,
+  SIMD_AVX512,
+  SIMD_NEON
+};
+
+constexpr char const *simdLevelNames[] = {"scalar", "ssse3", "avx2", "avx512", "neon"};
+
+// Swap @a count values from @a src to @a dst.
+typedef void (*ByteSwapKernel)(void *dst, void const *src, size_t count);
+
+struct ByteSwapKernels {
+  SimdLevel       level;
+  ByteSwapKernel  swap16;
+  ByteSwapKernel  swap32;
+  ByteSwapKernel  swap64;
+};
+
+template <size_t Size>
+void swapScalar(void *dst, void const *src, size_t count)
+{
+  unsigned char *d = (unsigned char *) dst;
+  unsigned char const *s = (unsigned char const *) src;
+  for (size_t i = 0; i < count; ++i, d += Size, s += Size)
+  {
+    if (Size == 2)
+    {
+      unsigned short v;
+      memcpy(&v, s, 2);
+      v = bswap_16(v);
+      memcpy(d, &v, 2);
+    }
+    else if (Size == 4)
+    {
+      unsigned int v;
+      memcpy(&v, s, 4);
+      v = bswap_32(v);
+      memcpy(d, &v, 4);
+    }
+    else
+    {
+      unsigned long long v;
+      memcpy(&v, s, 8);
+      v = bswap_64(v);
+      memcpy(d, &v, 8);
+    }
+  }
+}
+
+#if __HAVE_X86_SIMD__
+// The byte shuffle reversing each value of @a Size bytes. x86 shuffles work
+// on 16 bytes lanes, so the same pattern is repeated in each lane.
+template <size_t Size>
+void swapMask(unsigned char *mask, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+    mask[i] = (i & 15) / Size * Size + Size - 1 - i % Size;
+}
+
+template <size_t Size>
+__attribute__((target("ssse3")))
+void swapSSSE3(void *dst, void const *src, size_t count)
+{
+  unsigned char *d = (unsigned char *) dst;
+  unsigned char const *s = (unsigned char const *) src;
+  unsigned char maskBytes[16];
+  swapMask<Size>(maskBytes, sizeof(maskBytes));
+  __m128i const mask = _mm_loadu_si128((__m128i const *) maskBytes);
+  size_t bytes = count * Size;
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((__m128i const *)(s + i));
+    _mm_storeu_si128((__m128i *)(d + i), _mm_shuffle_epi8(v, mask));
+  }
+  swapScalar<Size>(d + i, s + i, (bytes - i) / Size);
+}
+
+template <size_t Size>
+__attribute__((target("avx2")))
+void swapAVX2(void *dst, void const *src, size_t count)
+{
+  unsigned char *d = (unsigned char *) dst;
+  unsigned char const *s = (unsigned char const *) src;
+  unsigned char maskBytes[32];
+  swapMask<Size>(maskBytes, sizeof(maskBytes));
+  __m256i const mask = _mm256_loadu_si256((__m256i const *) maskBytes);
+  size_t bytes = count * Size;
+  size_t i = 0;
+  for (; i + 64 <= bytes; i += 64)
+  {
+    __m256i v0 = _mm256_loadu_si256((__m256i const *)(s + i));
+    __m256i v1 = _mm256_loadu_si256((__m256i const *)(s + i + 32));
+    _mm256_storeu_si256((__m256i *)(d + i), _mm256_shuffle_epi8(v0, mask));
+    _mm256_storeu_si256((__m256i *)(d + i + 32), _mm256_shuffle_epi8(v1, mask));
+  }
+  for (; i + 32 <= bytes; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256((__m256i const *)(s + i));
+    _mm256_storeu_si256((__m256i *)(d + i), _mm256_shuffle_epi8(v, mask));
+  }
+  swapScalar<Size>(d + i, s + i, (bytes - i) / Size);
+}
+
+template <size_t Size>
+__attribute__((target("avx512f,avx512bw")))
+void swapAVX512(void *dst, void const *src, size_t count)
+{
+  unsigned char *d = (unsigned char *) dst;
+  unsigned char const *s = (unsigned char const *) src;
+  unsigned char maskBytes[64];
+  swapMask<Size>(maskBytes, sizeof(maskBytes));
+  __m512i const mask = _mm512_loadu_si512(maskBytes);
+  size_t bytes = count * Size;
+  size_t i = 0;
+  for (; i + 64 <= bytes; i += 64)
+  {
+    __m512i v = _mm512_loadu_si512(s + i);
+    _mm512_storeu_si512(d + i, _mm512_shuffle_epi8(v, mask));
+  }
+  // The tail is done with masked loads and stores, rather than one value
+  // at the time.
+  if (i < bytes)
+  {
+    __mmask64 tail = ~0ULL >> (64 - (bytes - i));
+    __m512i v = _mm512_maskz_loadu_epi8(tail, s + i);
+    _mm512_mask_storeu_epi8(d + i, tail, _mm512_shuffle_epi8(v, mask));
+  }
+}
+#endif // __HAVE_X86_SIMD__
+
+#if defined(__ARM_NEON)
+template <size_t Size>
+void swapNEON(void *dst, void const *src, size_t count)
+{
+  unsigned char *d = (unsigned char *) dst;
+  unsigned char const *s = (unsigned char const *) src;
+  size_t bytes = count * Size;
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16)
+  {
+    uint8x16_t v = vld1q_u8(s + i);
+    vst1q_u8(d + i, Size == 2 ? vrev16q_u8(v) : Size == 4 ? vrev32q_u8(v) : vrev64q_u8(v));
+  }
+  swapScalar<Size>(d + i, s + i, (bytes - i) / Size);
+}
+#endif
+
+/** @return the best SimdLevel supported by the CPU we are running on. */
+inline SimdLevel bestSimdLevel()
+{
+#if __HAVE_X86_SIMD__
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return SIMD_AVX2;
+  if (__builtin_cpu_supports("ssse3"))
+    return SIMD_SSSE3;
+#elif defined(__ARM_NEON)
+  return SIMD_NEON;
+#endif
+  return SIMD_SCALAR;
+}
+
+/** The kernels for @a level, which the caller must make sure is supported.
+    Levels not available for the architecture we are built for fall back to
+    the scalar ones.
+  */
+inline ByteSwapKernels byteSwapKernels(SimdLevel level)
+{
+  switch (level)
+  {
+#if __HAVE_X86_SIMD__
+    case SIMD_SSSE3:
+      return {level, swapSSSE3<2>, swapSSSE3<4>, swapSSSE3<8>};
+    case SIMD_AVX2:
+      return {level, swapAVX2<2>, swapAVX2<4>, swapAVX2<8>};
+    case SIMD_AVX512:
+      return {level, swapAVX512<2>, swapAVX512<4>, swapAVX512<8>};
+#elif defined(__ARM_NEON)
+    case SIMD_NEON:
+      return {level, swapNEON<2>, swapNEON<4>, swapNEON<8>};
+#endif
+    default:
+      return {SIMD_SCALAR, swapScalar<2>, swapScalar<4>, swapScalar<8>};
+  }
+}
+
+inline ByteSwapKernels const &activeByteSwapKernels()
+{
+  static ByteSwapKernels const kernels = byteSwapKernels(bestSimdLevel());
+  return kernels;
+}
+
+/** Convert @a count big endian values of @a size bytes each from @a src to
+    native order in @a dst.
+  */
+inline void byteSwapArray(void *dst, void const *src, size_t count, size_t size)
+{
+  ByteSwapKernels const &kernels = activeByteSwapKernels();
+  switch (size)
+  {
+    case 1:
+      if (dst != src)
+        memcpy(dst, src, count);
+      break;
+    case 2:
+      kernels.swap16(dst, src, count);
+      break;
+    case 4:
+      kernels.swap32(dst, src, count);
+      break;
+    case 8:
+      kernels.swap64(dst, src, count);
+      break;
+    default:
+      throw "Wrong size";
+  }
+}
+
+// The typed version of the above, for all the types of the TArrays.
+template <class T>
+void decodeBigEndian(char const *src, size_t count, T *dst)
+{
+  byteSwapArray(dst, src, count, sizeof(T));
+}
+
+/** The number of values of the length prefixed array @a label (e.g.
+    ArrayISpec), whose "size" field is the number of values. Use an empty
+    @a label if @a spec is the array spec itself.
+  */
+inline size_t getArraySize(const FieldSpec *spec, char const *buf, char const *label)
+{
+  std::string field(*label ? std::string(label) + "." : std::string());
+  return (unsigned) getInt(spec, buf, (field + "size").c_str());
+}
+
+/** Decode in @a output, in native order, the values of the length prefixed
+    array @a label (see getArraySize). @a output must have room for
+    @a maxCount values.
+
+    @return the number of values.
+  */
+template <class T>
+size_t getArray(const FieldSpec *spec, char const *buf, char const *label, T *output, size_t maxCount)
+{
+  size_t count = getArraySize(spec, buf, label);
+  if (count > maxCount)
+    throw "Array too big";
+  std::string field(*label ? std::string(label) + ".data" : std::string("data"));
+  decodeBigEndian(getString(spec, buf, field.c_str()), count, output);
+  return count;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef CMSSW_SCHEMA_H
 #define CMSSW_SCHEMA_H
 #include "BrutHeaders.h"
+#include "ROOTSchema.h"
 
 constexpr FieldSpec FileFormatVersionSpec[] {
   {fixed_size(4), "value", true, METADATA, SCALAR},
@@ -10,4 +11,35 @@ constexpr FieldSpec FileFormatVersionSpec[] {
   LAST_FIELD
 };
 
+// edm::Hash<>, e.g. the ProcessHistoryID.
+constexpr FieldSpec HashSpec[] {
+  {embedded(TVersionSpec), "Version", true, METADATA, STRUCT},
+  {embedded(TStringSpec), "hash", true, METADATA, STRUCT},
+  LAST_FIELD
+};
+
+// The part of edm::EventAuxiliary which precedes its EventID.
+constexpr FieldSpec EventAuxiliarySpec[] {
+  {embedded(TVersionSpec), "Version", true, METADATA, STRUCT},
+  {embedded(HashSpec), "processHistoryID", true, METADATA, STRUCT},
+  LAST_FIELD
+};
+
+// edm::EventID, from version 11 on event numbers are 64 bits.
+constexpr FieldSpec EventIDSpec[] {
+  {embedded(TVersionSpec), "Version", true, METADATA, STRUCT},
+  {fixed_size(4), "run", true, KEY, SCALAR},
+  {fixed_size(4), "luminosityBlock", true, KEY, SCALAR},
+  {fixed_size(8), "event", true, KEY, SCALAR},
+  LAST_FIELD
+};
+
+constexpr FieldSpec EventIDSpecV10[] {
+  {embedded(TVersionSpec), "Version", true, METADATA, STRUCT},
+  {fixed_size(4), "run", true, KEY, SCALAR},
+  {fixed_size(4), "luminosityBlock", true, KEY, SCALAR},
+  {fixed_size(4), "event", true, KEY, SCALAR},
+  LAST_FIELD
+};
+
 #endif
\ No newline at end of file
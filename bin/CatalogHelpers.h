@@ -0,0 +1,415 @@
+#ifndef __CATALOG_HELPERS_H
+#define __CATALOG_HELPERS_H
+#include "BasketHelpers.h"
+#include "ByteSwapHelpers.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+/** A catalog of all the keys of a file, to answer questions like "the 20
+    largest baskets" or "the compression ratio of each class" without
+    reading the file again.
+
+    The catalog is stored by column, one array of 64 bits values per field
+    of the keys, with strings (class, name, compression algorithm) replaced
+    by their index in a table of interned strings. Conditions are evaluated
+    one column at the time, 4 or 8 values per instruction, into a bitmap of
+    the selected keys, which the aggregates and the sorting then walk.
+  */
+enum CatalogColumn {
+  CATALOG_OFFSET = 0,
+  CATALOG_NBYTES,
+  CATALOG_OBJLEN,
+  CATALOG_KEYLEN,
+  CATALOG_CYCLE,
+  CATALOG_CLASS,
+  CATALOG_NAME,
+  CATALOG_ALGORITHM,
+  CATALOG_COLUMNS
+};
+
+struct CatalogColumnSpec {
+  char const    *label;
+  CatalogColumn id;
+  bool          interned;
+};
+
+constexpr CatalogColumnSpec catalogColumnSpecs[] = {
+  {"offset", CATALOG_OFFSET, false},
+  {"nbytes", CATALOG_NBYTES, false},
+  {"objlen", CATALOG_OBJLEN, false},
+  {"keylen", CATALOG_KEYLEN, false},
+  {"cycle", CATALOG_CYCLE, false},
+  {"class", CATALOG_CLASS, true},
+  {"name", CATALOG_NAME, true},
+  {"algorithm", CATALOG_ALGORITHM, true},
+  {0, CATALOG_COLUMNS, false}
+};
+
+constexpr CatalogColumn catalogColumn(CatalogColumnSpec const *specs, char const *label)
+{
+  return specs->label == 0            ? CATALOG_COLUMNS
+       : !same(specs->label, label)   ? catalogColumn(specs + 1, label)
+       :                                specs->id;
+}
+
+struct KeyCatalog {
+  std::vector<uint64_t>           columns[CATALOG_COLUMNS];
+  std::vector<std::string>        strings;
+  std::map<std::string, uint64_t> ids;
+
+  size_t size() const { return columns[CATALOG_OFFSET].size(); }
+
+  uint64_t intern(std::string const &value)
+  {
+    std::map<std::string, uint64_t>::const_iterator i = ids.find(value);
+    if (i != ids.end())
+      return i->second;
+    strings.push_back(value);
+    return ids[value] = strings.size() - 1;
+  }
+
+  void add(KeyInfo const &key)
+  {
+    columns[CATALOG_OFFSET].push_back(key.seekKey);
+    columns[CATALOG_NBYTES].push_back(key.nbytes);
+    columns[CATALOG_OBJLEN].push_back(key.objLen);
+    columns[CATALOG_KEYLEN].push_back(key.keyLen);
+    columns[CATALOG_CYCLE].push_back(key.cycle);
+    columns[CATALOG_CLASS].push_back(intern(key.className));
+    columns[CATALOG_NAME].push_back(intern(key.name));
+    columns[CATALOG_ALGORITHM].push_back(intern(key.compression[0] ? std::string(key.compression, 2) : "none"));
+  }
+
+  void clear()
+  {
+    for (size_t c = 0; c < CATALOG_COLUMNS; ++c)
+      columns[c].clear();
+    strings.clear();
+    ids.clear();
+  }
+
+  // The value of @a column for key @a i, as text.
+  std::string format(CatalogColumn column, size_t i) const
+  {
+    uint64_t value = columns[column][i];
+    if (catalogColumnSpecs[column].interned)
+      return strings[value];
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%lld", column == CATALOG_CYCLE ? (long long) (short) value : (long long) value);
+    return buffer;
+  }
+};
+
+enum CompareOp { OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE };
+
+inline bool compareValue(uint64_t x, CompareOp op, uint64_t value)
+{
+  switch (op)
+  {
+    case OP_EQ: return x == value;
+    case OP_NE: return x != value;
+    case OP_LT: return x < value;
+    case OP_LE: return x <= value;
+    case OP_GT: return x > value;
+    case OP_GE: return x >= value;
+  }
+  return false;
+}
+
+/** Clear in the bitmap @a selected, one bit per value, the bits of the
+    first @a n @a values for which "value op @a value" is false.
+  */
+typedef void (*FilterKernel)(uint64_t const *values, size_t n, CompareOp op, uint64_t value, uint64_t *selected);
+
+inline void filterScalar(uint64_t const *values, size_t n, CompareOp op, uint64_t value, uint64_t *selected)
+{
+  for (size_t w = 0; w * 64 < n; ++w)
+  {
+    uint64_t bits = 0;
+    for (size_t i = w * 64; i < std::min(n, w * 64 + 64); ++i)
+      bits |= (uint64_t) compareValue(values[i], op, value) << (i - w * 64);
+    selected[w] &= bits;
+  }
+}
+
+#if __HAVE_X86_SIMD__
+// AVX2 only has signed comparisons of 64 bits values: flipping the sign bit
+// of both sides makes them unsigned ones.
+__attribute__((target("avx2")))
+inline void filterAVX2(uint64_t const *values, size_t n, CompareOp op, uint64_t value, uint64_t *selected)
+{
+  __m256i const sign = _mm256_set1_epi64x(0x8000000000000000ULL);
+  __m256i const v = _mm256_xor_si256(_mm256_set1_epi64x(value), sign);
+  size_t full = n & ~(size_t) 63;
+  for (size_t w = 0; w * 64 < full; ++w)
+  {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 64; i += 4)
+    {
+      __m256i x = _mm256_xor_si256(_mm256_loadu_si256((__m256i const *) (values + w * 64 + i)), sign);
+      __m256i result;
+      switch (op)
+      {
+        case OP_EQ: case OP_NE: result = _mm256_cmpeq_epi64(x, v); break;
+        case OP_GT: case OP_LE: result = _mm256_cmpgt_epi64(x, v); break;
+        default:                result = _mm256_cmpgt_epi64(v, x); break;
+      }
+      uint64_t mask = _mm256_movemask_pd(_mm256_castsi256_pd(result));
+      if (op == OP_NE || op == OP_LE || op == OP_GE)
+        mask ^= 0xf;
+      bits |= mask << i;
+    }
+    selected[w] &= bits;
+  }
+  if (full < n)
+    filterScalar(values + full, n - full, op, value, selected + full / 64);
+}
+
+template <int Predicate>
+__attribute__((target("avx512f")))
+void filterAVX512Predicate(uint64_t const *values, size_t n, uint64_t value, uint64_t *selected)
+{
+  __m512i const v = _mm512_set1_epi64(value);
+  for (size_t w = 0; w * 64 < n; ++w)
+  {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 64 && w * 64 + i < n; i += 8)
+    {
+      size_t left = n - w * 64 - i;
+      __mmask8 valid = left >= 8 ? 0xff : (1 << left) - 1;
+      __m512i x = _mm512_maskz_loadu_epi64(valid, values + w * 64 + i);
+      bits |= (uint64_t) _mm512_mask_cmp_epu64_mask(valid, x, v, Predicate) << i;
+    }
+    selected[w] &= bits;
+  }
+}
+
+__attribute__((target("avx512f")))
+inline void filterAVX512(uint64_t const *values, size_t n, CompareOp op, uint64_t value, uint64_t *selected)
+{
+  switch (op)
+  {
+    case OP_EQ: return filterAVX512Predicate<_MM_CMPINT_EQ>(values, n, value, selected);
+    case OP_NE: return filterAVX512Predicate<_MM_CMPINT_NE>(values, n, value, selected);
+    case OP_LT: return filterAVX512Predicate<_MM_CMPINT_LT>(values, n, value, selected);
+    case OP_LE: return filterAVX512Predicate<_MM_CMPINT_LE>(values, n, value, selected);
+    case OP_GT: return filterAVX512Predicate<_MM_CMPINT_NLE>(values, n, value, selected);
+    case OP_GE: return filterAVX512Predicate<_MM_CMPINT_NLT>(values, n, value, selected);
+  }
+}
+#endif
+
+inline FilterKernel filterKernel(SimdLevel level)
+{
+#if __HAVE_X86_SIMD__
+  if (level == SIMD_AVX512)
+    return filterAVX512;
+  if (level == SIMD_AVX2)
+    return filterAVX2;
+#endif
+  return filterScalar;
+}
+
+struct CatalogCondition {
+  CatalogColumn column;
+  CompareOp     op;
+  uint64_t      value;
+};
+
+/** A query on a catalog:
+
+        select <*|class|name|algorithm> [where <condition> [and <condition> ...]]
+               [order by <column> [desc]] [limit <n>]
+
+    where a condition is <column><op><value>, with op one of =, !=, <, <=,
+    >, >=, and numeric values can have a k, M or G suffix. "select *" lists
+    the keys, the others their number, size and uncompressed size per value
+    of the column, which can also be ordered by keys, nbytes, objlen or
+    ratio.
+  */
+struct CatalogQuery {
+  CatalogColumn                 group;
+  std::vector<CatalogCondition> where;
+  std::string                   order;
+  bool                          descending;
+  size_t                        limit;
+};
+
+inline bool parseCondition(KeyCatalog &catalog, std::string const &text, CatalogCondition &condition)
+{
+  size_t opBegin = text.find_first_of("=!<>");
+  if (opBegin == std::string::npos || opBegin == 0)
+    return false;
+  size_t opEnd = text.find_first_not_of("=!<>", opBegin);
+  if (opEnd == std::string::npos)
+    return false;
+  condition.column = catalogColumn(catalogColumnSpecs, text.substr(0, opBegin).c_str());
+  std::string op = text.substr(opBegin, opEnd - opBegin);
+  std::string value = text.substr(opEnd);
+  if (condition.column == CATALOG_COLUMNS)
+    return false;
+  static char const *ops[] = {"=", "!=", "<", "<=", ">", ">="};
+  size_t o = 0;
+  while (o < 6 && op != ops[o])
+    ++o;
+  if (o == 6)
+    return false;
+  condition.op = (CompareOp) o;
+  if (catalogColumnSpecs[condition.column].interned)
+  {
+    if (condition.op != OP_EQ && condition.op != OP_NE)
+      return false;
+    // Values which are not in the catalog match nothing.
+    std::map<std::string, uint64_t>::const_iterator id = catalog.ids.find(value);
+    condition.value = id == catalog.ids.end() ? ~0ULL : id->second;
+    return true;
+  }
+  char *end;
+  condition.value = strtoull(value.c_str(), &end, 10);
+  if (end == value.c_str())
+    return false;
+  char const *suffixes = "kMG";
+  if (*end && strchr(suffixes, *end))
+  {
+    condition.value <<= 10 * (strchr(suffixes, *end) - suffixes + 1);
+    ++end;
+  }
+  return *end == 0;
+}
+
+/** Parse the @a tokens of a query, from the one after "select".
+    @return false, after printing why, if they are not a valid query.
+  */
+inline bool parseQuery(KeyCatalog &catalog, std::vector<std::string> const &tokens, CatalogQuery &query,
+                FILE *out = stdout)
+{
+  query.group = CATALOG_COLUMNS;
+  query.where.clear();
+  query.order.clear();
+  query.descending = false;
+  query.limit = ~(size_t) 0;
+  if (tokens.empty())
+  {
+    fprintf(out, "Please specify what to select: *, class, name or algorithm.\n");
+    return false;
+  }
+  if (tokens[0] != "*")
+  {
+    query.group = catalogColumn(catalogColumnSpecs, tokens[0].c_str());
+    if (query.group == CATALOG_COLUMNS || !catalogColumnSpecs[query.group].interned)
+    {
+      fprintf(out, "Wrong selection %s, expecting *, class, name or algorithm.\n", tokens[0].c_str());
+      return false;
+    }
+  }
+  size_t t = 1;
+  if (t < tokens.size() && tokens[t] == "where")
+  {
+    do
+    {
+      CatalogCondition condition;
+      if (++t == tokens.size() || !parseCondition(catalog, tokens[t], condition))
+      {
+        fprintf(out, "Wrong condition %s.\n", t < tokens.size() ? tokens[t].c_str() : "");
+        return false;
+      }
+      query.where.push_back(condition);
+    } while (++t < tokens.size() && tokens[t] == "and");
+  }
+  if (t + 2 < tokens.size() && tokens[t] == "order" && tokens[t + 1] == "by")
+  {
+    query.order = tokens[t + 2];
+    bool aggregate = query.order == "keys" || query.order == "nbytes" || query.order == "objlen" || query.order == "ratio";
+    CatalogColumn column = catalogColumn(catalogColumnSpecs, query.order.c_str());
+    if (query.group == CATALOG_COLUMNS ? column == CATALOG_COLUMNS : !aggregate && column != query.group)
+    {
+      fprintf(out, "Cannot order by %s.\n", query.order.c_str());
+      return false;
+    }
+    t += 3;
+    if (t < tokens.size() && tokens[t] == "desc")
+    {
+      query.descending = true;
+      ++t;
+    }
+  }
+  if (t + 1 < tokens.size() && tokens[t] == "limit")
+  {
+    char *end;
+    query.limit = strtoul(tokens[t + 1].c_str(), &end, 10);
+    if (*end || end == tokens[t + 1].c_str())
+    {
+      fprintf(out, "Wrong limit %s.\n", tokens[t + 1].c_str());
+      return false;
+    }
+    t += 2;
+  }
+  if (t < tokens.size())
+  {
+    fprintf(out, "Unexpected %s.\n", tokens[t].c_str());
+    return false;
+  }
+  return true;
+}
+
+/** Fill @a selected with the bitmap of the keys of @a catalog satisfying
+    all the @a conditions.
+  */
+inline void selectKeys(KeyCatalog const &catalog, std::vector<CatalogCondition> const &conditions,
+                std::vector<uint64_t> &selected, FilterKernel kernel = filterKernel(bestSimdLevel()))
+{
+  size_t n = catalog.size();
+  selected.assign((n + 63) / 64, ~0ULL);
+  if (n % 64)
+    selected.back() = ~0ULL >> (64 - n % 64);
+  for (size_t c = 0; c < conditions.size() && n; ++c)
+    kernel(&catalog.columns[conditions[c].column][0], n, conditions[c].op, conditions[c].value, &selected[0]);
+}
+
+// Append to @a keys the indices of the keys selected in @a selected.
+inline void selectedKeys(std::vector<uint64_t> const &selected, std::vector<size_t> &keys)
+{
+  for (size_t w = 0; w < selected.size(); ++w)
+    for (uint64_t bits = selected[w]; bits; bits &= bits - 1)
+      keys.push_back(w * 64 + __builtin_ctzll(bits));
+}
+
+/** The keys with a given value of a column. */
+struct CatalogGroup {
+  uint64_t value;
+  uint64_t keys;
+  uint64_t nbytes;
+  uint64_t objLen;
+};
+
+inline void groupKeys(KeyCatalog const &catalog, std::vector<uint64_t> const &selected, CatalogColumn column,
+               std::vector<CatalogGroup> &groups)
+{
+  std::vector<CatalogGroup> all(catalog.strings.size());
+  for (size_t i = 0; i < all.size(); ++i)
+  {
+    CatalogGroup empty = {i, 0, 0, 0};
+    all[i] = empty;
+  }
+  uint64_t const *values = catalog.size() ? &catalog.columns[column][0] : 0;
+  for (size_t w = 0; w < selected.size(); ++w)
+    for (uint64_t bits = selected[w]; bits; bits &= bits - 1)
+    {
+      size_t i = w * 64 + __builtin_ctzll(bits);
+      CatalogGroup &group = all[values[i]];
+      group.keys += 1;
+      group.nbytes += catalog.columns[CATALOG_NBYTES][i];
+      group.objLen += catalog.columns[CATALOG_OBJLEN][i];
+    }
+  for (size_t i = 0; i < all.size(); ++i)
+    if (all[i].keys)
+      groups.push_back(all[i]);
+}
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef __CHUNK_HELPERS_H
+#define __CHUNK_HELPERS_H
+#include "ByteSwapHelpers.h"
+#include "HashHelpers.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+/** Content defined chunking of objects, so that two large objects which
+    differ can be compared chunk by chunk, and the differences located even
+    when bytes were inserted or removed.
+
+    Chunk boundaries are found with a gear hash: h = (h << 1) + gear[byte].
+    Since each byte is shifted out after 64 steps, the hash at a given
+    position only depends on the 64 bytes before it, and the boundary
+    candidates, i.e. the positions where the hash has no bit of
+    chunkMask set, can be computed independently in separate parts of the
+    buffer. The SIMD version does this on 4 lanes at the time. Chunks are
+    then cut at the first candidate after chunkMinSize bytes, or at
+    chunkMaxSize bytes.
+  */
+constexpr size_t chunkMinSize = 16 * 1024;
+constexpr size_t chunkMaxSize = 256 * 1024;
+// 16 bits, for an average distance of 64kB between candidates.
+constexpr uint64_t chunkMask = 0xffffULL << 48;
+constexpr size_t gearWindow = 64;
+constexpr char chunkPrefix[] = "Chunk ";
+
+// The random values each byte is mapped to, from splitmix64.
+struct GearTable {
+  uint64_t values[256];
+
+  GearTable()
+  {
+    uint64_t state = 0x62727574ULL;
+    for (size_t i = 0; i < 256; ++i)
+    {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      values[i] = z ^ (z >> 31);
+    }
+  }
+};
+
+inline uint64_t const *gearTable()
+{
+  static GearTable const table;
+  return table.values;
+}
+
+/** Append to @a candidates the boundary candidates of @a data in
+    [@a begin, @a end): the positions p (a boundary before byte p) where
+    the hash of the bytes before p has no bit of @a mask set. Hashing starts
+    gearWindow bytes before @a begin, when possible, so that the result does
+    not depend on how the buffer is split.
+  */
+inline void gearCandidatesScalar(unsigned char const *data, size_t begin, size_t end, uint64_t mask,
+                          std::vector<size_t> &candidates)
+{
+  uint64_t const *gear = gearTable();
+  uint64_t h = 0;
+  for (size_t i = begin > gearWindow ? begin - gearWindow : 0; i < begin; ++i)
+    h = (h << 1) + gear[data[i]];
+  for (size_t i = begin; i < end; ++i)
+  {
+    h = (h << 1) + gear[data[i]];
+    if (!(h & mask))
+      candidates.push_back(i + 1);
+  }
+}
+
+#if __HAVE_X86_SIMD__
+// The same, with the buffer split in 4 parts, one per 64 bits lane.
+__attribute__((target("avx2")))
+inline void gearCandidatesAVX2(unsigned char const *data, size_t begin, size_t end, uint64_t mask,
+                        std::vector<size_t> &candidates)
+{
+  size_t lane = (end - begin) / 4;
+  if (lane < 4 * gearWindow)
+    return gearCandidatesScalar(data, begin, end, mask, candidates);
+  uint64_t const *gear = gearTable();
+  size_t starts[4] = {begin, begin + lane, begin + 2 * lane, begin + 3 * lane};
+  std::vector<size_t> found[4];
+  // Warm up the lanes on the bytes before their part.
+  uint64_t warm[4] = {0, 0, 0, 0};
+  for (size_t l = 0; l < 4; ++l)
+    for (size_t i = starts[l] > gearWindow ? starts[l] - gearWindow : 0; i < starts[l]; ++i)
+      warm[l] = (warm[l] << 1) + gear[data[i]];
+  __m256i h = _mm256_loadu_si256((__m256i const *) warm);
+  __m256i const m = _mm256_set1_epi64x(mask);
+  __m256i const zero = _mm256_setzero_si256();
+  for (size_t i = 0; i < lane; ++i)
+  {
+    __m256i g = _mm256_set_epi64x(gear[data[starts[3] + i]], gear[data[starts[2] + i]],
+                                  gear[data[starts[1] + i]], gear[data[starts[0] + i]]);
+    h = _mm256_add_epi64(_mm256_slli_epi64(h, 1), g);
+    int hits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(h, m), zero)));
+    for (; hits; hits &= hits - 1)
+    {
+      int l = __builtin_ctz(hits);
+      found[l].push_back(starts[l] + i + 1);
+    }
+  }
+  for (size_t l = 0; l < 4; ++l)
+    candidates.insert(candidates.end(), found[l].begin(), found[l].end());
+  gearCandidatesScalar(data, begin + 4 * lane, end, mask, candidates);
+}
+#endif
+
+typedef void (*GearKernel)(unsigned char const *, size_t, size_t, uint64_t, std::vector<size_t> &);
+
+inline GearKernel gearKernel(SimdLevel level)
+{
+#if __HAVE_X86_SIMD__
+  if (level == SIMD_AVX2 || level == SIMD_AVX512)
+    return gearCandidatesAVX2;
+#endif
+  return gearCandidatesScalar;
+}
+
+/** A chunk of an object, @a size bytes at @a offset, with the SHA1 of its
+    contents, in hex.
+  */
+struct Chunk {
+  size_t      offset;
+  size_t      size;
+  std::string digest;
+};
+
+/** Cut @a size bytes at @a data into chunks, whose ends are appended to
+    @a ends, using the boundary candidates found by @a kernel.
+  */
+inline void chunkBoundaries(char const *data, size_t size, std::vector<size_t> &ends,
+                     GearKernel kernel = gearKernel(bestSimdLevel()))
+{
+  std::vector<size_t> candidates;
+  kernel((unsigned char const *) data, 0, size, chunkMask, candidates);
+  size_t start = 0;
+  std::vector<size_t>::const_iterator c = candidates.begin();
+  while (start < size)
+  {
+    while (c != candidates.end() && *c < start + chunkMinSize)
+      ++c;
+    size_t end = std::min(size, start + chunkMaxSize);
+    if (c != candidates.end() && *c < end)
+      end = *c;
+    ends.push_back(end);
+    start = end;
+  }
+}
+
+/** Cut an object in chunks, with the same boundaries as chunkBoundaries,
+    out of its bytes given in order to update() in pieces of any size, so
+    that the object never has to be in memory as a whole. The chunks, with
+    their digests, are appended to @a chunks as soon as they end, the last
+    one by finish().
+  */
+struct ChunkStream {
+  ChunkStream(std::vector<Chunk> &aChunks, GearKernel aKernel = gearKernel(bestSimdLevel()))
+    : chunks(aChunks), kernel(aKernel), historySize(0), start(0), total(0), hasher(new SHA1Hasher)
+  {}
+
+  ~ChunkStream()
+  {
+    delete hasher;
+  }
+
+  void update(char const *data, size_t size)
+  {
+    unsigned char const *bytes = (unsigned char const *) data;
+    // The first bytes of the piece are hashed after the last ones of the
+    // previous piece, the others within the piece itself.
+    size_t seam = std::min(size, gearWindow);
+    unsigned char joined[2 * gearWindow];
+    memcpy(joined, history, historySize);
+    memcpy(joined + historySize, bytes, seam);
+    candidates.clear();
+    kernel(joined, historySize, historySize + seam, chunkMask, candidates);
+    for (size_t i = 0; i < candidates.size(); ++i)
+      candidates[i] += total - historySize;
+    size_t joinedCandidates = candidates.size();
+    kernel(bytes, seam, size, chunkMask, candidates);
+    for (size_t i = joinedCandidates; i < candidates.size(); ++i)
+      candidates[i] += total;
+
+    size_t end = total + size;
+    size_t hashed = total;
+    std::vector<size_t>::const_iterator c = candidates.begin();
+    for (;;)
+    {
+      while (c != candidates.end() && *c < start + chunkMinSize)
+        ++c;
+      size_t cut = start + chunkMaxSize;
+      if (c != candidates.end() && *c < cut)
+        cut = *c;
+      if (cut > end)
+        break;
+      hasher->update(data + hashed - total, cut - hashed);
+      hashed = cut;
+      emit(cut);
+    }
+    hasher->update(data + hashed - total, end - hashed);
+    total = end;
+
+    size_t kept = std::min(historySize, gearWindow - seam);
+    memmove(history, history + historySize - kept, kept);
+    memcpy(history + kept, bytes + size - seam, seam);
+    historySize = kept + seam;
+  }
+
+  void finish()
+  {
+    if (total > start)
+      emit(total);
+  }
+
+  std::vector<Chunk>    &chunks;
+  GearKernel            kernel;
+  unsigned char         history[gearWindow];
+  size_t                historySize;
+  size_t                start;
+  size_t                total;
+  SHA1Hasher            *hasher;
+  std::vector<size_t>   candidates;
+
+private:
+  ChunkStream(ChunkStream const &);
+  ChunkStream &operator=(ChunkStream const &);
+
+  // End the current chunk at @a end.
+  void emit(size_t end)
+  {
+    unsigned char digest[SHA1_SIZE];
+    hasher->digest(digest);
+    delete hasher;
+    hasher = new SHA1Hasher;
+    Chunk chunk = {start, end - start, digestToHex(digest)};
+    chunks.push_back(chunk);
+    start = end;
+  }
+};
+
+// Cut @a data in chunks and compute their digests.
+inline void chunkObject(char const *data, size_t size, std::vector<Chunk> &chunks)
+{
+  ChunkStream stream(chunks);
+  stream.update(data, size);
+  stream.finish();
+}
+
+inline void printChunks(std::string const &object, std::vector<Chunk> const &chunks, FILE *out = stdout)
+{
+  for (size_t i = 0; i < chunks.size(); ++i)
+    fprintf(out, "%s%s %lu %lu: %s\n", chunkPrefix, object.c_str(), chunks[i].offset,
+            chunks[i].size, chunks[i].digest.c_str());
+}
+
+/** Load the chunks listed in @a filename, as printed by printChunks, per
+    object. @return false if the file could not be read.
+  */
+inline bool loadChunks(char const *filename, std::map<std::string, std::vector<Chunk> > &objects)
+{
+  FILE *f = fopen(filename, "r");
+  if (!f)
+    return false;
+  size_t prefixSize = strlen(chunkPrefix);
+  char line[4096];
+  while (fgets(line, sizeof(line), f))
+  {
+    if (strncmp(line, chunkPrefix, prefixSize) != 0)
+      continue;
+    char *colon = strrchr(line, ':');
+    if (!colon)
+      continue;
+    *colon = 0;
+    char *sizeField = strrchr(line, ' ');
+    if (!sizeField)
+      continue;
+    *sizeField = 0;
+    char *offsetField = strrchr(line, ' ');
+    if (!offsetField || offsetField < line + prefixSize)
+      continue;
+    *offsetField = 0;
+    Chunk chunk = {strtoul(offsetField + 1, 0, 10), strtoul(sizeField + 1, 0, 10),
+                   std::string(colon + 2, strcspn(colon + 2, " \n"))};
+    objects[line + prefixSize].push_back(chunk);
+  }
+  fclose(f);
+  return true;
+}
+
+/** The byte ranges of the object with @a chunks which are not found in the
+    object with @a reference chunks, wherever they are there, merged when
+    adjacent.
+  */
+inline void differingRanges(std::vector<Chunk> const &chunks, std::vector<Chunk> const &reference,
+                     std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  std::set<std::string> known;
+  for (size_t i = 0; i < reference.size(); ++i)
+    known.insert(reference[i].digest);
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    if (known.count(chunks[i].digest))
+      continue;
+    size_t end = chunks[i].offset + chunks[i].size;
+    if (!ranges.empty() && ranges.back().second == chunks[i].offset)
+      ranges.back().second = end;
+    else
+      ranges.push_back(std::make_pair(chunks[i].offset, end));
+  }
+}
+
+#endif
@@ -11,13 +11,13 @@ struct CompressorSpec {
   unsigned char  header[3];
 };
 
-CompressorSpec compressorSpecs[] = {
+constexpr CompressorSpec compressorSpecs[] = {
   {uncompressZLIB, {'Z', 'L', Z_DEFLATED}},
   {uncompressLZMA, {'X', 'Z', 0}},
   {0, {0, 0, 0}}
 };
 
-constexpr CompressorFunc getCompressorFor(CompressorSpec *specs, unsigned char *buffer)
+constexpr CompressorFunc getCompressorFor(CompressorSpec const *specs, unsigned char *buffer)
 {
   return specs->func == 0                   ? 0
        : (buffer[0] == specs->header[0] 
@@ -26,4 +26,50 @@ constexpr CompressorFunc getCompressorFor(CompressorSpec *specs, unsigned char *
        : /* default */                        getCompressorFor(specs + 1, buffer);                                      
 }
 
+/** ROOT compresses objects in chunks of at most 16MB, each one with its own
+    9 bytes header: 3 bytes for the algorithm, 3 bytes (little endian) for
+    the compressed size of the chunk and 3 bytes for the uncompressed one.
+  */
+constexpr size_t compressedChunkHeaderSize = 9;
+
+// The compressed and uncompressed sizes in the header of @a chunk.
+inline void compressedChunkSizes(unsigned char const *chunk, size_t &chunkIn, size_t &chunkOut)
+{
+  chunkIn = chunk[3] | (chunk[4] << 8) | (chunk[5] << 16);
+  chunkOut = chunk[6] | (chunk[7] << 8) | (chunk[8] << 16);
+}
+
+/** Decompress all the chunks found in the @a sourceLen bytes of @a source
+    into @a output, which must be @a outputLen bytes long.
+
+    @return 0 on success, -1 if @a source is not a sequence of valid chunks
+            or the error reported by the decompressor otherwise.
+ */
+inline int uncompressObject(unsigned char *output, size_t outputLen,
+                     unsigned char *source, size_t sourceLen)
+{
+  size_t in = 0;
+  size_t out = 0;
+  while (out < outputLen)
+  {
+    if (in + compressedChunkHeaderSize > sourceLen)
+      return -1;
+    unsigned char *chunk = source + in;
+    CompressorFunc compressor = getCompressorFor(compressorSpecs, chunk);
+    if (!compressor)
+      return -1;
+    size_t chunkIn, chunkOut;
+    compressedChunkSizes(chunk, chunkIn, chunkOut);
+    if (in + compressedChunkHeaderSize + chunkIn > sourceLen || out + chunkOut > outputLen)
+      return -1;
+    // Both zlib and lzma use 0 for OK and 1 for STREAM_END.
+    int result = compressor(output + out, chunkOut, chunk, chunkIn + compressedChunkHeaderSize);
+    if (result != 0 && result != 1)
+      return result;
+    in += chunkIn + compressedChunkHeaderSize;
+    out += chunkOut;
+  }
+  return 0;
+}
+
 #endif
\ No newline at end of file
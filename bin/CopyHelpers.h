@@ -0,0 +1,78 @@
+#ifndef __COPY_HELPERS_H
+#define __COPY_HELPERS_H
+#include <algorithm>
+#include <vector>
+#include <unistd.h>
+#include <sys/types.h>
+#if __linux__
+# include <sys/sendfile.h>
+#endif
+
+/** Copies between files which, where the kernel allows it, do not go
+    through user space: copy_file_range, which can also share the blocks
+    on filesystems supporting reflinks, then sendfile, then plain reads and
+    writes as last resort.
+  */
+
+// Copy with pread and pwrite. @return false in case of errors.
+inline bool copyRangeBuffered(int in, size_t inOffset, int out, size_t outOffset, size_t size)
+{
+  std::vector<char> buffer(std::min(size, (size_t) 1 << 20));
+  while (size)
+  {
+    ssize_t n = pread(in, &buffer[0], std::min(size, buffer.size()), inOffset);
+    if (n <= 0)
+      return false;
+    for (ssize_t done = 0; done < n;)
+    {
+      ssize_t written = pwrite(out, &buffer[done], n - done, outOffset + done);
+      if (written <= 0)
+        return false;
+      done += written;
+    }
+    inOffset += n;
+    outOffset += n;
+    size -= n;
+  }
+  return true;
+}
+
+/** Copy @a size bytes at @a inOffset of @a in to @a outOffset of @a out.
+    @return false in case of errors.
+  */
+inline bool copyRange(int in, size_t inOffset, int out, size_t outOffset, size_t size)
+{
+#if __linux__
+  loff_t inPos = inOffset, outPos = outOffset;
+  while (size)
+  {
+    ssize_t n = copy_file_range(in, &inPos, out, &outPos, size, 0);
+    if (n <= 0)
+      break;
+    size -= n;
+  }
+  if (!size)
+    return true;
+  // sendfile writes at the current position of @a out.
+  if (lseek(out, outPos, SEEK_SET) == (off_t) outPos)
+  {
+    off_t sendPos = inPos;
+    while (size)
+    {
+      ssize_t n = sendfile(out, in, &sendPos, size);
+      if (n <= 0)
+        break;
+      size -= n;
+      outPos += n;
+    }
+    inPos = sendPos;
+  }
+  if (!size)
+    return true;
+  inOffset = inPos;
+  outOffset = outPos;
+#endif
+  return copyRangeBuffered(in, inOffset, out, outOffset, size);
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef __CORPUS_HELPERS_H
+#define __CORPUS_HELPERS_H
+#include "HashHelpers.h"
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/** A persistent content addressed store of the objects of many files, to
+    find out how much they share.
+
+    The store is a file holding an open addressing hash table, with linear
+    probing, mapped in memory: a CorpusHeader followed by a power of two
+    number of CorpusEntry, one per distinct object, keyed by the SHA1 of its
+    uncompressed payload. Each entry counts the copies of the object and
+    remembers where it was seen first, as the index of the file in the
+    "<store>.files" list, which has one path per line, and the position of
+    its key. The table is doubled when it is 3/4 full, into a new file which
+    then replaces the store, so that a failure while growing leaves the
+    store as it was. Values are stored in the byte order of the machine.
+  */
+constexpr char corpusMagic[8] = {'b', 'r', 'u', 't', 'c', 'a', 's', '1'};
+constexpr uint64_t corpusInitialCapacity = 1 << 16;
+
+struct CorpusHeader {
+  char      magic[8];
+  uint64_t  capacity;
+  uint64_t  used;
+  uint64_t  reserved;
+};
+
+// An entry with no references is empty.
+struct CorpusEntry {
+  unsigned char digest[SHA1_SIZE];
+  uint32_t      file;
+  uint64_t      offset;
+  uint64_t      size;
+  uint64_t      refs;
+};
+
+static_assert(sizeof(CorpusEntry) == 48, "CorpusEntry must not be padded");
+
+struct CorpusStore {
+  int           fd;
+  char          *map;
+  size_t        mapSize;
+  std::string   path;
+
+  CorpusStore() : fd(-1), map(0), mapSize(0) {}
+  ~CorpusStore() { close(); }
+
+  CorpusHeader &header() { return *(CorpusHeader *) map; }
+  CorpusEntry *entries() { return (CorpusEntry *) (map + sizeof(CorpusHeader)); }
+
+  /** Open the store at @a path, creating it if needed.
+      @return false if it cannot be created or is not a store.
+    */
+  bool open(char const *aPath)
+  {
+    close();
+    path = aPath;
+    fd = ::open(aPath, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+      return false;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size == 0)
+      return create(corpusInitialCapacity);
+    CorpusHeader stored;
+    if (size < (off_t) sizeof(stored) || pread(fd, &stored, sizeof(stored), 0) != sizeof(stored)
+        || memcmp(stored.magic, corpusMagic, sizeof(corpusMagic)) != 0
+        || (stored.capacity & (stored.capacity - 1))
+        || size != (off_t) (sizeof(CorpusHeader) + stored.capacity * sizeof(CorpusEntry)))
+    {
+      close();
+      return false;
+    }
+    return mapFile(size);
+  }
+
+  void close()
+  {
+    if (map)
+      munmap(map, mapSize);
+    if (fd >= 0)
+      ::close(fd);
+    map = 0;
+    mapSize = 0;
+    fd = -1;
+  }
+
+  /** Add a copy of the object with @a digest, found in @a file at
+      @a offset, with @a size bytes.
+      @return its entry, which is only valid until the next insertion, or
+              0 if the store could not grow.
+    */
+  CorpusEntry *insert(unsigned char const *digest, uint32_t file, uint64_t offset, uint64_t size)
+  {
+    if (4 * (header().used + 1) > 3 * header().capacity && !grow())
+      return 0;
+    CorpusEntry &entry = *slot(digest);
+    if (!entry.refs)
+    {
+      memcpy(entry.digest, digest, SHA1_SIZE);
+      entry.file = file;
+      entry.offset = offset;
+      entry.size = size;
+      ++header().used;
+    }
+    ++entry.refs;
+    return &entry;
+  }
+
+  /** Make room for @a count more objects, so that inserting them does not
+      need to grow the table.
+      @return false if it could not grow.
+    */
+  bool reserve(uint64_t count)
+  {
+    while (4 * (header().used + count) > 3 * header().capacity)
+      if (!grow())
+        return false;
+    return true;
+  }
+
+  /** Take back the last copy added of the object with @a digest. Entries
+      are only emptied correctly when the last insertions, since the table
+      last grew, are taken back in the reverse order.
+    */
+  void release(unsigned char const *digest)
+  {
+    CorpusEntry &entry = *slot(digest);
+    if (!entry.refs || --entry.refs)
+      return;
+    memset(&entry, 0, sizeof(entry));
+    --header().used;
+  }
+
+  // The entry of @a digest, or the empty one where it would go.
+  CorpusEntry *slot(unsigned char const *digest)
+  {
+    uint64_t mask = header().capacity - 1;
+    uint64_t i;
+    memcpy(&i, digest, sizeof(i));
+    for (i &= mask;; i = (i + 1) & mask)
+    {
+      CorpusEntry &entry = entries()[i];
+      if (!entry.refs || memcmp(entry.digest, digest, SHA1_SIZE) == 0)
+        return &entry;
+    }
+  }
+
+  bool mapFile(size_t size)
+  {
+    map = (char *) mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+      map = 0;
+      return false;
+    }
+    mapSize = size;
+    return true;
+  }
+
+  // Size the empty file of the store for @a capacity entries, all empty.
+  bool create(uint64_t capacity)
+  {
+    size_t size = sizeof(CorpusHeader) + capacity * sizeof(CorpusEntry);
+    if (ftruncate(fd, size) != 0 || !mapFile(size))
+      return false;
+    memcpy(header().magic, corpusMagic, sizeof(corpusMagic));
+    header().capacity = capacity;
+    return true;
+  }
+
+  /** Double the capacity of the table. The new table is built in
+      "<store>.grow", which is only renamed over the store once complete.
+      @return false, leaving the store untouched, if it could not be built.
+    */
+  bool grow()
+  {
+    CorpusStore grown;
+    grown.path = path + ".grow";
+    grown.fd = ::open(grown.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    bool valid = grown.fd >= 0 && grown.create(header().capacity * 2);
+    for (uint64_t i = 0; valid && i < header().capacity; ++i)
+      if (entries()[i].refs)
+        *grown.slot(entries()[i].digest) = entries()[i];
+    if (valid)
+      grown.header().used = header().used;
+    valid = valid && msync(grown.map, grown.mapSize, MS_SYNC) == 0
+            && rename(grown.path.c_str(), path.c_str()) == 0;
+    if (!valid)
+    {
+      if (grown.fd >= 0)
+        unlink(grown.path.c_str());
+      return false;
+    }
+    // The old table goes away with grown.
+    std::swap(fd, grown.fd);
+    std::swap(map, grown.map);
+    std::swap(mapSize, grown.mapSize);
+    return true;
+  }
+};
+
+/** Read the list of the files of the store at @a path in @a files.
+    @return false if there is a list but it cannot be read.
+  */
+inline bool loadCorpusFiles(char const *path, std::vector<std::string> &files)
+{
+  files.clear();
+  FILE *f = fopen((std::string(path) + ".files").c_str(), "r");
+  if (!f)
+    return access((std::string(path) + ".files").c_str(), F_OK) != 0;
+  char line[4096];
+  while (fgets(line, sizeof(line), f))
+    files.push_back(std::string(line, strcspn(line, "\n")));
+  fclose(f);
+  return true;
+}
+
+inline bool addCorpusFile(char const *path, std::string const &file)
+{
+  FILE *f = fopen((std::string(path) + ".files").c_str(), "a");
+  if (!f)
+    return false;
+  bool written = fprintf(f, "%s\n", file.c_str()) > 0;
+  return (fclose(f) == 0) && written;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef __DIFF_HELPERS_H
+#define __DIFF_HELPERS_H
+#include "ByteSwapHelpers.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+/** Byte level comparison of two buffers, e.g. two uncompressed objects.
+
+    Differences are reported in lines of diffLineSize bytes, aligned as the
+    ones of dump_hex, so that they can be shown side by side with their
+    context. Finding the first differing byte is what takes the time for
+    large, mostly identical, buffers, so it is done 32 or 64 bytes at the
+    time when the CPU supports it.
+  */
+constexpr size_t diffLineSize = 16;
+
+// The first position in [@a from, @a size) where @a a and @a b differ, or
+// @a size if there is none.
+typedef size_t (*MismatchKernel)(char const *a, char const *b, size_t from, size_t size);
+
+inline size_t firstMismatchScalar(char const *a, char const *b, size_t from, size_t size)
+{
+  size_t i = from;
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t x, y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    if (x != y)
+      return i + __builtin_ctzll(x ^ y) / 8;
+  }
+  for (; i < size; ++i)
+    if (a[i] != b[i])
+      return i;
+  return size;
+}
+
+#if __HAVE_X86_SIMD__
+__attribute__((target("avx2")))
+inline size_t firstMismatchAVX2(char const *a, char const *b, size_t from, size_t size)
+{
+  size_t i = from;
+  for (; i + 64 <= size; i += 64)
+  {
+    __m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(a + i)),
+                                   _mm256_loadu_si256((__m256i const *)(b + i)));
+    __m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(a + i + 32)),
+                                   _mm256_loadu_si256((__m256i const *)(b + i + 32)));
+    if (_mm256_movemask_epi8(_mm256_and_si256(e0, e1)) == -1)
+      continue;
+    unsigned m0 = ~(unsigned) _mm256_movemask_epi8(e0);
+    if (m0)
+      return i + __builtin_ctz(m0);
+    return i + 32 + __builtin_ctz(~(unsigned) _mm256_movemask_epi8(e1));
+  }
+  return firstMismatchScalar(a, b, i, size);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline size_t firstMismatchAVX512(char const *a, char const *b, size_t from, size_t size)
+{
+  size_t i = from;
+  for (; i + 64 <= size; i += 64)
+  {
+    __mmask64 differ = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+    if (differ)
+      return i + __builtin_ctzll(differ);
+  }
+  if (i < size)
+  {
+    __mmask64 tail = ~0ULL >> (64 - (size - i));
+    __mmask64 differ = _mm512_mask_cmpneq_epi8_mask(tail, _mm512_maskz_loadu_epi8(tail, a + i),
+                                                    _mm512_maskz_loadu_epi8(tail, b + i));
+    if (differ)
+      return i + __builtin_ctzll(differ);
+  }
+  return size;
+}
+#endif
+
+inline MismatchKernel mismatchKernel(SimdLevel level)
+{
+#if __HAVE_X86_SIMD__
+  if (level == SIMD_AVX512)
+    return firstMismatchAVX512;
+  if (level == SIMD_AVX2)
+    return firstMismatchAVX2;
+#endif
+  return firstMismatchScalar;
+}
+
+/** A range of differing bytes, [@a begin, @a end), extended to whole lines. */
+struct DiffRange {
+  size_t begin;
+  size_t end;
+};
+
+/** Append to @a ranges the lines where the first @a size bytes of @a a and
+    @a b differ, merging consecutive lines.
+  */
+inline void diffRanges(char const *a, char const *b, size_t size, std::vector<DiffRange> &ranges,
+                MismatchKernel kernel = mismatchKernel(bestSimdLevel()))
+{
+  size_t pos = kernel(a, b, 0, size);
+  while (pos < size)
+  {
+    DiffRange range = {pos & ~(diffLineSize - 1), 0};
+    size_t line = range.begin;
+    while (line < size)
+    {
+      size_t lineSize = std::min(diffLineSize, size - line);
+      if (memcmp(a + line, b + line, lineSize) == 0)
+        break;
+      line += lineSize;
+    }
+    range.end = line;
+    ranges.push_back(range);
+    pos = kernel(a, b, line, size);
+  }
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef __EVENT_HELPERS_H
+#define __EVENT_HELPERS_H
+#include "CMSSWSchema.h"
+#include "HashHelpers.h"
+#include <stdint.h>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+// The tree where CMSSW stores the events, and the branch with their ids.
+constexpr char eventsTree[] = "Events";
+constexpr char eventAuxiliaryBranch[] = "Events/EventAuxiliary";
+
+/** What identifies an event in CMSSW. */
+struct EventId {
+  uint32_t run;
+  uint32_t lumi;
+  uint64_t event;
+};
+
+inline bool operator<(EventId const &a, EventId const &b)
+{
+  return a.run != b.run   ? a.run < b.run
+       : a.lumi != b.lumi ? a.lumi < b.lumi
+       :                    a.event < b.event;
+}
+
+inline bool operator==(EventId const &a, EventId const &b)
+{
+  return a.run == b.run && a.lumi == b.lumi && a.event == b.event;
+}
+
+struct EventIdHash {
+  size_t operator()(EventId const &id) const
+  {
+    return fastHash64(&id, sizeof(id));
+  }
+};
+
+/** Parse "<run>:<lumi>:<event>". @return false if @a text is not one. */
+inline bool parseEventId(char const *text, EventId &id)
+{
+  unsigned long long event;
+  char trailing;
+  if (sscanf(text, "%u:%u:%llu%c", &id.run, &id.lumi, &event, &trailing) != 3)
+    return false;
+  id.event = event;
+  return true;
+}
+
+/** Decode the EventID of the streamed edm::EventAuxiliary in @a buffer.
+    @return false if its version is not one we know about.
+  */
+inline bool decodeEventAuxiliary(char const *buffer, EventId &id)
+{
+  Object aux(EventAuxiliarySpec, buffer);
+  Object eventID = aux.next(EventIDSpec);
+  short version = eventID.getShort("Version.value");
+  if (version >= 11)
+  {
+    id.run = getInt(EventIDSpec, eventID.buffer, "run");
+    id.lumi = getInt(EventIDSpec, eventID.buffer, "luminosityBlock");
+    id.event = getInt64(EventIDSpec, eventID.buffer, "event");
+    return true;
+  }
+  if (version == 10)
+  {
+    id.run = getInt(EventIDSpecV10, eventID.buffer, "run");
+    id.lumi = getInt(EventIDSpecV10, eventID.buffer, "luminosityBlock");
+    id.event = (uint32_t) getInt(EventIDSpecV10, eventID.buffer, "event");
+    return true;
+  }
+  return false;
+}
+
+/** The events of a file, sorted by id, with the entry they are stored at.
+    Add the events, then call sort() before looking them up.
+  */
+struct EventIndex {
+  struct Item {
+    EventId  id;
+    uint64_t entry;
+  };
+
+  EventIndex() : built(false), unknown(0) {}
+
+  void add(EventId const &id, uint64_t entry)
+  {
+    Item item = {id, entry};
+    items.push_back(item);
+  }
+
+  void sort()
+  {
+    std::sort(items.begin(), items.end(), [](Item const &a, Item const &b) {
+      return a.id < b.id;
+    });
+  }
+
+  // @return the entry of the event @a id, or -1 if it is not in the file.
+  int64_t find(EventId const &id) const
+  {
+    std::vector<Item>::const_iterator i = std::lower_bound(items.begin(), items.end(), id,
+                                                           [](Item const &a, EventId const &b) {
+      return a.id < b;
+    });
+    return i != items.end() && i->id == id ? (int64_t) i->entry : -1;
+  }
+
+  std::vector<Item> items;
+  bool              built;
+  size_t            unknown;  // Entries whose id could not be decoded.
+};
+
+#endif
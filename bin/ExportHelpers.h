@@ -0,0 +1,235 @@
+#ifndef __EXPORT_HELPERS_H
+#define __EXPORT_HELPERS_H
+#include "BrutHeaders.h"
+#include "BasketHelpers.h"
+#include "ByteSwapHelpers.h"
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/** The types of the values one can export, with the numpy dtype they are
+    written as. Values are stored big endian in the baskets and exported in
+    the byte order of the machine, which the dtypes say.
+  */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+# define __NATIVE_DTYPE_ORDER__ ">"
+#else
+# define __NATIVE_DTYPE_ORDER__ "<"
+#endif
+
+struct ColumnType {
+  char const  *label;
+  size_t      size;
+  char const  *dtype;
+};
+
+constexpr ColumnType columnTypes[] = {
+  {"int8", 1, "|i1"},
+  {"uint8", 1, "|u1"},
+  {"bool", 1, "|b1"},
+  {"int16", 2, __NATIVE_DTYPE_ORDER__ "i2"},
+  {"uint16", 2, __NATIVE_DTYPE_ORDER__ "u2"},
+  {"int32", 4, __NATIVE_DTYPE_ORDER__ "i4"},
+  {"uint32", 4, __NATIVE_DTYPE_ORDER__ "u4"},
+  {"int64", 8, __NATIVE_DTYPE_ORDER__ "i8"},
+  {"uint64", 8, __NATIVE_DTYPE_ORDER__ "u8"},
+  {"float", 4, __NATIVE_DTYPE_ORDER__ "f4"},
+  {"double", 8, __NATIVE_DTYPE_ORDER__ "f8"},
+  {0, 0, 0}
+};
+
+constexpr ColumnType const *columnType(ColumnType const *types, char const *label)
+{
+  return types->label == 0          ? 0
+       : !same(types->label, label) ? columnType(types + 1, label)
+       :                              types;
+}
+
+/** Layout of the files written by export:
+
+    - an ExportFileHeader,
+    - nColumns ExportColumnHeader,
+    - the values of each column, as a contiguous array starting at an
+      exportAlignment aligned offset.
+
+    so that the columns can be mapped as they are, e.g. with numpy.memmap.
+  */
+constexpr char exportMagic[8] = {'B', 'R', 'U', 'T', 'C', 'O', 'L', 'S'};
+constexpr uint32_t exportVersion = 1;
+constexpr size_t exportAlignment = 64;
+
+struct ExportFileHeader {
+  char      magic[8];
+  uint32_t  version;
+  uint32_t  nColumns;
+};
+
+/** - @a name    "tree/branch", zero padded.
+    - @a dtype   the numpy dtype of the values, zero padded.
+    - @a offset  where the values start, from the beginning of the file.
+    - @a count   the number of values.
+    - @a entries the number of entries, each having count / entries values.
+  */
+struct ExportColumnHeader {
+  char      name[96];
+  char      dtype[8];
+  uint64_t  offset;
+  uint64_t  count;
+  uint64_t  entries;
+};
+
+/** A column to be exported.
+
+    - @a branch   the branch id in BasketScan::branches.
+    - @a type     the type of its values.
+    - @a baskets  its baskets, as indices in BasketScan::baskets, in entry
+                  order.
+    - @a offsets  where the payload of each basket goes in the output file.
+  */
+struct ExportColumn {
+  size_t              branch;
+  ColumnType const    *type;
+  std::vector<size_t> baskets;
+  std::vector<size_t> offsets;
+  uint64_t            offset;
+  uint64_t            count;
+  uint64_t            entries;
+};
+
+inline size_t alignExport(size_t offset)
+{
+  return (offset + exportAlignment - 1) & ~(exportAlignment - 1);
+}
+
+/** The type given for the branch @a branch of @a scan in BasketScan::options,
+    or 0 if there is none or it is not known, in which case this is reported.
+  */
+inline ColumnType const *selectedColumnType(BasketScan const &scan, size_t branch, FILE *out = stdout)
+{
+  std::string const &name = scan.branches[branch];
+  std::string label = scan.option(name);
+  if (label.empty())
+  {
+    fprintf(out, "Please specify the type of branch %s, as <branch>:<type>.\n", name.c_str());
+    return 0;
+  }
+  ColumnType const *type = columnType(columnTypes, label.c_str());
+  if (!type)
+    fprintf(out, "Unknown type \"%s\" for branch %s.\n", label.c_str(), name.c_str());
+  return type;
+}
+
+/** Whether @a basket has fixed size entries, i.e. no offsets array, made of
+    values of @a type, so that its payload is just an array of them.
+  */
+inline bool isValueArray(BasketInfo const &basket, ColumnType const *type)
+{
+  return basketDataSize(basket) == basket.objLen && basket.nevBufSize > 0
+         && basket.nevBufSize % type->size == 0
+         && (size_t) basket.nevBuf * basket.nevBufSize == basket.objLen;
+}
+
+/** Plan the output of export: one column for each of the branches in
+    @a scan which has a type in BasketScan::options and fixed size entries,
+    with the position in the output of every basket, so that baskets can be
+    decompressed straight into place.
+
+    Branches which cannot be exported are reported and left out.
+
+    @return the size of the output file.
+  */
+inline size_t planExport(BasketScan const &scan, std::vector<ExportColumn> &columns, FILE *out = stdout)
+{
+  columns.clear();
+  std::vector<int> columnIds(scan.branches.size(), -1);
+  for (size_t b = 0; b < scan.branches.size(); ++b)
+  {
+    ColumnType const *type = selectedColumnType(scan, b, out);
+    if (!type)
+      continue;
+    if (scan.branches[b].size() >= sizeof(ExportColumnHeader().name))
+    {
+      fprintf(out, "Branch name %s too long.\n", scan.branches[b].c_str());
+      continue;
+    }
+    ExportColumn column = {b, type, std::vector<size_t>(), std::vector<size_t>(), 0, 0, 0};
+    columnIds[b] = columns.size();
+    columns.push_back(column);
+  }
+
+  for (size_t i = 0; i < scan.baskets.size(); ++i)
+  {
+    BasketInfo const &basket = scan.baskets[i];
+    int id = columnIds[basket.branch];
+    if (id < 0)
+      continue;
+    ExportColumn &column = columns[id];
+    if (!isValueArray(basket, column.type))
+    {
+      fprintf(out, "Branch %s does not have fixed size %s entries.\n",
+              scan.branches[basket.branch].c_str(), column.type->label);
+      columnIds[basket.branch] = -1;
+      continue;
+    }
+    column.baskets.push_back(i);
+    column.count += basket.objLen / column.type->size;
+    column.entries += basket.nevBuf;
+  }
+
+  std::vector<ExportColumn> valid;
+  for (size_t c = 0; c < columns.size(); ++c)
+    if (columnIds[columns[c].branch] >= 0)
+      valid.push_back(columns[c]);
+  columns.swap(valid);
+  if (columns.empty())
+    return 0;
+
+  size_t offset = alignExport(sizeof(ExportFileHeader) + columns.size() * sizeof(ExportColumnHeader));
+  for (size_t c = 0; c < columns.size(); ++c)
+  {
+    ExportColumn &column = columns[c];
+    column.offset = offset;
+    for (size_t i = 0; i < column.baskets.size(); ++i)
+    {
+      column.offsets.push_back(offset);
+      offset += scan.baskets[column.baskets[i]].objLen;
+    }
+    offset = alignExport(offset);
+  }
+  return offset;
+}
+
+/** Write the headers describing @a columns of @a scan at @a output. */
+inline void writeExportHeaders(BasketScan const &scan, std::vector<ExportColumn> const &columns, char *output)
+{
+  ExportFileHeader header;
+  memcpy(header.magic, exportMagic, sizeof(exportMagic));
+  header.version = exportVersion;
+  header.nColumns = columns.size();
+  memcpy(output, &header, sizeof(header));
+  for (size_t c = 0; c < columns.size(); ++c)
+  {
+    ExportColumnHeader column;
+    memset(&column, 0, sizeof(column));
+    std::string const &name = scan.branches[columns[c].branch];
+    memcpy(column.name, name.data(), name.size());
+    strncpy(column.dtype, columns[c].type->dtype, sizeof(column.dtype));
+    column.offset = columns[c].offset;
+    column.count = columns[c].count;
+    column.entries = columns[c].entries;
+    memcpy(output + sizeof(header) + c * sizeof(column), &column, sizeof(column));
+  }
+}
+
+/** Convert in place @a count big endian values of @a size bytes each at
+    @a data to native order.
+  */
+inline void toNativeOrder(char *data, size_t count, size_t size)
+{
+#if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+  byteSwapArray(data, data, count, size);
+#endif
+}
+
+#endif
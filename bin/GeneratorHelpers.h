@@ -0,0 +1,298 @@
+#ifndef __GENERATOR_HELPERS_H
+#define __GENERATOR_HELPERS_H
+#include "BasketHelpers.h"
+#include "MerkleHelpers.h"
+#include "RecompressHelpers.h"
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** Synthetic files in the ROOT format, following the layouts of
+    ROOTSchema.h, so that brut can be tested and benchmarked without real
+    data:
+
+        file header | TFile key | objects and baskets | keys list | free segments
+
+    Objects are TObjString keys and baskets TBasket keys of the branches
+    "b<n>" of the tree "Events", all in the top directory. Their payloads
+    are big endian floats, which compress about as well as physics data,
+    stored as is, or as zlib or lzma chunks of at most
+    GeneratorOptions::chunk bytes each. Keys past generatorBigFile, and all
+    of them with GeneratorOptions::big, have the big (Version > 1000)
+    header, and so has the file header of files larger than that. There is
+    no streamer info.
+
+    Everything only depends on GeneratorOptions, so that the same options
+    always give the same file, and the Merkle tree of its objects, as
+    listmerkle would print it, is computed while writing it.
+  */
+constexpr uint64_t generatorBigFile = 2000000000;
+constexpr size_t generatorBegin = 100;
+constexpr size_t generatorMaxChunk = 0xffffff;
+// 2020-01-01 00:00:00, in the format of ROOT.
+constexpr unsigned generatorDatetime = (2020 - 1995) << 26 | 1 << 22 | 1 << 17;
+constexpr char generatorTree[] = "Events";
+
+struct GeneratorOptions {
+  uint64_t  keys;       // The number of objects, unless size is given.
+  uint64_t  size;       // Add objects until the file has at least this size.
+  size_t    minSize;    // Object sizes are log uniform in [minSize, maxSize].
+  size_t    maxSize;
+  double    baskets;    // The fraction of the objects which are baskets,
+  unsigned  branches;   // spread over that many branches.
+  double    zlib;       // The fractions of the objects compressed with zlib
+  double    lzma;       // and lzma, the others are stored as is.
+  int       level;
+  size_t    chunk;      // The largest uncompressed size of a chunk.
+  bool      big;        // Big headers, even for small files.
+  uint64_t  seed;
+};
+
+GeneratorOptions const generatorDefaults = {1000, 0, 100, 100000, 0.8, 10, 0.6, 0.1, 1, generatorMaxChunk, false, 1};
+
+// The next value of the splitmix64 sequence in @a state.
+inline uint64_t generatorRandom(uint64_t &state)
+{
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// A uniform value in [0, 1).
+inline double generatorUniform(uint64_t &state)
+{
+  return (generatorRandom(state) >> 11) * (1.0 / (1ULL << 53));
+}
+
+// Append the @a size lowest bytes of @a value to @a out, big endian.
+inline void generatorPut(std::vector<char> &out, uint64_t value, int size)
+{
+  for (int i = size - 1; i >= 0; --i)
+    out.push_back((char) (value >> (8 * i)));
+}
+
+inline void generatorPutString(std::vector<char> &out, std::string const &value)
+{
+  generatorPut(out, value.size(), 1);
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+// Payload of @a size bytes, the floats of the random sequence @a state.
+inline void generatorPayload(uint64_t state, size_t size, std::vector<unsigned char> &payload)
+{
+  payload.resize(size);
+  for (size_t i = 0; i < size; i += 4)
+  {
+    float value = 100.f + generatorRandom(state) % 1000 / 10.f;
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    bits = bswap_32(bits);
+    memcpy(&payload[i], &bits, std::min((size_t) 4, size - i));
+  }
+}
+
+/** Compress @a payload in @a data as ROOT chunks of at most @a chunk
+    bytes, with lzma if @a lzma, zlib otherwise.
+    @return false if it does not get any smaller, and should be stored as is.
+  */
+inline bool generatorCompress(CodecContext &codec, std::vector<unsigned char> const &payload, bool lzma, int level,
+                       size_t chunk, std::vector<char> &data)
+{
+  data.clear();
+  std::vector<unsigned char> zip;
+  for (size_t offset = 0; offset < payload.size(); offset += chunk)
+  {
+    size_t size = std::min(chunk, payload.size() - offset);
+    if (!(lzma ? compressLzma : compressZlib)(codec, level, &payload[offset], size, zip)
+        || zip.size() + 9 >= size)
+      return false;
+    generatorPut(data, lzma ? 'X' : 'Z', 1);
+    generatorPut(data, lzma ? 'Z' : 'L', 1);
+    generatorPut(data, lzma ? 0 : Z_DEFLATED, 1);
+    for (int i = 0; i < 3; ++i)
+      generatorPut(data, zip.size() >> (8 * i), 1);
+    for (int i = 0; i < 3; ++i)
+      generatorPut(data, size >> (8 * i), 1);
+    data.insert(data.end(), zip.begin(), zip.end());
+  }
+  return data.size() < payload.size();
+}
+
+// The header of @a key, which has the big layout if @a big.
+inline void generatorKeyHeader(KeyInfo const &key, bool big, std::vector<char> &header)
+{
+  header.clear();
+  generatorPut(header, key.nbytes, 4);
+  generatorPut(header, big ? 1004 : 4, 2);
+  generatorPut(header, key.objLen, 4);
+  generatorPut(header, generatorDatetime, 4);
+  generatorPut(header, key.keyLen, 2);
+  generatorPut(header, key.cycle, 2);
+  generatorPut(header, key.seekKey, big ? 8 : 4);
+  generatorPut(header, key.seekPdir, big ? 8 : 4);
+  generatorPutString(header, key.className);
+  generatorPutString(header, key.name);
+  generatorPutString(header, key.title);
+  if (key.className != "TBasket")
+    return;
+  generatorPut(header, 3, 2);
+  generatorPut(header, 32000, 4);
+  generatorPut(header, 4, 4);
+  generatorPut(header, key.objLen / 4, 4);
+  generatorPut(header, key.keyLen + key.objLen, 4);
+  generatorPut(header, 0, 1);
+}
+
+// The KeyLen of @a key, with a big header if @a big.
+inline unsigned generatorKeyLen(KeyInfo const &key, bool big)
+{
+  return 18 + (big ? 16 : 8) + 3 + key.className.size() + key.name.size() + key.title.size()
+         + (key.className == "TBasket" ? 19 : 0);
+}
+
+/** Write @a data as the object of @a key, whose seekKey, seekPdir, names,
+    cycle and objLen are set, at its position in @a fd, with a big header
+    if @a big. Its nbytes and keyLen are set here, and @a buffer holds the
+    key as written.
+  */
+inline bool generatorWriteKey(int fd, KeyInfo &key, bool big, std::vector<char> const &data, std::vector<char> &buffer)
+{
+  key.keyLen = generatorKeyLen(key, big);
+  key.nbytes = key.keyLen + data.size();
+  generatorKeyHeader(key, big, buffer);
+  buffer.insert(buffer.end(), data.begin(), data.end());
+  return pwrite(fd, &buffer[0], buffer.size(), key.seekKey) == (ssize_t) buffer.size();
+}
+
+/** Write the file @a path for @a options, and add its objects to
+    @a manifest, which is then updated.
+    @return false if it could not be written, with errno set.
+  */
+inline bool generateFile(char const *path, GeneratorOptions const &options, MerkleTree &manifest)
+{
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  std::string fileName = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  // The TFile key holds the name and title of the file, then the record of
+  // the top directory, which always has 60 bytes.
+  KeyInfo top = {generatorBegin, 0, 0, 0, 0, 1, "TFile", fileName, "", {0, 0, 0}};
+  top.objLen = 2 + fileName.size() + 60;
+  size_t pos = generatorBegin + generatorKeyLen(top, false) + top.objLen;
+
+  CodecContext codec;
+  std::vector<char> keysList;
+  uint32_t nkeys = 0;
+  std::map<std::string, size_t> basketIndex;
+  std::vector<unsigned char> payload;
+  std::vector<char> data;
+  std::vector<char> buffer;
+  for (uint64_t i = 0; options.size ? pos < options.size : i < options.keys; ++i)
+  {
+    uint64_t state = options.seed * 0x100000001b3ULL + i;
+    generatorRandom(state);
+    double u = generatorUniform(state);
+    size_t size = options.minSize * pow((double) options.maxSize / options.minSize, generatorUniform(state));
+    bool basket = u < options.baskets;
+    KeyInfo key = {pos, generatorBegin, 0, 0, 0, 1, "TObjString", "", "", {0, 0, 0}};
+    char name[32];
+    if (basket)
+    {
+      size = std::max(size & ~(size_t) 3, (size_t) 4);
+      snprintf(name, sizeof(name), "b%u", (unsigned) (generatorRandom(state) % std::max(options.branches, 1u)));
+      key.className = "TBasket";
+      key.title = generatorTree;
+    }
+    else
+      snprintf(name, sizeof(name), "o%llu", (unsigned long long) i);
+    key.name = name;
+    key.objLen = size;
+    generatorPayload(generatorRandom(state), size, payload);
+    double algorithm = generatorUniform(state);
+    bool compressed = algorithm < options.zlib + options.lzma
+                      && generatorCompress(codec, payload, algorithm >= options.zlib, options.level,
+                                           std::min(options.chunk, generatorMaxChunk), data);
+    if (!compressed)
+      data.assign(payload.begin(), payload.end());
+    if (!generatorWriteKey(fd, key, options.big || key.seekKey > generatorBigFile, data, buffer))
+    {
+      close(fd);
+      return false;
+    }
+    if (!basket)
+    {
+      keysList.insert(keysList.end(), buffer.begin(), buffer.begin() + key.keyLen);
+      ++nkeys;
+    }
+    unsigned char digest[SHA1_SIZE];
+    sha1(&payload[0], payload.size(), digest);
+    manifest.addLeaf(merkleLeaf(key, "", basketIndex[key.title + "/" + key.name]++), digestToHex(digest));
+    pos += key.nbytes;
+  }
+  manifest.update();
+
+  // The keys of the top directory, then the free segments, after which
+  // the file ends.
+  KeyInfo keys = {pos, generatorBegin, 0, 0, 0, 1, "TFile", fileName, "", {0, 0, 0}};
+  data.clear();
+  generatorPut(data, nkeys, 4);
+  data.insert(data.end(), keysList.begin(), keysList.end());
+  keys.objLen = data.size();
+  bool written = generatorWriteKey(fd, keys, options.big || pos > generatorBigFile, data, buffer);
+  pos += keys.nbytes;
+  KeyInfo free = {pos, generatorBegin, 0, 0, 0, 1, "TFile", fileName, "", {0, 0, 0}};
+  bool big = options.big || pos > generatorBigFile;
+  free.objLen = big ? 18 : 10;
+  size_t end = pos + generatorKeyLen(free, big) + free.objLen;
+  data.clear();
+  generatorPut(data, big ? 1001 : 1, 2);
+  generatorPut(data, end, big ? 8 : 4);
+  generatorPut(data, big ? (1ULL << 62) : generatorBigFile, big ? 8 : 4);
+  written = written && generatorWriteKey(fd, free, big, data, buffer);
+
+  uint64_t uuid = options.seed;
+  data.clear();
+  generatorPutString(data, fileName);
+  generatorPutString(data, "");
+  generatorPut(data, big ? 1005 : 5, 2);
+  generatorPut(data, generatorDatetime, 4);
+  generatorPut(data, generatorDatetime, 4);
+  generatorPut(data, keys.nbytes, 4);
+  generatorPut(data, generatorKeyLen(top, false) + 2 + fileName.size(), 4);
+  generatorPut(data, generatorBegin, big ? 8 : 4);
+  generatorPut(data, 0, big ? 8 : 4);
+  generatorPut(data, keys.seekKey, big ? 8 : 4);
+  generatorPut(data, 1, 2);
+  generatorPut(data, generatorRandom(uuid), 8);
+  generatorPut(data, generatorRandom(uuid), 8);
+  data.resize(top.objLen, 0);
+  written = written && generatorWriteKey(fd, top, false, data, buffer);
+
+  data.clear();
+  data.insert(data.end(), "root", "root" + 4);
+  generatorPut(data, big ? 1062206 : 62206, 4);
+  generatorPut(data, generatorBegin, 4);
+  generatorPut(data, end, big ? 8 : 4);
+  generatorPut(data, free.seekKey, big ? 8 : 4);
+  generatorPut(data, free.nbytes, 4);
+  generatorPut(data, 1, 4);
+  generatorPut(data, generatorKeyLen(top, false) + 2 + fileName.size(), 4);
+  generatorPut(data, big ? 8 : 4, 1);
+  generatorPut(data, (options.lzma > options.zlib ? 200 : 100) + options.level, 4);
+  generatorPut(data, 0, big ? 8 : 4);
+  generatorPut(data, 0, 4);
+  generatorPut(data, 1, 2);
+  generatorPut(data, generatorRandom(uuid), 8);
+  generatorPut(data, generatorRandom(uuid), 8);
+  data.resize(generatorBegin, 0);
+  written = written && pwrite(fd, &data[0], data.size(), 0) == (ssize_t) data.size();
+  return (close(fd) == 0) && written;
+}
+
+#endif
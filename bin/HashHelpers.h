@@ -0,0 +1,346 @@
+#ifndef __HASH_HELPERS_H
+#define __HASH_HELPERS_H
+#include "ByteSwapHelpers.h"
+#include "StatsHelpers.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+
+#if __APPLE__
+# include <CommonCrypto/CommonDigest.h>
+#else
+# include <openssl/evp.h>
+#endif
+
+constexpr size_t SHA1_SIZE = 20;
+
+/** An incremental SHA1, so that a digest can be built out of many
+    buffers (e.g. all the baskets of a branch) without concatenating them.
+    It uses CommonCrypto on macosx and OpenSSL everywhere else.
+  */
+struct SHA1Hasher {
+  SHA1Hasher()
+  {
+#if __APPLE__
+    CC_SHA1_Init(&ctx);
+#else
+    ctx = EVP_MD_CTX_create();
+    EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+#endif
+  }
+
+  ~SHA1Hasher()
+  {
+#if !__APPLE__
+    EVP_MD_CTX_destroy(ctx);
+#endif
+  }
+
+  void update(void const *data, size_t size)
+  {
+    statsAdd(STAT_BYTES_HASHED, size);
+#if __APPLE__
+    CC_SHA1_Update(&ctx, data, size);
+#else
+    EVP_DigestUpdate(ctx, data, size);
+#endif
+  }
+
+  // Write the SHA1_SIZE bytes of the digest in @a digest.
+  void digest(unsigned char *digest)
+  {
+#if __APPLE__
+    CC_SHA1_Final(digest, &ctx);
+#else
+    unsigned int size;
+    EVP_DigestFinal_ex(ctx, digest, &size);
+#endif
+  }
+
+private:
+  SHA1Hasher(SHA1Hasher const &);
+  SHA1Hasher &operator=(SHA1Hasher const &);
+#if __APPLE__
+  CC_SHA1_CTX ctx;
+#else
+  EVP_MD_CTX  *ctx;
+#endif
+};
+
+inline void sha1(void const *data, size_t size, unsigned char *digest)
+{
+  TraceSpan span("sha1", size);
+  SHA1Hasher hasher;
+  hasher.update(data, size);
+  hasher.digest(digest);
+}
+
+inline std::string digestToHex(unsigned char const *digest, size_t size = SHA1_SIZE)
+{
+  char buffer[size*2+1];
+  for (size_t i = 0; i < size; ++i)
+    snprintf(buffer + i*2, 3, "%02x", digest[i]);
+  return std::string(buffer, size*2);
+}
+
+constexpr uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+/** A fast, non cryptographic, 64 bit hash for the many small buffers (e.g.
+    entries) for which a SHA1 each would be too expensive. The bulk of the
+    data is consumed 32 bytes at the time by 4 independent accumulators,
+    like xxHash64 does, so that their multiplications overlap.
+
+    Use it to locate differences, not to prove that there are none.
+  */
+inline uint64_t fastHash64(void const *data, size_t size, uint64_t seed = 0)
+{
+  constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+  constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+  constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+  unsigned char const *p = (unsigned char const *) data;
+  size_t i = 0;
+  uint64_t h = seed + prime3;
+  if (size >= 32)
+  {
+    uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+    for (; i + 32 <= size; i += 32)
+    {
+      uint64_t v[4];
+      memcpy(v, p + i, 32);
+      for (int l = 0; l < 4; ++l)
+        lanes[l] = rotl64(lanes[l] + v[l] * prime2, 31) * prime1;
+    }
+    h = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+    for (int l = 0; l < 4; ++l)
+      h = (h ^ (rotl64(lanes[l] * prime2, 31) * prime1)) * prime1 + prime3;
+  }
+  h += size;
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t v;
+    memcpy(&v, p + i, 8);
+    h = rotl64(h ^ (rotl64(v * prime2, 31) * prime1), 27) * prime1 + prime3;
+  }
+  for (; i < size; ++i)
+    h = rotl64(h ^ (p[i] * prime3), 11) * prime1;
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+/** Hash the @a count entries of @a payload, entry e being the bytes in
+    [ranges[e].first, ranges[e].second), in @a digests, as fastHash64 with
+    a 0 seed does.
+  */
+typedef void (*EntryHashKernel)(char const *payload, std::pair<size_t, size_t> const *ranges, size_t count,
+                                uint64_t *digests);
+
+inline void hashEntriesScalar(char const *payload, std::pair<size_t, size_t> const *ranges, size_t count,
+                              uint64_t *digests)
+{
+  for (size_t e = 0; e < count; ++e)
+    digests[e] = fastHash64(payload + ranges[e].first, ranges[e].second - ranges[e].first);
+}
+
+#if __HAVE_X86_SIMD__
+/** The same, 8 entries at the time, one per 64 bits lane: AVX-512DQ
+    multiplies 64 bits lanes, which AVX2 can only emulate with 3 32 bits
+    multiplies, too slow to beat the scalar loop. Each lane goes through the
+    steps of fastHash64 for its own entry, the lanes whose entry is done
+    keeping their value while the longer entries finish. The words are
+    gathered at the offset each lane has reached, and the last bytes taken
+    from the 8 bytes ending the entry, which stay in the payload unless the
+    entry ends in its first 8 bytes: such groups go through the scalar loop.
+  */
+__attribute__((target("avx512f,avx512dq")))
+inline void hashEntriesAVX512(char const *payload, std::pair<size_t, size_t> const *ranges, size_t count,
+                              uint64_t *digests)
+{
+  __m512i const prime1 = _mm512_set1_epi64(0x9E3779B185EBCA87ULL);
+  __m512i const prime2 = _mm512_set1_epi64(0xC2B2AE3D27D4EB4FULL);
+  __m512i const prime3 = _mm512_set1_epi64(0x165667B19E3779F9ULL);
+  __m512i const eight = _mm512_set1_epi64(8);
+  __m512i const firsts = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+  __m512i const seconds = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+  size_t e = 0;
+  for (; e + 8 <= count; e += 8)
+  {
+    __m512i r0 = _mm512_loadu_si512(ranges + e);
+    __m512i r1 = _mm512_loadu_si512(ranges + e + 4);
+    __m512i pos = _mm512_permutex2var_epi64(r0, firsts, r1);
+    __m512i end = _mm512_permutex2var_epi64(r0, seconds, r1);
+    __m512i sizes = _mm512_sub_epi64(end, pos);
+    __m512i stripes = _mm512_srli_epi64(sizes, 5);
+    __m512i words = _mm512_and_si512(_mm512_srli_epi64(sizes, 3), _mm512_set1_epi64(3));
+    __m512i bytes = _mm512_and_si512(sizes, _mm512_set1_epi64(7));
+    __mmask8 tail = _mm512_test_epi64_mask(bytes, bytes);
+    if (_mm512_mask_cmplt_epu64_mask(tail, end, eight))
+    {
+      hashEntriesScalar(payload, ranges + e, 8, digests + e);
+      continue;
+    }
+
+    __m512i lanes[4] = {_mm512_add_epi64(prime1, prime2), prime2, _mm512_setzero_si512(),
+                        _mm512_sub_epi64(_mm512_setzero_si512(), prime1)};
+    uint64_t maxStripes = _mm512_reduce_max_epu64(stripes);
+    for (uint64_t s = 0; s < maxStripes; ++s)
+    {
+      __mmask8 active = _mm512_cmpgt_epu64_mask(stripes, _mm512_set1_epi64(s));
+      for (int k = 0; k < 4; ++k)
+      {
+        __m512i v = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), active, pos, payload, 1);
+        __m512i next = _mm512_mullo_epi64(
+            _mm512_rol_epi64(_mm512_add_epi64(lanes[k], _mm512_mullo_epi64(v, prime2)), 31), prime1);
+        lanes[k] = _mm512_mask_mov_epi64(lanes[k], active, next);
+        pos = _mm512_mask_add_epi64(pos, active, pos, eight);
+      }
+    }
+    __m512i h = _mm512_add_epi64(_mm512_add_epi64(_mm512_rol_epi64(lanes[0], 1), _mm512_rol_epi64(lanes[1], 7)),
+                                 _mm512_add_epi64(_mm512_rol_epi64(lanes[2], 12), _mm512_rol_epi64(lanes[3], 18)));
+    for (int k = 0; k < 4; ++k)
+    {
+      __m512i merged = _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(lanes[k], prime2), 31), prime1);
+      h = _mm512_add_epi64(_mm512_mullo_epi64(_mm512_xor_si512(h, merged), prime1), prime3);
+    }
+    h = _mm512_mask_mov_epi64(prime3, _mm512_test_epi64_mask(stripes, stripes), h);
+    h = _mm512_add_epi64(h, sizes);
+
+    for (uint64_t w = 0; w < 3; ++w)
+    {
+      __mmask8 active = _mm512_cmpgt_epu64_mask(words, _mm512_set1_epi64(w));
+      if (!active)
+        break;
+      __m512i v = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), active, pos, payload, 1);
+      v = _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(v, prime2), 31), prime1);
+      __m512i next = _mm512_add_epi64(_mm512_mullo_epi64(_mm512_rol_epi64(_mm512_xor_si512(h, v), 27), prime1),
+                                      prime3);
+      h = _mm512_mask_mov_epi64(h, active, next);
+      pos = _mm512_mask_add_epi64(pos, active, pos, eight);
+    }
+
+    if (tail)
+    {
+      // The last bytes are the high ones of the 8 bytes ending the entry.
+      __m512i last = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), tail, _mm512_sub_epi64(end, eight),
+                                                 payload, 1);
+      last = _mm512_srlv_epi64(last, _mm512_slli_epi64(_mm512_sub_epi64(eight, bytes), 3));
+      for (uint64_t b = 0; b < 7; ++b)
+      {
+        __mmask8 active = _mm512_cmpgt_epu64_mask(bytes, _mm512_set1_epi64(b));
+        if (!active)
+          break;
+        __m512i v = _mm512_mullo_epi64(_mm512_and_si512(last, _mm512_set1_epi64(0xff)), prime3);
+        __m512i next = _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_xor_si512(h, v), 11), prime1);
+        h = _mm512_mask_mov_epi64(h, active, next);
+        last = _mm512_srli_epi64(last, 8);
+      }
+    }
+    h = _mm512_mullo_epi64(_mm512_xor_si512(h, _mm512_srli_epi64(h, 33)), prime2);
+    h = _mm512_mullo_epi64(_mm512_xor_si512(h, _mm512_srli_epi64(h, 29)), prime3);
+    h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 32));
+    _mm512_storeu_si512(digests + e, h);
+  }
+  hashEntriesScalar(payload, ranges + e, count - e, digests + e);
+}
+#endif
+
+inline EntryHashKernel entryHashKernel(SimdLevel level)
+{
+#if __HAVE_X86_SIMD__
+  if (level == SIMD_AVX512 && __builtin_cpu_supports("avx512dq"))
+    return hashEntriesAVX512;
+#endif
+  return hashEntriesScalar;
+}
+
+// A list of (name, digest) pairs, in the order they should be reported.
+typedef std::vector<std::pair<std::string, std::string> > DigestList;
+
+/** Read back a listing of digests, as printed by one of the listing commands,
+    so that it can be used as reference for a comparison.
+
+    Only the lines of the form "<prefix><name>: <digest>" are considered.
+
+    @return false if @a filename could not be opened.
+  */
+inline bool loadDigests(char const *filename, char const *prefix,
+                 std::map<std::string, std::string> &digests)
+{
+  FILE *f = fopen(filename, "r");
+  if (!f)
+    return false;
+  size_t prefixSize = strlen(prefix);
+  char line[4096];
+  while (fgets(line, sizeof(line), f))
+  {
+    if (strncmp(line, prefix, prefixSize) != 0)
+      continue;
+    char *separator = strrchr(line, ':');
+    if (!separator)
+      continue;
+    char *digest = separator + 1;
+    while (*digest == ' ')
+      ++digest;
+    size_t digestSize = strcspn(digest, " \n");
+    digests[std::string(line + prefixSize, separator - line - prefixSize)] = std::string(digest, digestSize);
+  }
+  fclose(f);
+  return true;
+}
+
+/** Same as above, for a listing of 64 bit digests of the entries of each
+    branch, whose names are "<branch>:<entry>". Entries must be listed in
+    order, from 0, as listentryhashes prints them, so that no line can make
+    a branch hold more entries than the listing has lines. Other lines of
+    the prefix, e.g. entries out of range, are counted in @a rejected.
+  */
+inline bool loadEntryDigests(char const *filename, char const *prefix,
+                      std::map<std::string, std::vector<uint64_t> > &branches, size_t &rejected)
+{
+  rejected = 0;
+  FILE *f = fopen(filename, "r");
+  if (!f)
+    return false;
+  size_t prefixSize = strlen(prefix);
+  char line[4096];
+  while (fgets(line, sizeof(line), f))
+  {
+    if (strncmp(line, prefix, prefixSize) != 0)
+      continue;
+    char *separator = strrchr(line, ':');
+    char *entrySeparator = 0;
+    if (separator)
+    {
+      *separator = 0;
+      entrySeparator = strrchr(line + prefixSize, ':');
+    }
+    char *end = 0;
+    unsigned long long entry = entrySeparator ? strtoull(entrySeparator + 1, &end, 10) : 0;
+    bool valid = end && end != entrySeparator + 1 && !*end;
+    uint64_t digest = valid ? strtoull(separator + 1, &end, 16) : 0;
+    valid = valid && end != separator + 1 && (!*end || *end == '\n');
+    std::string branch = valid ? std::string(line + prefixSize, entrySeparator) : std::string();
+    std::map<std::string, std::vector<uint64_t> >::iterator b = branches.find(branch);
+    if (!valid || entry != (b == branches.end() ? 0 : b->second.size()))
+    {
+      ++rejected;
+      continue;
+    }
+    branches[branch].push_back(digest);
+  }
+  fclose(f);
+  return true;
+}
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef __HISTOGRAM_HELPERS_H
+#define __HISTOGRAM_HELPERS_H
+#include "BrutHeaders.h"
+#include "ROOTSchema.h"
+#include "BasketHelpers.h"
+#include "ByteSwapHelpers.h"
+#include <stdint.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+// The TH1 members following its bases and axes, up to fContour.
+constexpr FieldSpec TH1StatsSpec[] = {
+  {fixed_size(2), "fBarOffset", true, METADATA, SCALAR},
+  {fixed_size(2), "fBarWidth", true, METADATA, SCALAR},
+  {fixed_size(8), "fEntries", true, DATA, HEX},
+  {fixed_size(8), "fTsumw", true, DATA, HEX},
+  {fixed_size(8), "fTsumw2", true, DATA, HEX},
+  {fixed_size(8), "fTsumwx", true, DATA, HEX},
+  {fixed_size(8), "fTsumwx2", true, DATA, HEX},
+  {fixed_size(8), "fMaximum", true, DATA, HEX},
+  {fixed_size(8), "fMinimum", true, DATA, HEX},
+  {fixed_size(8), "fNormFactor", true, DATA, HEX},
+  LAST_FIELD
+};
+
+/** The parts of a TH1, TH2, TH3 or TProfile we compare.
+
+    - @a valueSize    the size of the bin contents on disk, 4 for floats,
+                      whose ULPs are counted as floats.
+    - @a contents     the bin contents, including under and overflows.
+    - @a sumw2        the sum of the squares of the weights, if any.
+    - @a binEntries   the entries of each bin, for profiles.
+  */
+struct Histogram {
+  std::string         className;
+  int                 ncells;
+  size_t              valueSize;
+  bool                floating;
+  double              entries;
+  double              stats[4];
+  std::vector<double> contents;
+  std::vector<double> sumw2;
+  std::vector<double> binEntries;
+};
+
+// The classes we know how to decode, as "TH<dimension><type>" or
+// "TProfile[2D|3D]".
+inline bool isHistogramClass(std::string const &className)
+{
+  if (className == "TProfile" || className == "TProfile2D" || className == "TProfile3D")
+    return true;
+  return className.size() == 4 && className.compare(0, 2, "TH") == 0
+         && className[2] >= '1' && className[2] <= '3'
+         && strchr("CSIFD", className[3]);
+}
+
+/** Skip the object with a byte count and version at @a p.
+    @return the position after it.
+  */
+inline char const *skipVersioned(char const *p, char const *end)
+{
+  if (end - p < 6)
+    throw "Truncated histogram";
+  unsigned int byteCount = getInt(TVersionSpec, p, "size");
+  if (!(byteCount & 0x40000000))
+    throw "Histogram without byte count";
+  char const *next = p + 4 + (byteCount & ~0x40000000);
+  if (next > end)
+    throw "Truncated histogram";
+  return next;
+}
+
+// Decode the TArray of @a Type at @a p, laid out as @a spec, in @a values.
+// @return the position after it.
+template <class Type>
+char const *decodeTArray(FieldSpec const *spec, char const *p, char const *end, std::vector<double> &values)
+{
+  if (end - p < 4)
+    throw "Truncated histogram";
+  size_t n = getArraySize(spec, p, "");
+  if (n > (size_t)(end - p - 4) / sizeof(Type))
+    throw "Truncated histogram";
+  std::vector<Type> decoded(n);
+  if (n)
+    getArray(spec, p, "", &decoded[0], n);
+  values.assign(decoded.begin(), decoded.end());
+  return next(spec, p);
+}
+
+inline char const *decodeTArray(char type, char const *p, char const *end, std::vector<double> &values)
+{
+  switch (type)
+  {
+    case 'C': return decodeTArray<signed char>(ArrayCSpec, p, end, values);
+    case 'S': return decodeTArray<int16_t>(ArraySSpec, p, end, values);
+    case 'I': return decodeTArray<int32_t>(ArrayISpec, p, end, values);
+    case 'F': return decodeTArray<float>(ArrayFSpec, p, end, values);
+    default:  return decodeTArray<double>(ArrayDSpec, p, end, values);
+  }
+}
+
+/** Decode the TH1 part, with its byte count and version, at @a p.
+    @return the position after it.
+  */
+inline char const *decodeTH1(char const *p, char const *end, Histogram &histogram)
+{
+  char const *th1End = skipVersioned(p, end);
+  p += 6;
+  p = skipVersioned(p, th1End);   // TNamed
+  p = skipVersioned(p, th1End);   // TAttLine
+  p = skipVersioned(p, th1End);   // TAttFill
+  p = skipVersioned(p, th1End);   // TAttMarker
+  if (th1End - p < 4)
+    throw "Truncated histogram";
+  histogram.ncells = getInt(ArrayISpec, p, "size");
+  p += 4;
+  for (int axis = 0; axis < 3; ++axis)
+    p = skipVersioned(p, th1End);
+  if (th1End - p < specRealSize(TH1StatsSpec, p))
+    throw "Truncated histogram";
+  decodeBigEndian(getString(TH1StatsSpec, p, "fEntries"), 1, &histogram.entries);
+  decodeBigEndian(getString(TH1StatsSpec, p, "fTsumw"), 4, histogram.stats);
+  p += specRealSize(TH1StatsSpec, p);
+  std::vector<double> contour;
+  p = decodeTArray('D', p, th1End, contour);
+  decodeTArray('D', p, th1End, histogram.sumw2);
+  return th1End;
+}
+
+/** Decode the streamed histogram of class @a className in @a buffer.
+    Throws in case the buffer is not what we expect.
+  */
+inline void decodeHistogram(std::string const &className, char const *buffer, size_t size, Histogram &histogram)
+{
+  char const *end = buffer + size;
+  histogram.className = className;
+  histogram.binEntries.clear();
+  skipVersioned(buffer, end);
+  char const *p = buffer + 6;
+  if (className.compare(0, 8, "TProfile") == 0)
+  {
+    // A TProfile is a TH1D, followed by the entries of each bin.
+    std::string base = className == "TProfile" ? "TH1D" : std::string("TH") + className[8] + "D";
+    char const *baseEnd = skipVersioned(p, end);
+    decodeHistogram(base, p, baseEnd - p, histogram);
+    histogram.className = className;
+    decodeTArray('D', baseEnd, end, histogram.binEntries);
+    return;
+  }
+  // TH2 and TH3 add their members to those of TH1.
+  char const *th1End = className[2] == '1' ? decodeTH1(p, end, histogram)
+                                           : (decodeTH1(p + 6, end, histogram), skipVersioned(p, end));
+  char type = className[3];
+  histogram.valueSize = type == 'C' ? 1 : type == 'S' ? 2 : type == 'D' ? 8 : 4;
+  histogram.floating = type == 'F' || type == 'D';
+  decodeTArray(type, th1End, end, histogram.contents);
+}
+
+/** How far apart two values can be to be considered the same: either within
+    @a absolute of each other, or within @a relative of the largest, or at most
+    @a ulps representable values apart.
+  */
+struct Tolerance {
+  double    absolute;
+  double    relative;
+  uint64_t  ulps;
+};
+
+// The distance, in units in the last place, of two values, as floats if
+// @a single is true.
+inline uint64_t ulpDistance(double a, double b, bool single)
+{
+  if (a != a || b != b)
+    return UINT64_MAX;
+  if (single)
+  {
+    float fa = a, fb = b;
+    uint32_t ua, ub;
+    memcpy(&ua, &fa, 4);
+    memcpy(&ub, &fb, 4);
+    ua = ua & 0x80000000u ? ~ua : ua | 0x80000000u;
+    ub = ub & 0x80000000u ? ~ub : ub | 0x80000000u;
+    return ua > ub ? ua - ub : ub - ua;
+  }
+  uint64_t ua, ub;
+  memcpy(&ua, &a, 8);
+  memcpy(&ub, &b, 8);
+  ua = ua & 0x8000000000000000ull ? ~ua : ua | 0x8000000000000000ull;
+  ub = ub & 0x8000000000000000ull ? ~ub : ub | 0x8000000000000000ull;
+  return ua > ub ? ua - ub : ub - ua;
+}
+
+inline bool withinTolerance(double a, double b, Tolerance const &tolerance, bool single)
+{
+  if (a == b || (a != a && b != b))
+    return true;
+  double d = std::fabs(a - b);
+  if (d < HUGE_VAL && (d <= tolerance.absolute || d <= tolerance.relative * std::max(std::fabs(a), std::fabs(b))))
+    return true;
+  return ulpDistance(a, b, single) <= tolerance.ulps;
+}
+
+// Kernel returning how many of the @a n values of @a a and @a b are not
+// within @a tolerance, and the index of the first one in @a first.
+typedef size_t (*CompareKernel)(double const *a, double const *b, size_t n,
+                                Tolerance const &tolerance, bool single, size_t &first);
+
+inline size_t countDifferencesScalar(double const *a, double const *b, size_t n,
+                              Tolerance const &tolerance, bool single, size_t &first)
+{
+  size_t differ = 0;
+  first = n;
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (withinTolerance(a[i], b[i], tolerance, single))
+      continue;
+    if (!differ++)
+      first = i;
+  }
+  return differ;
+}
+
+#if __HAVE_X86_SIMD__
+// Same as above, checking 4 bins at the time for equality and absolute and
+// relative tolerance. Only bins failing those go through the ULP check.
+__attribute__((target("avx2")))
+inline size_t countDifferencesAVX2(double const *a, double const *b, size_t n,
+                            Tolerance const &tolerance, bool single, size_t &first)
+{
+  __m256d const absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+  __m256d const absolute = _mm256_set1_pd(tolerance.absolute);
+  __m256d const relative = _mm256_set1_pd(tolerance.relative);
+  __m256d const infinity = _mm256_set1_pd(HUGE_VAL);
+  size_t differ = 0;
+  first = n;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256d va = _mm256_loadu_pd(a + i);
+    __m256d vb = _mm256_loadu_pd(b + i);
+    __m256d d = _mm256_and_pd(_mm256_sub_pd(va, vb), absMask);
+    __m256d largest = _mm256_max_pd(_mm256_and_pd(va, absMask), _mm256_and_pd(vb, absMask));
+    __m256d close = _mm256_or_pd(_mm256_cmp_pd(d, absolute, _CMP_LE_OQ),
+                                 _mm256_cmp_pd(d, _mm256_mul_pd(relative, largest), _CMP_LE_OQ));
+    close = _mm256_and_pd(close, _mm256_cmp_pd(d, infinity, _CMP_LT_OQ));
+    close = _mm256_or_pd(close, _mm256_cmp_pd(va, vb, _CMP_EQ_OQ));
+    int suspects = ~_mm256_movemask_pd(close) & 0xf;
+    while (suspects)
+    {
+      int lane = __builtin_ctz(suspects);
+      suspects &= suspects - 1;
+      if (withinTolerance(a[i + lane], b[i + lane], tolerance, single))
+        continue;
+      if (!differ++)
+        first = i + lane;
+    }
+  }
+  size_t tailFirst;
+  size_t tail = countDifferencesScalar(a + i, b + i, n - i, tolerance, single, tailFirst);
+  if (tail && !differ)
+    first = i + tailFirst;
+  return differ + tail;
+}
+#endif
+
+inline CompareKernel compareKernel(SimdLevel level)
+{
+#if __HAVE_X86_SIMD__
+  if (level == SIMD_AVX2 || level == SIMD_AVX512)
+    return countDifferencesAVX2;
+#endif
+  return countDifferencesScalar;
+}
+
+inline size_t countDifferences(double const *a, double const *b, size_t n,
+                        Tolerance const &tolerance, bool single, size_t &first)
+{
+  static CompareKernel const kernel = compareKernel(bestSimdLevel());
+  return kernel(a, b, n, tolerance, single, first);
+}
+
+/** Compare @a histogram with @a reference, bin by bin, then their number
+    of entries and statistics sums.
+    @return an empty string if they are the same within @a tolerance, or
+    what differs otherwise.
+  */
+inline std::string compareHistograms(Histogram const &histogram, Histogram const &reference, Tolerance const &tolerance)
+{
+  char buffer[256];
+  if (histogram.className != reference.className)
+  {
+    snprintf(buffer, sizeof(buffer), "class %s vs %s", histogram.className.c_str(), reference.className.c_str());
+    return buffer;
+  }
+  struct {
+    char const                *label;
+    std::vector<double> const *values;
+    std::vector<double> const *referenceValues;
+  } arrays[] = {
+    {"bins", &histogram.contents, &reference.contents},
+    {"sumw2", &histogram.sumw2, &reference.sumw2},
+    {"bin entries", &histogram.binEntries, &reference.binEntries}
+  };
+  bool single = histogram.valueSize == 4 && histogram.floating;
+  std::string result;
+  for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i)
+  {
+    std::vector<double> const &values = *arrays[i].values;
+    std::vector<double> const &referenceValues = *arrays[i].referenceValues;
+    if (values.size() != referenceValues.size())
+    {
+      snprintf(buffer, sizeof(buffer), "%s%lu %s vs %lu", result.empty() ? "" : ", ",
+               values.size(), arrays[i].label, referenceValues.size());
+      result += buffer;
+      continue;
+    }
+    size_t first;
+    size_t differ = values.empty() ? 0 : countDifferences(&values[0], &referenceValues[0], values.size(),
+                                                          tolerance, single && i == 0, first);
+    if (!differ)
+      continue;
+    snprintf(buffer, sizeof(buffer), "%s%lu of %lu %s differ, first %lu: %.17g vs %.17g", result.empty() ? "" : ", ",
+             differ, values.size(), arrays[i].label, first, values[first], referenceValues[first]);
+    result += buffer;
+  }
+  if (!withinTolerance(histogram.entries, reference.entries, tolerance, false))
+  {
+    snprintf(buffer, sizeof(buffer), "%sentries %.17g vs %.17g", result.empty() ? "" : ", ",
+             histogram.entries, reference.entries);
+    result += buffer;
+  }
+  char const *statsNames[] = {"fTsumw", "fTsumw2", "fTsumwx", "fTsumwx2"};
+  for (int i = 0; i < 4; ++i)
+  {
+    if (withinTolerance(histogram.stats[i], reference.stats[i], tolerance, false))
+      continue;
+    snprintf(buffer, sizeof(buffer), "%s%s %.17g vs %.17g", result.empty() ? "" : ", ",
+             statsNames[i], histogram.stats[i], reference.stats[i]);
+    result += buffer;
+  }
+  return result;
+}
+
+/** The histograms of a file, by path. Only the highest cycle of each
+    histogram is kept.
+  */
+inline void findHistograms(std::vector<KeyInfo> const &keys, std::map<std::string, KeyInfo> &histograms)
+{
+  histograms.clear();
+  std::vector<std::string> directories;
+  keyDirectories(keys, directories);
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    if (!isHistogramClass(keys[i].className))
+      continue;
+    std::string path = directories[i].empty() ? keys[i].name : directories[i] + "/" + keys[i].name;
+    std::map<std::string, KeyInfo>::iterator h = histograms.find(path);
+    if (h == histograms.end() || h->second.cycle < keys[i].cycle)
+      histograms[path] = keys[i];
+  }
+}
+
+#endif
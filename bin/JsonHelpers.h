@@ -0,0 +1,27 @@
+#ifndef __JSON_HELPERS_H
+#define __JSON_HELPERS_H
+#include <cstdio>
+#include <string>
+
+// @a value as the contents of a JSON string, i.e. escaped but not quoted.
+inline std::string jsonString(std::string const &value)
+{
+  std::string result;
+  for (size_t i = 0; i < value.size(); ++i)
+  {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\')
+      result += '\\';
+    if (c >= 0x20)
+    {
+      result += c;
+      continue;
+    }
+    char escaped[8];
+    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+    result += escaped;
+  }
+  return result;
+}
+
+#endif
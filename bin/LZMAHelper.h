@@ -1,29 +1,29 @@
 #ifndef __LZMA_HELPER_H
 #define __LZMA_HELPER_H
 #include "lzma.h"
-#include <cstdio>
+#include "StatsHelpers.h"
 
-int
+/* Decompress the sourceLen bytes of source, including the 9 bytes ROOT
+   header, into the outputLen bytes of output. Returns LZMA_STREAM_END on
+   success, or the lzma_ret of the failure, for the caller to report.
+ */
+inline int
 uncompressLZMA(unsigned char *output, size_t outputLen, unsigned char *source, size_t sourceLen)
 {
+  TraceSpan span("lzma", sourceLen);
   lzma_stream stream = LZMA_STREAM_INIT;
   lzma_ret ret = lzma_stream_decoder(&stream, UINT64_MAX, 0U);
-  if (ret != LZMA_OK) {
-    printf("Error initializing LZMA (%u)\n", ret);
+  if (ret != LZMA_OK)
     return ret;
-  }
 
   stream.next_in   = source+9;
-  stream.avail_in  = sourceLen;
+  stream.avail_in  = sourceLen-9;
   stream.next_out  = output;
   stream.avail_out = outputLen;
 
   ret = lzma_code(&stream, LZMA_FINISH);
-  if (ret != LZMA_STREAM_END) {
-    printf("Error while deconding (%u).\n",ret);
-    lzma_end(&stream);
-    return ret;
-  }
+  statsAdd(STAT_LZMA_INPUT, stream.total_in);
+  statsAdd(STAT_LZMA_OUTPUT, stream.total_out);
   lzma_end(&stream);
   return ret;
 }
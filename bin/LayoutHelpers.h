@@ -0,0 +1,147 @@
+#ifndef __LAYOUT_HELPERS_H
+#define __LAYOUT_HELPERS_H
+#include "BrutHeaders.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** Where a field of a FieldSpec is found in a given buffer.
+
+    - @a name   the path of the field, e.g. "ClassName.value".
+    - @a spec   its spec.
+    - @a offset its position, from the beginning of the buffer.
+    - @a size   its size in that buffer.
+  */
+struct FieldLayout {
+  std::string     name;
+  FieldSpec const *spec;
+  size_t          offset;
+  size_t          size;
+};
+
+// Whether the field @a specOff of @a specs is absent from @a buf because of
+// its condition.
+inline bool fieldSkipped(FieldSpec const *specs, size_t specOff, char const *buf)
+{
+  FieldInfo const &info = specs[specOff].info;
+  if (!info.conditionalField)
+    return false;
+  int64_t value = 0;
+  switch (info.conditionalType)
+  {
+    case CHAR:
+      value = getCharOffset(specs, buf, 0, 0, info.conditionalField);
+      break;
+    case SHORT:
+      value = getShortOffset(specs, buf, 0, 0, info.conditionalField);
+      break;
+    case INT:
+      value = getIntOffset(specs, buf, 0, 0, info.conditionalField);
+      break;
+    case INT64:
+      value = getInt64Offset(specs, buf, 0, 0, info.conditionalField);
+      break;
+    default:
+      return false;
+  }
+  return value < info.conditionalBeginRange || value > info.conditionalEndRange;
+}
+
+/** Append to @a fields the layout of @a specs in @a buf, which is @a size
+    bytes long, with conditional fields resolved and embedded structures
+    flattened. Fields are laid out as specRealSize does. Stops at the first
+    field which does not fit in @a size.
+
+    @return the number of bytes used by @a specs in @a buf.
+  */
+inline size_t specLayout(FieldSpec const *specs, char const *buf, size_t size,
+                  std::vector<FieldLayout> &fields, std::string const &prefix = std::string(),
+                  size_t base = 0)
+{
+  size_t offset = 0;
+  for (size_t specOff = 0; !is_null(specs[specOff].info); ++specOff)
+  {
+    if (offset >= size)
+      break;
+    if (fieldSkipped(specs, specOff, buf))
+      continue;
+    FieldSpec const &spec = specs[specOff];
+    std::string name = prefix + spec.name;
+    if (spec.info.ref)
+    {
+      offset += specLayout(spec.info.ref, buf + offset, size - offset, fields, name + ".", base + offset);
+      continue;
+    }
+    size_t fieldSize = spec.info.delimited || size_offset(spec.info) ? getSize(spec.info, buf + offset)
+                                                                      : spec.info.size;
+    if (offset + fieldSize > size)
+      break;
+    FieldLayout field = {name, &spec, base + offset, fieldSize};
+    fields.push_back(field);
+    offset += fieldSize;
+  }
+  return offset;
+}
+
+/** The value of the integer @a field in @a buf, or 0 if there is no such
+    field in @a fields.
+  */
+inline uint64_t fieldValue(std::vector<FieldLayout> const &fields, char const *buf, char const *name)
+{
+  for (size_t i = 0; i < fields.size(); ++i)
+  {
+    FieldLayout const &field = fields[i];
+    if (field.name != name || field.size > 8)
+      continue;
+    uint64_t value = 0;
+    for (size_t b = 0; b < field.size; ++b)
+    {
+      unsigned char byte = buf[field.offset + (field.spec->bigEndian ? b : field.size - 1 - b)];
+      value = (value << 8) | byte;
+    }
+    return value;
+  }
+  return 0;
+}
+
+/** The value of @a field in @a buf, which the layout was computed for,
+    formatted as printBuf would: integers for scalars, quoted strings,
+    dates, and hex bytes for the rest.
+  */
+inline std::string formatField(FieldLayout const &field, char const *buf)
+{
+  char const *data = buf + field.offset;
+  char result[128];
+  FieldSpec const &spec = *field.spec;
+  if (spec.parseType == SCALAR && field.size == 1)
+    snprintf(result, sizeof(result), "%i", (int) *data);
+  else if (spec.parseType == SCALAR && field.size == 2)
+    snprintf(result, sizeof(result), "%i", (short) (spec.bigEndian ? bswap_16(*(unsigned short *) data) : *(unsigned short *) data));
+  else if (spec.parseType == SCALAR && field.size == 4)
+    snprintf(result, sizeof(result), "%i", (int) (spec.bigEndian ? bswap_32(*(unsigned int *) data) : *(unsigned int *) data));
+  else if (spec.parseType == SCALAR && field.size == 8)
+    snprintf(result, sizeof(result), "%llu", spec.bigEndian ? bswap_64(*(unsigned long long *) data) : *(unsigned long long *) data);
+  else if (spec.parseType == STRING)
+    snprintf(result, sizeof(result), "\"%.*s\"", (int) std::min(field.size, (size_t) 64), data);
+  else if (spec.parseType == DATETIME && field.size == 4)
+  {
+    int datetime = bswap_32(*(int *) data);
+    snprintf(result, sizeof(result), "%i/%i/%i %02i:%02i:%02i",
+             (datetime >> 26) + 1995, abs((datetime << 6) >> 28), abs((datetime << 10) >> 27),
+             abs((datetime << 15) >> 27), abs((datetime << 20) >> 26), abs(datetime << 26) >> 26);
+  }
+  else
+  {
+    size_t shown = std::min(field.size, (size_t) 32);
+    for (size_t i = 0; i < shown; ++i)
+      snprintf(result + 2 * i, 3, "%02x", ((int) data[i]) & 0xff);
+    if (shown < field.size)
+      strcpy(result + 2 * shown, "...");
+  }
+  return result;
+}
+
+#endif
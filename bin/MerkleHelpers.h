@@ -0,0 +1,168 @@
+#ifndef __MERKLE_HELPERS_H
+#define __MERKLE_HELPERS_H
+#include "BasketHelpers.h"
+#include "HashHelpers.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+/** A Merkle tree over the objects of a file, so that two files can be
+    compared top down, descending only in the subtrees which differ.
+
+    Nodes are named by the path of their components from the root, joined
+    by merkleSeparator:
+
+        file|<directory>|<class>|<object>|<leaf>
+
+    where <directory> is "/" followed by the directory path, <object> is the
+    object name, or "tree/branch" for baskets, and <leaf> is the cycle of the
+    object, or the index of the basket in the branch. Leaves are the SHA1 of
+    the uncompressed objects, the other nodes the SHA1 of the names and
+    digests of their children.
+  */
+constexpr char merkleSeparator = '|';
+constexpr char merkleRoot[] = "file";
+constexpr char merklePrefix[] = "Merkle ";
+
+// Keys whose objects change whenever a file is written again (dates,
+// positions, free segments), and which are not part of the tree.
+inline bool merkleIgnored(KeyInfo const &key)
+{
+  return key.className == "TFile" || key.className == "TDirectory" || key.className == "TDirectoryFile";
+}
+
+struct MerkleTree {
+  std::map<std::string, std::string>            digests;
+  std::map<std::string, std::set<std::string> > children;
+
+  // Add the leaf @a name, with its @a digest, and all its parents.
+  void addLeaf(std::string const &name, std::string const &digest)
+  {
+    digests[name] = digest;
+    addNode(name);
+  }
+
+  void addNode(std::string const &name)
+  {
+    for (std::string node = name; node != merkleRoot;)
+    {
+      std::string parent = node.substr(0, node.rfind(merkleSeparator));
+      if (!children[parent].insert(node).second)
+        break;
+      node = parent;
+    }
+  }
+
+  // Compute the digests of all the inner nodes, from the leaves up.
+  std::string const &update(std::string const &node = merkleRoot)
+  {
+    std::map<std::string, std::set<std::string> >::const_iterator c = children.find(node);
+    if (c == children.end() && node != merkleRoot)
+      return digests[node];
+    SHA1Hasher hasher;
+    if (c != children.end())
+      for (std::set<std::string>::const_iterator i = c->second.begin(); i != c->second.end(); ++i)
+      {
+        std::string const &digest = update(*i);
+        hasher.update(i->c_str(), i->size() + 1);
+        hasher.update(digest.data(), digest.size());
+      }
+    unsigned char digest[SHA1_SIZE];
+    hasher.digest(digest);
+    return digests[node] = digestToHex(digest);
+  }
+
+  // Print the tree, parents first, so that the root is the first line.
+  void print(std::string const &node = merkleRoot, FILE *out = stdout) const
+  {
+    std::map<std::string, std::string>::const_iterator d = digests.find(node);
+    if (d == digests.end())
+      return;
+    fprintf(out, "%s%s: %s\n", merklePrefix, node.c_str(), d->second.c_str());
+    std::map<std::string, std::set<std::string> >::const_iterator c = children.find(node);
+    if (c == children.end())
+      return;
+    for (std::set<std::string>::const_iterator i = c->second.begin(); i != c->second.end(); ++i)
+      print(*i, out);
+  }
+};
+
+/** The name of the leaf for @a key, in directory @a directory. @a index is
+    the index of the basket in its branch, for baskets.
+  */
+inline std::string merkleLeaf(KeyInfo const &key, std::string const &directory, size_t index)
+{
+  char leaf[32];
+  bool basket = key.className == "TBasket";
+  snprintf(leaf, sizeof(leaf), basket ? "%08lu" : "%lu", basket ? index : (unsigned long) key.cycle);
+  std::string object = basket ? key.title + "/" + key.name : key.name;
+  return std::string(merkleRoot) + merkleSeparator + "/" + directory + merkleSeparator
+         + key.className + merkleSeparator + object + merkleSeparator + leaf;
+}
+
+/** Read only the root digest of the listing @a filename, which is printed
+    first. @return false if it could not be found.
+  */
+inline bool loadMerkleRoot(char const *filename, std::string &digest)
+{
+  FILE *f = fopen(filename, "r");
+  if (!f)
+    return false;
+  std::string prefix = std::string(merklePrefix) + merkleRoot + ": ";
+  char line[4096];
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), f))
+  {
+    if (strncmp(line, prefix.c_str(), prefix.size()) != 0)
+      continue;
+    digest = std::string(line + prefix.size(), strcspn(line + prefix.size(), " \n"));
+    found = true;
+  }
+  fclose(f);
+  return found;
+}
+
+/** Compare the subtree @a node of @a tree with the one of @a reference,
+    descending only in the children whose digests differ, and report the
+    leaves which differ and the subtrees found only on one side.
+
+    @a visited counts the nodes looked at, @a differ the differences found.
+  */
+inline void compareMerkle(MerkleTree const &tree, MerkleTree const &reference, char const *referenceName,
+                   std::string const &node, size_t &visited, size_t &differ, FILE *out = stdout)
+{
+  ++visited;
+  std::map<std::string, std::string>::const_iterator mine = tree.digests.find(node);
+  std::map<std::string, std::string>::const_iterator theirs = reference.digests.find(node);
+  if (mine->second == theirs->second)
+    return;
+  std::map<std::string, std::set<std::string> >::const_iterator c = tree.children.find(node);
+  std::map<std::string, std::set<std::string> >::const_iterator r = reference.children.find(node);
+  if (c == tree.children.end() || r == reference.children.end())
+  {
+    fprintf(out, "merkle node %s differs\n", node.c_str());
+    ++differ;
+    return;
+  }
+  for (std::set<std::string>::const_iterator i = c->second.begin(); i != c->second.end(); ++i)
+  {
+    if (r->second.count(*i))
+      compareMerkle(tree, reference, referenceName, *i, visited, differ, out);
+    else
+    {
+      fprintf(out, "merkle node %s only in this file\n", i->c_str());
+      ++differ;
+    }
+  }
+  for (std::set<std::string>::const_iterator i = r->second.begin(); i != r->second.end(); ++i)
+  {
+    if (c->second.count(*i))
+      continue;
+    fprintf(out, "merkle node %s only in %s\n", i->c_str(), referenceName);
+    ++differ;
+  }
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef __META_HELPERS_H
+#define __META_HELPERS_H
+#include "ByteSwapHelpers.h"
+#include "LayoutHelpers.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** Comparison of the metadata records of two files (file header,
+    directories, key headers) ignoring the MUTABLE fields of their specs,
+    i.e. those which change every time a file is written (UUIDs, dates).
+
+    All the records of both files are gathered in two contiguous buffers,
+    together with a byte mask which is 0xff for the bytes to compare and 0
+    for the MUTABLE ones, so that they are all compared in one pass, 32 or 64
+    bytes at the time.
+  */
+
+/** Set in @a mask, which is as big as the record, the bytes of the fields
+    of @a fields, except the MUTABLE ones. Bytes not covered by any field
+    are compared as well.
+  */
+inline void fieldMask(std::vector<FieldLayout> const &fields, unsigned char *mask, size_t size)
+{
+  memset(mask, 0xff, size);
+  for (size_t i = 0; i < fields.size(); ++i)
+    if (fields[i].spec->type == MUTABLE && fields[i].offset + fields[i].size <= size)
+      memset(mask + fields[i].offset, 0, fields[i].size);
+}
+
+/** Append to @a ranges the position and size of the MUTABLE fields of
+    @a fields, for a record starting at @a base.
+  */
+inline void mutableRanges(std::vector<FieldLayout> const &fields, size_t base,
+                   std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  for (size_t i = 0; i < fields.size(); ++i)
+    if (fields[i].spec->type == MUTABLE)
+      ranges.push_back(std::make_pair(base + fields[i].offset, fields[i].size));
+}
+
+// The first position in [@a from, @a size) where @a a and @a b differ in one
+// of the bits set in @a mask, or @a size if there is none.
+typedef size_t (*MaskedMismatchKernel)(char const *a, char const *b, unsigned char const *mask,
+                                       size_t from, size_t size);
+
+inline size_t maskedMismatchScalar(char const *a, char const *b, unsigned char const *mask, size_t from, size_t size)
+{
+  size_t i = from;
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t x, y, m;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    memcpy(&m, mask + i, 8);
+    if ((x ^ y) & m)
+      return i + __builtin_ctzll((x ^ y) & m) / 8;
+  }
+  for (; i < size; ++i)
+    if ((a[i] ^ b[i]) & mask[i])
+      return i;
+  return size;
+}
+
+#if __HAVE_X86_SIMD__
+__attribute__((target("avx2")))
+inline size_t maskedMismatchAVX2(char const *a, char const *b, unsigned char const *mask, size_t from, size_t size)
+{
+  size_t i = from;
+  __m256i const zero = _mm256_setzero_si256();
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i x = _mm256_xor_si256(_mm256_loadu_si256((__m256i const *)(a + i)),
+                                 _mm256_loadu_si256((__m256i const *)(b + i)));
+    __m256i d = _mm256_and_si256(x, _mm256_loadu_si256((__m256i const *)(mask + i)));
+    if (_mm256_testz_si256(d, d))
+      continue;
+    unsigned differ = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(d, zero));
+    return i + __builtin_ctz(differ);
+  }
+  return maskedMismatchScalar(a, b, mask, i, size);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline size_t maskedMismatchAVX512(char const *a, char const *b, unsigned char const *mask, size_t from, size_t size)
+{
+  size_t i = from;
+  for (; i < size; i += 64)
+  {
+    __mmask64 valid = size - i >= 64 ? ~0ULL : ~0ULL >> (64 - (size - i));
+    __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi8(valid, a + i), _mm512_maskz_loadu_epi8(valid, b + i));
+    __mmask64 differ = _mm512_test_epi8_mask(x, _mm512_maskz_loadu_epi8(valid, mask + i));
+    if (differ)
+      return i + __builtin_ctzll(differ);
+  }
+  return size;
+}
+#endif
+
+inline MaskedMismatchKernel maskedMismatchKernel(SimdLevel level)
+{
+#if __HAVE_X86_SIMD__
+  if (level == SIMD_AVX512)
+    return maskedMismatchAVX512;
+  if (level == SIMD_AVX2)
+    return maskedMismatchAVX2;
+#endif
+  return maskedMismatchScalar;
+}
+
+/** A record to compare, @a size bytes at @a offset of MetaRecords::a and b.
+    @a fields is its layout, the same in both files.
+  */
+struct MetaRecord {
+  std::string               name;
+  size_t                    offset;
+  size_t                    size;
+  std::vector<FieldLayout>  fields;
+};
+
+struct MetaRecords {
+  std::vector<char>           a;
+  std::vector<char>           b;
+  std::vector<unsigned char>  mask;
+  std::vector<MetaRecord>     records;
+
+  /** Add the record @a name, @a size bytes at @a a and @a b, laid out as
+      @a fields in both.
+    */
+  void add(std::string const &name, char const *recordA, char const *recordB, size_t size,
+           std::vector<FieldLayout> const &fields)
+  {
+    MetaRecord record = {name, a.size(), size, fields};
+    records.push_back(record);
+    a.insert(a.end(), recordA, recordA + size);
+    b.insert(b.end(), recordB, recordB + size);
+    mask.resize(a.size());
+    fieldMask(fields, &mask[record.offset], size);
+  }
+
+  /** Append to @a differ the indices of the records which differ outside
+      of their MUTABLE fields.
+    */
+  void compare(std::vector<size_t> &differ,
+               MaskedMismatchKernel kernel = maskedMismatchKernel(bestSimdLevel())) const
+  {
+    if (a.empty())
+      return;
+    size_t pos = kernel(&a[0], &b[0], &mask[0], 0, a.size());
+    size_t r = 0;
+    while (pos < a.size())
+    {
+      while (records[r].offset + records[r].size <= pos)
+        ++r;
+      differ.push_back(r);
+      pos = kernel(&a[0], &b[0], &mask[0], records[r].offset + records[r].size, a.size());
+    }
+  }
+};
+
+/** Whether @a fields and @a other describe the same layout, so that the
+    records can be compared byte by byte.
+  */
+inline bool sameLayout(std::vector<FieldLayout> const &fields, std::vector<FieldLayout> const &other)
+{
+  if (fields.size() != other.size())
+    return false;
+  for (size_t i = 0; i < fields.size(); ++i)
+    if (fields[i].name != other[i].name || fields[i].offset != other[i].offset || fields[i].size != other[i].size)
+      return false;
+  return true;
+}
+
+#endif
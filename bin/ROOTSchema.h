@@ -1,6 +1,7 @@
 #ifndef ROOT_SCHEMA_H
 #define ROOT_SCHEMA_H
 #include "BrutHeaders.h"
+#include <climits>
 
 constexpr FieldSpec TStringSpec[] {
   {fixed_size(1), "size", true, METADATA, SCALAR},
@@ -14,18 +15,23 @@ constexpr FieldSpec TVersionSpec[] {
   LAST_FIELD
 };
 
+// Files larger than 2GB have a fVersion above 1000000, and 8 bytes
+// positions.
 constexpr FieldSpec fileHeaderSpec[] {
   {fixed_size(4), "magic", true, METADATA, STRING}, 
   {fixed_size(4), "fVersion", true, METADATA, SCALAR},
   {fixed_size(4), "fBEGIN", true, METADATA, SCALAR},
-  {fixed_size(4), "fEND", true, METADATA, SCALAR},
-  {fixed_size(4), "fSeekFree", true, METADATA, SCALAR},
+  {conditional_range("fVersion", 0, 999999, fixed_size(4)), "fEND", true, METADATA, SCALAR},
+  {conditional_range("fVersion", 0, 999999, fixed_size(4)), "fSeekFree", true, METADATA, SCALAR},
+  {conditional_range("fVersion", 1000000, INT_MAX, fixed_size(8)), "fEND", true, METADATA, SCALAR},
+  {conditional_range("fVersion", 1000000, INT_MAX, fixed_size(8)), "fSeekFree", true, METADATA, SCALAR},
   {fixed_size(4), "fNbytesFree", true,METADATA, SCALAR},
   {fixed_size(4), "nfree", true, METADATA, SCALAR},
   {fixed_size(4), "fNbytesName", true, METADATA, SCALAR},
   {fixed_size(1), "fUnits", true, METADATA, SCALAR},
   {fixed_size(4), "fCompress", true, METADATA, SCALAR},
-  {fixed_size(4), "fSeekInfo", true, METADATA, SCALAR},
+  {conditional_range("fVersion", 0, 999999, fixed_size(4)), "fSeekInfo", true, METADATA, SCALAR},
+  {conditional_range("fVersion", 1000000, INT_MAX, fixed_size(8)), "fSeekInfo", true, METADATA, SCALAR},
   {fixed_size(4), "fNbytesInfo", true, METADATA, SCALAR},
   {fixed_size(18), "fUUID", true, MUTABLE, HEX},
   LAST_FIELD
@@ -48,6 +54,19 @@ constexpr FieldSpec keyHeaderSpec[] = {
   LAST_FIELD
 };
 
+// A TBasket extends the key header above with the following fields, which
+// are counted in KeyLen. For baskets the key Name is the branch name and the
+// key Title the tree name.
+constexpr FieldSpec basketHeaderSpec[] = {
+  {fixed_size(2), "Version", true, METADATA, SCALAR},
+  {fixed_size(4), "fBufferSize", true, METADATA, SCALAR},
+  {fixed_size(4), "fNevBufSize", true, METADATA, SCALAR},
+  {fixed_size(4), "fNevBuf", true, METADATA, SCALAR},
+  {fixed_size(4), "fLast", true, METADATA, SCALAR},
+  {fixed_size(1), "flag", true, METADATA, SCALAR},
+  LAST_FIELD
+};
+
 constexpr FieldSpec subDirSpec[] {
   {fixed_size(1), "fModifiable", true, MUTABLE, SCALAR},
   {fixed_size(1), "fWritable", true, MUTABLE, SCALAR},
@@ -72,7 +91,7 @@ constexpr FieldSpec topDirSpec[] = {
   {conditional_range("Version", (short) 1001, (short) (SHRT_MAX), fixed_size(8)), "fSeekDir", true, METADATA, SCALAR},
   {conditional_range("Version", (short) 1001, (short) (SHRT_MAX), fixed_size(8)), "fSeekParent", true, METADATA, SCALAR},
   {conditional_range("Version", (short) 1001, (short) (SHRT_MAX), fixed_size(8)), "fSeekKeys", true, METADATA, SCALAR},
-  {fixed_size(18), "fUUID", true, METADATA, HEX},
+  {fixed_size(18), "fUUID", true, MUTABLE, HEX},
   {conditional_range("Version", (short) 0, (short) 1000, fixed_size(12)), "EXTRA", true, METADATA, HEX},  
   LAST_FIELD
 };
@@ -185,9 +204,40 @@ constexpr FieldSpec TStreamerBasicTypeSpec[] = {
 };
 
 
+// The TArrays: the number of values, followed by the values.
+constexpr FieldSpec ArrayCSpec[] {
+  {fixed_size(4), "size", true, METADATA, SCALAR},
+  {runtime_size(-4, 4, true, 1), "data", true, DATA, HEX},
+  LAST_FIELD
+};
+
+constexpr FieldSpec ArraySSpec[] {
+  {fixed_size(4), "size", true, METADATA, SCALAR},
+  {runtime_size(-4, 4, true, 2), "data", true, DATA, HEX},
+  LAST_FIELD
+};
+
 constexpr FieldSpec ArrayISpec[] {
   {fixed_size(4), "size", true, METADATA, SCALAR},
-  {runtime_size(-4, 4, true), "data", true, DATA, HEX},        // The size of this field depends on the previous field.
+  {runtime_size(-4, 4, true, 4), "data", true, DATA, HEX},
+  LAST_FIELD
+};
+
+constexpr FieldSpec ArrayL64Spec[] {
+  {fixed_size(4), "size", true, METADATA, SCALAR},
+  {runtime_size(-4, 4, true, 8), "data", true, DATA, HEX},
+  LAST_FIELD
+};
+
+constexpr FieldSpec ArrayFSpec[] {
+  {fixed_size(4), "size", true, METADATA, SCALAR},
+  {runtime_size(-4, 4, true, 4), "data", true, DATA, HEX},
+  LAST_FIELD
+};
+
+constexpr FieldSpec ArrayDSpec[] {
+  {fixed_size(4), "size", true, METADATA, SCALAR},
+  {runtime_size(-4, 4, true, 8), "data", true, DATA, HEX},
   LAST_FIELD
 };
 
@@ -0,0 +1,159 @@
+#ifndef __RECOMPRESS_HELPERS_H
+#define __RECOMPRESS_HELPERS_H
+#include "zlib.h"
+#include "lzma.h"
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** Compression of objects with the algorithms and levels brut is built
+    with, to measure what other settings would give on real files.
+
+    Each thread keeps its own CodecContext, so that the zlib and lzma
+    streams, and the memory they allocate, are reused from one object to the
+    next rather than set up every time.
+  */
+struct CodecContext {
+  z_stream    deflater;
+  int         deflaterLevel;
+  z_stream    inflater;
+  bool        inflaterReady;
+  lzma_stream encoder;
+  lzma_stream decoder;
+
+  CodecContext() : deflaterLevel(-1), inflaterReady(false), encoder(LZMA_STREAM_INIT), decoder(LZMA_STREAM_INIT)
+  {
+    memset(&deflater, 0, sizeof(deflater));
+    memset(&inflater, 0, sizeof(inflater));
+  }
+
+  ~CodecContext()
+  {
+    if (deflaterLevel >= 0)
+      deflateEnd(&deflater);
+    if (inflaterReady)
+      inflateEnd(&inflater);
+    lzma_end(&encoder);
+    lzma_end(&decoder);
+  }
+
+private:
+  CodecContext(CodecContext const &);
+  CodecContext &operator=(CodecContext const &);
+};
+
+// Compress @a size bytes at @a source in @a output, resized to fit.
+typedef bool (*CodecCompress)(CodecContext &context, int level, unsigned char const *source, size_t size,
+                              std::vector<unsigned char> &output);
+// Decompress @a size bytes at @a source in the @a outputSize bytes at @a output.
+typedef bool (*CodecDecompress)(CodecContext &context, unsigned char const *source, size_t size,
+                                unsigned char *output, size_t outputSize);
+
+inline bool compressZlib(CodecContext &context, int level, unsigned char const *source, size_t size,
+                  std::vector<unsigned char> &output)
+{
+  z_stream &stream = context.deflater;
+  if (context.deflaterLevel < 0 && deflateInit(&stream, level) != Z_OK)
+    return false;
+  if (context.deflaterLevel >= 0 && (deflateReset(&stream) != Z_OK
+                                     || (context.deflaterLevel != level && deflateParams(&stream, level, Z_DEFAULT_STRATEGY) != Z_OK)))
+    return false;
+  context.deflaterLevel = level;
+  output.resize(deflateBound(&stream, size));
+  stream.next_in = (Bytef *) source;
+  stream.avail_in = size;
+  stream.next_out = &output[0];
+  stream.avail_out = output.size();
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    return false;
+  output.resize(stream.total_out);
+  return true;
+}
+
+inline bool decompressZlib(CodecContext &context, unsigned char const *source, size_t size,
+                    unsigned char *output, size_t outputSize)
+{
+  z_stream &stream = context.inflater;
+  if (!context.inflaterReady && inflateInit(&stream) != Z_OK)
+    return false;
+  if (context.inflaterReady && inflateReset(&stream) != Z_OK)
+    return false;
+  context.inflaterReady = true;
+  stream.next_in = (Bytef *) source;
+  stream.avail_in = size;
+  stream.next_out = output;
+  stream.avail_out = outputSize;
+  return inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out == outputSize;
+}
+
+inline bool compressLzma(CodecContext &context, int level, unsigned char const *source, size_t size,
+                  std::vector<unsigned char> &output)
+{
+  lzma_stream &stream = context.encoder;
+  if (lzma_easy_encoder(&stream, level, LZMA_CHECK_CRC32) != LZMA_OK)
+    return false;
+  output.resize(lzma_stream_buffer_bound(size));
+  stream.next_in = source;
+  stream.avail_in = size;
+  stream.next_out = &output[0];
+  stream.avail_out = output.size();
+  if (lzma_code(&stream, LZMA_FINISH) != LZMA_STREAM_END)
+    return false;
+  output.resize(output.size() - stream.avail_out);
+  return true;
+}
+
+inline bool decompressLzma(CodecContext &context, unsigned char const *source, size_t size,
+                    unsigned char *output, size_t outputSize)
+{
+  lzma_stream &stream = context.decoder;
+  if (lzma_stream_decoder(&stream, UINT64_MAX, 0) != LZMA_OK)
+    return false;
+  stream.next_in = source;
+  stream.avail_in = size;
+  stream.next_out = output;
+  stream.avail_out = outputSize;
+  return lzma_code(&stream, LZMA_FINISH) == LZMA_STREAM_END && stream.avail_out == 0;
+}
+
+/** An algorithm to benchmark, at each of @a levels, which ends with 0.
+    New algorithms (e.g. LZ4, ZSTD) only need an entry here, once brut is
+    built with them.
+  */
+struct Codec {
+  char const      *name;
+  int             levels[4];
+  CodecCompress   compress;
+  CodecDecompress decompress;
+};
+
+Codec const codecs[] = {
+  {"zlib", {1, 6, 9, 0}, compressZlib, decompressZlib},
+  {"lzma", {1, 6, 0, 0}, compressLzma, decompressLzma},
+  {0, {0, 0, 0, 0}, 0, 0}
+};
+
+/** The totals of one algorithm at one level on a set of objects, with the
+    time spent compressing and decompressing them, in seconds.
+  */
+struct CodecResult {
+  uint64_t  objects;
+  uint64_t  bytes;
+  uint64_t  compressed;
+  double    compressTime;
+  double    decompressTime;
+  uint64_t  failed;
+
+  void merge(CodecResult const &other)
+  {
+    objects += other.objects;
+    bytes += other.bytes;
+    compressed += other.compressed;
+    compressTime += other.compressTime;
+    decompressTime += other.decompressTime;
+    failed += other.failed;
+  }
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "RootFile.h"
+#include "BasketHelpers.h"
+#include "HashHelpers.h"
+#include "ThreadHelpers.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace brut {
+
+RootFile::RootFile() : fd_(-1) {}
+
+RootFile::~RootFile()
+{
+  close();
+}
+
+bool RootFile::open(char const *path)
+{
+  close();
+  path_ = path;
+  fd_ = ::open(path, O_RDONLY);
+  if (fd_ < 0)
+  {
+    error_ = std::string("Unable to open ") + path + ": " + strerror(errno);
+    return false;
+  }
+  std::vector<KeyInfo> infos;
+  std::vector<std::string> directories;
+  try
+  {
+    if (!readKeys(fd_, infos))
+    {
+      error_ = std::string(path) + " is not a ROOT file, or is corrupted";
+      close();
+      return false;
+    }
+  }
+  catch (ParseError const &error)
+  {
+    error_ = std::string(path) + ": " + error.error_ + " " + error.where_;
+    close();
+    return false;
+  }
+  catch (char const *error)
+  {
+    error_ = std::string(path) + ": " + error;
+    close();
+    return false;
+  }
+  keyDirectories(infos, directories);
+
+  // All the names go in one buffer, which must not move once the keys
+  // point into it.
+  size_t size = 0;
+  for (size_t i = 0; i < infos.size(); ++i)
+    size += infos[i].className.size() + infos[i].name.size() + infos[i].title.size() + directories[i].size();
+  strings_.reserve(size + 1);
+  keys_.resize(infos.size());
+  for (size_t i = 0; i < infos.size(); ++i)
+  {
+    KeyInfo const &info = infos[i];
+    Key &key = keys_[i];
+    key.offset = info.seekKey;
+    key.parent = info.seekPdir;
+    key.nbytes = info.nbytes;
+    key.objLen = info.objLen;
+    key.keyLen = info.keyLen;
+    key.cycle = info.cycle;
+    memcpy(key.compression, info.compression, sizeof(key.compression));
+    std::string const *strings[] = {&info.className, &info.name, &info.title, &directories[i]};
+    StringRef *refs[] = {&key.className, &key.name, &key.title, &key.directory};
+    for (int s = 0; s < 4; ++s)
+    {
+      refs[s]->data = strings_.data() + strings_.size();
+      refs[s]->size = strings[s]->size();
+      strings_.insert(strings_.end(), strings[s]->begin(), strings[s]->end());
+    }
+  }
+  error_.clear();
+  return true;
+}
+
+void RootFile::close()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  keys_.clear();
+  strings_.clear();
+}
+
+// readKey, for the keys of the API.
+static bool readPayload(int fd, Key const &key, std::vector<char> &scratch, char *output)
+{
+  return readObject(fd, key.offset, key.keyLen, key.nbytes, key.objLen, scratch, output);
+}
+
+bool RootFile::read(Key const &key, std::vector<char> &payload) const
+{
+  std::vector<char> scratch;
+  payload.resize(key.objLen);
+  return fd_ >= 0 && readPayload(fd_, key, scratch, payload.data());
+}
+
+size_t RootFile::hash(HashCallback const &callback, std::vector<Key> const *keys) const
+{
+  std::vector<Key> const &selected = keys ? *keys : keys_;
+  std::vector<unsigned char> digests(selected.size() * digestSize);
+  std::vector<char> ok(selected.size(), 0);
+  std::vector<std::vector<char> > scratch(parallelThreads());
+  std::vector<std::vector<char> > payload(parallelThreads());
+  parallelFor(selected.size(), [&](size_t i, unsigned thread) {
+    payload[thread].resize(selected[i].objLen);
+    if (fd_ < 0 || !readPayload(fd_, selected[i], scratch[thread], payload[thread].data()))
+      return;
+    sha1(payload[thread].data(), payload[thread].size(), &digests[i * digestSize]);
+    ok[i] = 1;
+  });
+  size_t failed = 0;
+  for (size_t i = 0; i < selected.size(); ++i)
+  {
+    failed += !ok[i];
+    callback(selected[i], ok[i] ? &digests[i * digestSize] : 0);
+  }
+  return failed;
+}
+
+}
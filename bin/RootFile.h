@@ -0,0 +1,109 @@
+#ifndef __ROOT_FILE_H
+#define __ROOT_FILE_H
+#include <stdint.h>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** The API of libbrut, to read the keys and objects of ROOT files in
+    process rather than parsing the output of brut.
+
+        brut::RootFile file;
+        if (!file.open("file.root"))
+          fprintf(stderr, "%s\n", file.error().c_str());
+        for (brut::Key const &key : file)
+          if (key.className == "TH1F")
+            file.read(key, payload);
+
+    Only this header is needed. The helpers the library is built from define
+    inline functions, so programs can still include them on their own, and
+    then share their stats counters and trace rings with the library.
+  */
+namespace brut {
+
+constexpr size_t digestSize = 20;
+
+/** Characters owned by someone else, e.g. the names of the keys, which are
+    owned by their RootFile (std::string_view is C++17).
+  */
+struct StringRef {
+  char const  *data;
+  size_t      size;
+
+  std::string str() const { return std::string(data, size); }
+  bool operator==(char const *other) const { return strlen(other) == size && memcmp(data, other, size) == 0; }
+  bool operator!=(char const *other) const { return !(*this == other); }
+};
+
+/** The header of a key. @a directory is the path of the directory holding
+    it, empty for the top one, and @a compression the algorithm of its
+    first chunk, e.g. "ZL\x08", or zeros if it is not compressed.
+  */
+struct Key {
+  uint64_t    offset;
+  uint64_t    parent;
+  uint32_t    nbytes;
+  uint32_t    objLen;
+  uint32_t    keyLen;
+  short       cycle;
+  StringRef   className;
+  StringRef   name;
+  StringRef   title;
+  StringRef   directory;
+  char        compression[3];
+
+  bool compressed() const { return compression[0] != 0; }
+};
+
+/** Called with each key and the SHA1 of its uncompressed object, or 0 if
+    it could not be read.
+  */
+typedef std::function<void (Key const &key, unsigned char const *digest)> HashCallback;
+
+class RootFile {
+public:
+  typedef std::vector<Key>::const_iterator const_iterator;
+
+  RootFile();
+  ~RootFile();
+
+  /** Open @a path and read the headers of all its keys.
+      @return false, with the reason in error(), if it is not a ROOT file.
+    */
+  bool open(char const *path);
+  void close();
+  std::string const &error() const { return error_; }
+  std::string const &path() const { return path_; }
+
+  const_iterator begin() const { return keys_.begin(); }
+  const_iterator end() const { return keys_.end(); }
+  size_t size() const { return keys_.size(); }
+  Key const &operator[](size_t i) const { return keys_[i]; }
+
+  /** Read the object of @a key in @a payload, decompressing it if needed.
+      This only uses pread, so it can be called from many threads.
+    */
+  bool read(Key const &key, std::vector<char> &payload) const;
+
+  /** Compute the SHA1 of the objects of @a keys, or of all the keys if
+      null, in parallel, and call @a callback for each of them, in order,
+      from the calling thread.
+      @return the number of objects which could not be read.
+    */
+  size_t hash(HashCallback const &callback, std::vector<Key> const *keys = 0) const;
+
+private:
+  RootFile(RootFile const &);
+  RootFile &operator=(RootFile const &);
+
+  int               fd_;
+  std::string       path_;
+  std::string       error_;
+  std::vector<Key>  keys_;
+  std::vector<char> strings_;
+};
+
+}
+
+#endif
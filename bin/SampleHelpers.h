@@ -0,0 +1,96 @@
+#ifndef __SAMPLE_HELPERS_H
+#define __SAMPLE_HELPERS_H
+#include "HashHelpers.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/** Approximate comparison of large files, reading only a sample of their
+    objects.
+
+    Objects are grouped in strata by class and by size (a power of two), so
+    that small and rare objects are sampled as well as the large baskets
+    which make up most of the file. Within each stratum objects are ranked
+    by a seeded hash of their name, so that the same seed picks the same
+    objects in two files with the same contents. The first object of each
+    stratum is always taken, then the next ones, stratum after stratum,
+    as long as they fit in the byte budget.
+  */
+constexpr char samplePrefix[] = "Sample ";
+constexpr char sampleObjectPrefix[] = "Object ";
+constexpr uint64_t sampleDefaultBudget = 64 << 20;
+// The confidence of the bound reported on the fraction of differing objects.
+constexpr double sampleConfidence = 0.95;
+
+/** An object which can be sampled: its stratum, the seeded hash of its name
+    and its size.
+  */
+struct SampleCandidate {
+  std::string stratum;
+  uint64_t    rank;
+  size_t      size;
+};
+
+inline std::string sampleStratum(std::string const &className, size_t size)
+{
+  int bits = 0;
+  while (size >> bits)
+    ++bits;
+  char bucket[16];
+  snprintf(bucket, sizeof(bucket), "|%i", bits);
+  return className + bucket;
+}
+
+inline uint64_t sampleRank(std::string const &name, uint64_t seed)
+{
+  return fastHash64(name.data(), name.size(), seed);
+}
+
+/** Append to @a selected, in increasing order, the indices of the
+    @a candidates to sample with @a budget bytes. The first one of each
+    stratum is selected even if it does not fit.
+  */
+inline void selectSample(std::vector<SampleCandidate> const &candidates, uint64_t budget,
+                  std::vector<size_t> &selected)
+{
+  std::vector<size_t> order(candidates.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    SampleCandidate const &x = candidates[a], &y = candidates[b];
+    return x.stratum != y.stratum ? x.stratum < y.stratum : x.rank != y.rank ? x.rank < y.rank : a < b;
+  });
+  // The position of each candidate in its stratum, so that strata are
+  // visited round robin.
+  std::vector<size_t> position(candidates.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    position[order[i]] = i && candidates[order[i]].stratum == candidates[order[i - 1]].stratum
+                       ? position[order[i - 1]] + 1 : 0;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return position[a] < position[b];
+  });
+  uint64_t used = 0;
+  size_t first = selected.size();
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    size_t size = candidates[order[i]].size;
+    if (position[order[i]] && used + size > budget)
+      continue;
+    used += size;
+    selected.push_back(order[i]);
+  }
+  std::sort(selected.begin() + first, selected.end());
+}
+
+/** The fraction of differing objects which, with sampleConfidence, is not
+    exceeded when none of @a sampled random objects differs, i.e. the p for
+    which (1 - p)^sampled = 1 - sampleConfidence.
+  */
+inline double sampleBound(size_t sampled)
+{
+  return sampled ? 1 - pow(1 - sampleConfidence, 1. / sampled) : 1;
+}
+
+#endif
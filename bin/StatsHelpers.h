@@ -0,0 +1,249 @@
+#ifndef __STATS_HELPERS_H
+#define __STATS_HELPERS_H
+#include "TraceHelpers.h"
+#include <stdint.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/** Counters of where brut spends its time, cheap enough to be always on.
+
+    Each thread adds to its own StatsBlock, on its own cache line, taken
+    from a fixed pool the first time it counts something and given back
+    when it exits, without being cleared, so that a snapshot is simply the
+    sum of all the blocks. Stages, i.e. the node types, are only run by the
+    main thread, which times them.
+
+    Snapshots and their formatting only use atomic loads and write(2), so
+    that they can be taken from a signal handler.
+
+    The counters are the static of an inline function, like all the
+    functions here, so that brut and libbrut count in the same blocks.
+  */
+enum StatCounter {
+  STAT_WINDOWS_MAPPED = 0,
+  STAT_BYTES_MAPPED,
+  STAT_BYTES_READ,
+  STAT_KEYS_VISITED,
+  STAT_ZLIB_INPUT,
+  STAT_ZLIB_OUTPUT,
+  STAT_LZMA_INPUT,
+  STAT_LZMA_OUTPUT,
+  STAT_BYTES_HASHED,
+  STAT_OUTPUT_BYTES,
+  STAT_COUNTERS
+};
+
+constexpr char const *statLabels[STAT_COUNTERS] = {
+  "windows mapped",
+  "bytes mapped",
+  "bytes read",
+  "keys visited",
+  "zlib input bytes",
+  "zlib output bytes",
+  "lzma input bytes",
+  "lzma output bytes",
+  "bytes hashed",
+  "output bytes"
+};
+
+constexpr char statsPrefix[] = "Stat ";
+constexpr unsigned statsMaxThreads = 256;
+constexpr unsigned statsMaxStages = 64;
+
+struct alignas(64) StatsBlock {
+  std::atomic<bool>     used;
+  std::atomic<uint64_t> counters[STAT_COUNTERS];
+};
+
+struct StatsCounters {
+  StatsBlock            blocks[statsMaxThreads];
+  std::atomic<uint64_t> stageVisits[statsMaxStages];
+  std::atomic<uint64_t> stageNanoseconds[statsMaxStages];
+};
+
+// Zero initialized, without a guard, so safe in a signal handler.
+inline StatsCounters &statsCounters()
+{
+  static StatsCounters counters;
+  return counters;
+}
+
+// The block of the current thread, given back when it exits. Threads
+// beyond statsMaxThreads share the last block.
+struct StatsThread {
+  StatsBlock *block;
+
+  StatsThread() : block(&statsCounters().blocks[statsMaxThreads - 1])
+  {
+    for (unsigned i = 0; i < statsMaxThreads - 1; ++i)
+    {
+      bool expected = false;
+      if (statsCounters().blocks[i].used.compare_exchange_strong(expected, true))
+      {
+        block = &statsCounters().blocks[i];
+        break;
+      }
+    }
+  }
+
+  // Anything counted later, e.g. by exit handlers, goes to the shared block.
+  ~StatsThread()
+  {
+    if (block != &statsCounters().blocks[statsMaxThreads - 1])
+      block->used = false;
+    block = &statsCounters().blocks[statsMaxThreads - 1];
+  }
+};
+
+inline void statsAdd(StatCounter counter, uint64_t value)
+{
+  static thread_local StatsThread thread;
+  thread.block->counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+inline void statsStage(unsigned stage, uint64_t nanoseconds)
+{
+  if (stage >= statsMaxStages)
+    return;
+  statsCounters().stageVisits[stage].fetch_add(1, std::memory_order_relaxed);
+  statsCounters().stageNanoseconds[stage].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+struct StatsSnapshot {
+  uint64_t  counters[STAT_COUNTERS];
+  uint64_t  stageVisits[statsMaxStages];
+  uint64_t  stageNanoseconds[statsMaxStages];
+  uint64_t  minorFaults;
+  uint64_t  majorFaults;
+};
+
+inline void statsSnapshot(StatsSnapshot &snapshot)
+{
+  StatsCounters const &counters = statsCounters();
+  memset(&snapshot, 0, sizeof(snapshot));
+  for (unsigned i = 0; i < statsMaxThreads; ++i)
+    for (unsigned c = 0; c < STAT_COUNTERS; ++c)
+      snapshot.counters[c] += counters.blocks[i].counters[c].load(std::memory_order_relaxed);
+  for (unsigned s = 0; s < statsMaxStages; ++s)
+  {
+    snapshot.stageVisits[s] = counters.stageVisits[s].load(std::memory_order_relaxed);
+    snapshot.stageNanoseconds[s] = counters.stageNanoseconds[s].load(std::memory_order_relaxed);
+  }
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+  {
+    snapshot.minorFaults = usage.ru_minflt;
+    snapshot.majorFaults = usage.ru_majflt;
+  }
+}
+
+// Append @a text to the @a size bytes of @a buffer, from @a length on.
+inline void statsAppend(char *buffer, size_t size, size_t &length, char const *text)
+{
+  for (; *text && length + 1 < size; ++text)
+    buffer[length++] = *text;
+  buffer[length] = 0;
+}
+
+inline void statsAppend(char *buffer, size_t size, size_t &length, uint64_t value)
+{
+  char digits[24];
+  int n = sizeof(digits) - 1;
+  digits[n] = 0;
+  do
+    digits[--n] = '0' + value % 10;
+  while (value /= 10);
+  statsAppend(buffer, size, length, digits + n);
+}
+
+inline void statsAppendLine(char *buffer, size_t size, size_t &length, char const *label, uint64_t value)
+{
+  statsAppend(buffer, size, length, statsPrefix);
+  statsAppend(buffer, size, length, label);
+  statsAppend(buffer, size, length, ": ");
+  statsAppend(buffer, size, length, value);
+  statsAppend(buffer, size, length, "\n");
+}
+
+/** Write @a snapshot in the @a size bytes of @a buffer, one
+    "Stat <label>: <value>" line per counter, then one line per stage which
+    ran, named after @a stageLabels.
+    @return the length of the text.
+  */
+inline size_t statsFormat(StatsSnapshot const &snapshot, char const *const *stageLabels, char *buffer, size_t size)
+{
+  size_t length = 0;
+  buffer[0] = 0;
+  for (unsigned c = 0; c < STAT_COUNTERS; ++c)
+    statsAppendLine(buffer, size, length, statLabels[c], snapshot.counters[c]);
+  statsAppendLine(buffer, size, length, "minor page faults", snapshot.minorFaults);
+  statsAppendLine(buffer, size, length, "major page faults", snapshot.majorFaults);
+  for (unsigned s = 0; s < statsMaxStages; ++s)
+  {
+    if (!snapshot.stageVisits[s] || !stageLabels[s])
+      continue;
+    statsAppend(buffer, size, length, statsPrefix);
+    statsAppend(buffer, size, length, "stage ");
+    statsAppend(buffer, size, length, stageLabels[s]);
+    statsAppend(buffer, size, length, ": ");
+    statsAppend(buffer, size, length, snapshot.stageVisits[s]);
+    statsAppend(buffer, size, length, " nodes, ");
+    statsAppend(buffer, size, length, snapshot.stageNanoseconds[s]);
+    statsAppend(buffer, size, length, " ns\n");
+  }
+  return length;
+}
+
+// Write a snapshot of the counters to @a fd, using only write(2).
+inline void statsWrite(int fd, char const *const *stageLabels)
+{
+  static StatsSnapshot snapshot;
+  static char buffer[8192];
+  statsSnapshot(snapshot);
+  size_t length = statsFormat(snapshot, stageLabels, buffer, sizeof(buffer));
+  for (size_t done = 0; done < length;)
+  {
+    ssize_t n = write(fd, buffer + done, length - done);
+    if (n <= 0)
+      return;
+    done += n;
+  }
+}
+
+#ifdef __GLIBC__
+inline ssize_t statsCountingWrite(void * /*cookie*/, char const *buffer, size_t size)
+{
+  TraceSpan span("output", size);
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t n = write(1, buffer + done, size - done);
+    if (n <= 0)
+      return done ? done : -1;
+    done += n;
+  }
+  statsAdd(STAT_OUTPUT_BYTES, done);
+  return done;
+}
+#endif
+
+/** Replace stdout with a stream which counts the bytes it writes, buffered
+    like stdout was. Output is only counted with glibc.
+  */
+inline void statsCountOutput()
+{
+#ifdef __GLIBC__
+  cookie_io_functions_t functions = {0, statsCountingWrite, 0, 0};
+  FILE *counting = fopencookie(0, "w", functions);
+  if (!counting)
+    return;
+  setvbuf(counting, 0, isatty(1) ? _IOLBF : _IOFBF, BUFSIZ);
+  fflush(stdout);
+  stdout = counting;
+#endif
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef __SUMMARY_HELPERS_H
+#define __SUMMARY_HELPERS_H
+#include "ByteSwapHelpers.h"
+#include "ExportHelpers.h"
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+
+/** Summary of the values of a branch, or of a basket of it.
+
+    - @a count  all the values, including NaNs and infinities.
+    - @a min, @a max, @a sum  of the finite values only.
+  */
+struct Summary {
+  uint64_t  count;
+  uint64_t  nans;
+  uint64_t  infs;
+  double    min;
+  double    max;
+  double    sum;
+};
+
+inline Summary emptySummary()
+{
+  Summary summary = {0, 0, 0, HUGE_VAL, -HUGE_VAL, 0};
+  return summary;
+}
+
+// Add @a partial to @a summary.
+inline void mergeSummary(Summary &summary, Summary const &partial)
+{
+  summary.count += partial.count;
+  summary.nans += partial.nans;
+  summary.infs += partial.infs;
+  summary.min = std::min(summary.min, partial.min);
+  summary.max = std::max(summary.max, partial.max);
+  summary.sum += partial.sum;
+}
+
+template <class T>
+void summarizeScalar(T const *values, size_t n, Summary &summary)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    double v = values[i];
+    if (v != v)
+      ++summary.nans;
+    else if (v == HUGE_VAL || v == -HUGE_VAL)
+      ++summary.infs;
+    else
+    {
+      summary.min = std::min(summary.min, v);
+      summary.max = std::max(summary.max, v);
+      summary.sum += v;
+    }
+  }
+  summary.count += n;
+}
+
+#if __HAVE_X86_SIMD__
+// Reduce 4 doubles: non finite values are counted and replaced by neutral
+// elements before going into the min, max and sum accumulators.
+__attribute__((target("avx2")))
+inline void summarize4(__m256d v, __m256d &min, __m256d &max, __m256d &sum,
+                       uint64_t &nans, uint64_t &nonFinite)
+{
+  __m256d const zero = _mm256_setzero_pd();
+  __m256d nan = _mm256_cmp_pd(v, v, _CMP_UNORD_Q);
+  // x - x is 0 for finite values, NaN otherwise.
+  __m256d finite = _mm256_cmp_pd(_mm256_sub_pd(v, v), zero, _CMP_EQ_OQ);
+  nans += __builtin_popcount(_mm256_movemask_pd(nan));
+  nonFinite += 4 - __builtin_popcount(_mm256_movemask_pd(finite));
+  min = _mm256_min_pd(min, _mm256_blendv_pd(_mm256_set1_pd(HUGE_VAL), v, finite));
+  max = _mm256_max_pd(max, _mm256_blendv_pd(_mm256_set1_pd(-HUGE_VAL), v, finite));
+  sum = _mm256_add_pd(sum, _mm256_and_pd(v, finite));
+}
+
+__attribute__((target("avx2")))
+inline void finishSummary(__m256d min, __m256d max, __m256d sum,
+                          uint64_t nans, uint64_t nonFinite, size_t n, Summary &summary)
+{
+  double lanes[4];
+  _mm256_storeu_pd(lanes, min);
+  summary.min = std::min(summary.min, std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3])));
+  _mm256_storeu_pd(lanes, max);
+  summary.max = std::max(summary.max, std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])));
+  _mm256_storeu_pd(lanes, sum);
+  summary.sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  summary.nans += nans;
+  summary.infs += nonFinite - nans;
+  summary.count += n;
+}
+
+__attribute__((target("avx2")))
+inline void summarizeAVX2(double const *values, size_t n, Summary &summary)
+{
+  __m256d min = _mm256_set1_pd(HUGE_VAL);
+  __m256d max = _mm256_set1_pd(-HUGE_VAL);
+  __m256d sum = _mm256_setzero_pd();
+  uint64_t nans = 0, nonFinite = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    summarize4(_mm256_loadu_pd(values + i), min, max, sum, nans, nonFinite);
+  finishSummary(min, max, sum, nans, nonFinite, i, summary);
+  summarizeScalar(values + i, n - i, summary);
+}
+
+// Floats are widened to doubles, so that sums do not lose precision.
+__attribute__((target("avx2")))
+inline void summarizeAVX2(float const *values, size_t n, Summary &summary)
+{
+  __m256d min = _mm256_set1_pd(HUGE_VAL);
+  __m256d max = _mm256_set1_pd(-HUGE_VAL);
+  __m256d sum = _mm256_setzero_pd();
+  uint64_t nans = 0, nonFinite = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    summarize4(_mm256_cvtps_pd(_mm_loadu_ps(values + i)), min, max, sum, nans, nonFinite);
+  finishSummary(min, max, sum, nans, nonFinite, i, summary);
+  summarizeScalar(values + i, n - i, summary);
+}
+#endif // __HAVE_X86_SIMD__
+
+inline bool useAVX2Summaries()
+{
+  static bool const avx2 = bestSimdLevel() == SIMD_AVX2 || bestSimdLevel() == SIMD_AVX512;
+  return avx2;
+}
+
+template <class T>
+void summarizeValues(T const *values, size_t n, Summary &summary)
+{
+  summarizeScalar(values, n, summary);
+}
+
+template <>
+inline void summarizeValues(double const *values, size_t n, Summary &summary)
+{
+#if __HAVE_X86_SIMD__
+  if (useAVX2Summaries())
+    return summarizeAVX2(values, n, summary);
+#endif
+  summarizeScalar(values, n, summary);
+}
+
+template <>
+inline void summarizeValues(float const *values, size_t n, Summary &summary)
+{
+#if __HAVE_X86_SIMD__
+  if (useAVX2Summaries())
+    return summarizeAVX2(values, n, summary);
+#endif
+  summarizeScalar(values, n, summary);
+}
+
+/** Summarize @a count values of @a type, already in native order, at
+    @a data, which must be suitably aligned for them.
+  */
+inline void summarize(ColumnType const *type, char const *data, size_t count, Summary &summary)
+{
+  std::string label(type->label);
+  if (label == "int8")
+    summarizeValues((int8_t const *) data, count, summary);
+  else if (label == "uint8" || label == "bool")
+    summarizeValues((uint8_t const *) data, count, summary);
+  else if (label == "int16")
+    summarizeValues((int16_t const *) data, count, summary);
+  else if (label == "uint16")
+    summarizeValues((uint16_t const *) data, count, summary);
+  else if (label == "int32")
+    summarizeValues((int32_t const *) data, count, summary);
+  else if (label == "uint32")
+    summarizeValues((uint32_t const *) data, count, summary);
+  else if (label == "int64")
+    summarizeValues((int64_t const *) data, count, summary);
+  else if (label == "uint64")
+    summarizeValues((uint64_t const *) data, count, summary);
+  else if (label == "float")
+    summarizeValues((float const *) data, count, summary);
+  else
+    summarizeValues((double const *) data, count, summary);
+}
+
+#endif
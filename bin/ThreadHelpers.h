@@ -0,0 +1,43 @@
+#ifndef __THREAD_HELPERS_H
+#define __THREAD_HELPERS_H
+#include <thread>
+#include <atomic>
+#include <vector>
+
+/** The number of threads used by parallelFor. */
+inline unsigned parallelThreads()
+{
+  unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+/** Invoke @a func(i, thread) for every i in [0, n), spreading the indices
+    over at most parallelThreads() threads. Indices are handed out in
+    increasing order, one at the time, so that large items do not starve
+    the others.
+
+    @a thread is the index, in [0, parallelThreads()), of the thread running
+    @a func, so that callers can keep per-thread scratch buffers.
+  */
+template <class F>
+void parallelFor(size_t n, F const &func)
+{
+  unsigned nThreads = parallelThreads();
+  if (nThreads > n)
+    nThreads = n;
+
+  std::atomic<size_t> nextIndex(0);
+  auto worker = [&](unsigned thread) {
+    for (size_t i = nextIndex++; i < n; i = nextIndex++)
+      func(i, thread);
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < nThreads; ++t)
+    threads.push_back(std::thread(worker, t));
+  worker(0);
+  for (size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+}
+
+#endif
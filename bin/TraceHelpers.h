@@ -0,0 +1,187 @@
+#ifndef __TRACE_HELPERS_H
+#define __TRACE_HELPERS_H
+#include "JsonHelpers.h"
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+/** A timeline of what each thread does, in the trace event format of
+    Chrome, which Perfetto (ui.perfetto.dev) and chrome://tracing open.
+
+    While tracing is enabled, each TraceSpan records one complete event, its
+    name, start, end and argument (an offset or a size), in the ring buffer
+    of its thread, overwriting the oldest events once traceRingSize of them
+    have been recorded. Rings are taken from a fixed pool the first time a
+    thread records something and given back, with their events, when it
+    exits, so that the short lived threads of parallelFor share a few of
+    them. Threads beyond the pool record nothing. Each ring only has one
+    writer, which publishes its events by moving the head of the ring, so
+    recording never takes a lock; rings are only read once tracing is
+    stopped.
+
+    When tracing is disabled, spans cost one relaxed load.
+
+    The rings are the static of an inline function, like all the functions
+    here, so that brut and libbrut record in the same rings.
+  */
+constexpr unsigned traceMaxThreads = 256;
+constexpr size_t traceRingSize = 1 << 16;
+
+struct TraceEvent {
+  char const  *name;
+  uint64_t    begin;
+  uint64_t    end;
+  uint64_t    arg;
+};
+
+struct TraceRing {
+  std::atomic<bool>     used;
+  std::atomic<uint64_t> head;
+  TraceEvent            *events;
+};
+
+struct TraceState {
+  TraceRing                             rings[traceMaxThreads];
+  std::atomic<bool>                     enabled;
+  std::chrono::steady_clock::time_point origin;
+};
+
+inline TraceState &traceState()
+{
+  static TraceState state;
+  return state;
+}
+
+// Nanoseconds since tracing started.
+inline uint64_t traceNow()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceState().origin).count();
+}
+
+// The ring of the current thread, if it could get one.
+struct TraceThread {
+  TraceRing *ring;
+
+  TraceThread() : ring(0)
+  {
+    for (unsigned i = 0; i < traceMaxThreads; ++i)
+    {
+      bool expected = false;
+      if (traceState().rings[i].used.compare_exchange_strong(expected, true))
+      {
+        ring = &traceState().rings[i];
+        break;
+      }
+    }
+    if (ring && !ring->events)
+      ring->events = new TraceEvent[traceRingSize];
+  }
+
+  ~TraceThread()
+  {
+    if (ring)
+      ring->used = false;
+    ring = 0;
+  }
+};
+
+inline TraceThread &traceThread()
+{
+  static thread_local TraceThread thread;
+  return thread;
+}
+
+inline void traceRecord(char const *name, uint64_t begin, uint64_t end, uint64_t arg)
+{
+  TraceRing *ring = traceThread().ring;
+  if (!ring)
+    return;
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  TraceEvent &event = ring->events[head % traceRingSize];
+  event.name = name;
+  event.begin = begin;
+  event.end = end;
+  event.arg = arg;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Record the lifetime of the span as the event @a name, if tracing.
+struct TraceSpan {
+  char const  *name;
+  uint64_t    arg;
+  bool        tracing;
+  uint64_t    begin;
+
+  TraceSpan(char const *aName, uint64_t anArg)
+  : name(aName), arg(anArg), tracing(traceState().enabled.load(std::memory_order_relaxed)), begin(tracing ? traceNow() : 0)
+  {}
+
+  ~TraceSpan()
+  {
+    if (tracing)
+      traceRecord(name, begin, traceNow(), arg);
+  }
+
+private:
+  TraceSpan(TraceSpan const &);
+  TraceSpan &operator=(TraceSpan const &);
+};
+
+/** Forget all the events and start recording. Only to be called when no
+    other thread is recording. The first thread to call it gets the first
+    ring, which is named after the main thread.
+  */
+inline void traceStart()
+{
+  TraceState &state = traceState();
+  traceThread();
+  state.enabled = false;
+  for (unsigned i = 0; i < traceMaxThreads; ++i)
+    state.rings[i].head = 0;
+  state.origin = std::chrono::steady_clock::now();
+  state.enabled = true;
+}
+
+inline void traceStop()
+{
+  traceState().enabled = false;
+}
+
+/** Write all the events recorded to @a out, as a JSON trace, with one
+    thread per ring. @a events and @a dropped count the events written and
+    those overwritten.
+    @return false if it could not be written.
+  */
+inline bool traceWrite(FILE *out, uint64_t &events, uint64_t &dropped)
+{
+  events = 0;
+  dropped = 0;
+  fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"brut\"}}");
+  for (unsigned i = 0; i < traceMaxThreads; ++i)
+  {
+    TraceRing const &ring = traceState().rings[i];
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    if (!head)
+      continue;
+    fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                 "\"args\": {\"name\": \"%s %u\"}}", i, i ? "thread" : "main", i);
+    uint64_t first = head > traceRingSize ? head - traceRingSize : 0;
+    dropped += first;
+    for (uint64_t e = first; e < head; ++e)
+    {
+      TraceEvent const &event = ring.events[e % traceRingSize];
+      fprintf(out, ",\n{\"name\": \"%s\", \"cat\": \"brut\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                   "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"arg\": %llu}}",
+              jsonString(event.name).c_str(), i, event.begin / 1e3, (event.end - event.begin) / 1e3,
+              (unsigned long long) event.arg);
+      ++events;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  return !ferror(out);
+}
+
+#endif
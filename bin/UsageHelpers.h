@@ -0,0 +1,101 @@
+#ifndef __USAGE_HELPERS_H
+#define __USAGE_HELPERS_H
+#include "BasketHelpers.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+/** Where the bytes of a file go: the number of keys, their size on disk
+    and their uncompressed size, summed by directory, then class, then, for
+    baskets, branch.
+
+    Nodes are named by the path of their components from the root, joined
+    by usageSeparator, as in MerkleHelpers.h:
+
+        file|<directory>|<class>|<tree/branch>
+  */
+constexpr char usageSeparator = '|';
+constexpr char usageRoot[] = "file";
+
+struct Usage {
+  uint64_t keys;
+  uint64_t nbytes;
+  uint64_t objLen;
+
+  void add(KeyInfo const &key)
+  {
+    keys += 1;
+    nbytes += key.nbytes;
+    objLen += key.objLen;
+  }
+
+  void print(char const *label, int depth, FILE *out = stdout) const
+  {
+    fprintf(out, "%*s%s: %llu keys, %llu bytes, %llu uncompressed, ratio %.2f\n", 2 * depth, "", label,
+            (unsigned long long) keys, (unsigned long long) nbytes, (unsigned long long) objLen,
+            (double) objLen / std::max(nbytes, (uint64_t) 1));
+  }
+};
+
+// The compression of @a key, e.g. "ZL method 8", or "none".
+inline std::string usageCompression(KeyInfo const &key)
+{
+  if (!key.compression[0])
+    return "none";
+  char label[32];
+  snprintf(label, sizeof(label), "%.2s method %i", key.compression, (int) (unsigned char) key.compression[2]);
+  return label;
+}
+
+struct UsageTree {
+  std::map<std::string, Usage>                  usage;
+  std::map<std::string, std::set<std::string> > children;
+
+  // Add @a key to the node @a name and all its parents.
+  void add(std::string const &name, KeyInfo const &key)
+  {
+    for (std::string node = name;; node = node.substr(0, node.rfind(usageSeparator)))
+    {
+      usage[node].add(key);
+      if (node == usageRoot)
+        break;
+      children[node.substr(0, node.rfind(usageSeparator))].insert(node);
+    }
+  }
+
+  // Print the tree, children sorted by decreasing size on disk.
+  void print(std::string const &node = usageRoot, int depth = 0, FILE *out = stdout) const
+  {
+    std::map<std::string, Usage>::const_iterator u = usage.find(node);
+    if (u == usage.end())
+      return;
+    u->second.print(node.c_str() + node.rfind(usageSeparator) + 1, depth, out);
+    std::map<std::string, std::set<std::string> >::const_iterator c = children.find(node);
+    if (c == children.end())
+      return;
+    std::vector<std::pair<uint64_t, std::string> > sorted;
+    for (std::set<std::string>::const_iterator i = c->second.begin(); i != c->second.end(); ++i)
+      sorted.push_back(std::make_pair(usage.find(*i)->second.nbytes, *i));
+    std::stable_sort(sorted.begin(), sorted.end(), [](std::pair<uint64_t, std::string> const &a,
+                                                      std::pair<uint64_t, std::string> const &b) {
+      return a.first > b.first;
+    });
+    for (size_t i = 0; i < sorted.size(); ++i)
+      print(sorted[i].second, depth + 1, out);
+  }
+};
+
+// The name of the node of @a key, in the directory @a directory.
+inline std::string usageNode(KeyInfo const &key, std::string const &directory)
+{
+  std::string node = std::string(usageRoot) + usageSeparator + "/" + directory + usageSeparator + key.className;
+  if (key.className == "TBasket")
+    node += usageSeparator + key.title + "/" + key.name;
+  return node;
+}
+
+#endif
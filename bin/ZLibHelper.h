@@ -7,6 +7,7 @@
 #include <cstring>
 #include <iostream>
 #include "zlib.h"
+#include "StatsHelpers.h"
 
 #if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(__CYGWIN__)
 #  include <fcntl.h>
@@ -20,12 +21,13 @@
    input and output should be already allocated and should have enough space
    to hold inputSize and outputSize respectively.
  */
-int uncompressZLIB(unsigned char *output, size_t outputSize, unsigned char *source, size_t sourceSize)
+inline int uncompressZLIB(unsigned char *output, size_t outputSize, unsigned char *source, size_t sourceSize)
 {
   assert(source[0] == 'Z');
   assert(source[1] == 'L');
   assert(source[2] == Z_DEFLATED);
   int ret;
+  TraceSpan span("zlib", sourceSize);
 
   z_stream strm;
   /* allocate inflate state */
@@ -37,13 +39,13 @@ int uncompressZLIB(unsigned char *output, size_t outputSize, unsigned char *sour
   strm.avail_out = outputSize;
   strm.next_out = output;
   ret = inflateInit(&strm);
-  ret = inflate(&strm, Z_FINISH);
   if (ret != Z_OK)
-  {
-    if (ret == Z_DATA_ERROR)
-      ret = inflateSync(&strm);
     return ret;
-  }
+  ret = inflate(&strm, Z_FINISH);
+  if (ret == Z_DATA_ERROR)
+    ret = inflateSync(&strm);
+  statsAdd(STAT_ZLIB_INPUT, strm.total_in);
+  statsAdd(STAT_ZLIB_OUTPUT, strm.total_out);
   (void)inflateEnd(&strm);
   return ret;
 }
@@ -1,612 +1,50 @@
-#include <stdlib.h>
-#include "CompressionHelpers.h"
-#include "BrutHeaders.h"
-#include "ROOTSchema.h"
-#include "CMSSWSchema.h"
-#include <cstdio>
-#include <cctype>
-#include <cassert>
-#include <vector>
+#include "BrutNodes.h"
+#include "StatsHelpers.h"
+#include "TraceHelpers.h"
+#include <csignal>
+#include <fcntl.h>
+#include <getopt.h>
 #include <readline/readline.h>
 #include <readline/history.h>
-#include <sys/mman.h>
-#include <fcntl.h>
-#include <unistd.h>
-
-#if __APPLE__
-# include <CommonCrypto/CommonDigest.h>
-#else
-# include <openssl/evp.h>
-#endif
-
-enum NodeType
-{
-  UNKNOWN_NODE = 0,
-  IN_FILE_HEADER,
-  IN_KEY_HEADER,
-  IN_SUBDIR_HEADER,
-  IN_TOP_DIR_HEADER,
-  IN_STREAMER_INFO,
-  IN_RANDOM_RANGE,
-  IN_STREAM_FILE,
-  IN_HASH_FILE,
-  IN_STREAM_KEY,
-  IN_STREAM_HASH,
-  IN_HASH_KEY,
-  IN_STREAM_STREAMER_INFO,
-  IN_LIST_STREAMER_INFO,
-  PREPARE_TO_QUIT
-};
-
-struct NodeInfo {
-  const char    *label;
-  enum NodeType type;
-};
-
-constexpr NodeInfo nodeSpecs[] = {
-  {"key", IN_KEY_HEADER},
-  {"subdir", IN_SUBDIR_HEADER},
-  {"file", IN_FILE_HEADER},
-  {"topdir", IN_TOP_DIR_HEADER},
-  {"StreamerInfo", IN_STREAMER_INFO},
-  {0, UNKNOWN_NODE}
-};
-
-/** A structure holding the current parsing state.
-
-    - @a buffer pointer to the buffer to be parsed.
-    - @a type   type of the node to be parsed.
-    - @a pos    position of the node inside the buffer.
-    - @a size   dimension of the buffer.
-  */
-struct ParserState {
-  char const    *buffer; 
-  NodeType      type;    
-  size_t        pos;
-  size_t        size;
-};
-
-/** A structure holding the global environment for the parsing
-  
-    - @a fSeekFree Position of the free space inside the buffer.
-  */
-struct ParserContext {
-  size_t        fSeekFree;  
-  int           optMaxLinesInDump;
-};
-
-// The prototype for all the node visiting functions.
-typedef void (*NodeProcessing)(char const * /*buffer*/,
-                               ParserState const &/*current*/,
-                               std::vector<ParserState> &/*states*/,
-                               ParserContext &/*context*/);
-
-constexpr enum NodeType nodeId(const NodeInfo *specs, char const *label)
-{
-  return specs->label == 0            ? UNKNOWN_NODE
-       : !same(specs->label, label)   ? nodeId(specs+1, label)
-       :                                specs->type;
-}
-
-bool
-keyIsA(char const *label, FieldSpec const *spec, char const *buffer)
-{
-  bool result = strncmp(label,  getString(spec, buffer, "Name.value"), (size_t) getChar(spec, buffer, "Name.size")) == 0;
-  return result;
-}
-
-void
-hashKey(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  size_t keyStart = current.pos;
-
-  size_t seekKey = 0;
-  if (getShort(keyHeaderSpec, buffer, "Version") > 1000)
-    seekKey = getInt64(keyHeaderSpec, buffer, "SeekKey");
-  else
-    seekKey = getInt(keyHeaderSpec, buffer, "SeekKey");
-
-  if (seekKey != keyStart)
-  {
-    printf("%lu: not a real key\n", keyStart);
-    dump_hex(buffer, specSize(keyHeaderSpec),(int) keyStart);
-    states.clear();
-    return;
-  }
-
-  // Skipping metadata.
-  if (keyIsA("IdToParameterSetsBlobs",keyHeaderSpec, buffer) 
-      || strncmp("MetaData",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
-      || strncmp("Runs",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
-      || keyIsA("LuminosityBlockAuxiliary", keyHeaderSpec, buffer)
-      || keyIsA("EventAuxiliary", keyHeaderSpec, buffer))
-  {
-    size_t s = getChar(keyHeaderSpec, buffer, "Name.size") + 1; 
-    char buf[s];
-    snprintf(buf, s, "%s", getString(keyHeaderSpec, buffer, "Name.value"));
-    printf("Ignoring %s\n", buf);
-    return;
-  }
-
-  size_t keySize = getShort(keyHeaderSpec, buffer, "KeyLen");
-  unsigned long objSize = getInt(keyHeaderSpec, buffer, "Nbytes")-keySize;
-  unsigned long uncompressedSize = getInt(keyHeaderSpec, buffer, "ObjLen");
-
-  char const*objBuffer = buffer + keySize;
-  char const*output = objBuffer;
-  // FIXME: Find a better way to decide if we need to uncompress buffers.
-  CompressorFunc compressor = getCompressorFor(compressorSpecs, (unsigned char*)objBuffer );
-
-  if (compressor)
-  {
-    output = new char[uncompressedSize];
-    int result = compressor((unsigned char*)output, uncompressedSize, 
-                                  (unsigned char*)objBuffer, objSize);
-    if (result != Z_OK &&  false)
-    {
-      printf("\nError while decompressing object: %s (%i)\n", zError(result), result);
-      return;
-    }
-  }
-
-  unsigned char nameSize = (unsigned char) getChar(keyHeaderSpec, buffer, "Name.size");
-  char s[256];
-  memcpy(s, getString(keyHeaderSpec, buffer, "Name.value"), nameSize);
-  s[nameSize] = 0;
-  printf("Hash for %s: ", s);
-#if __APPLE__ // CommonCrypto
-  unsigned char cc_value[CC_SHA1_DIGEST_LENGTH];
-  CC_SHA1_CTX cc_ctx;
-  CC_SHA1_Init(&cc_ctx);
-  CC_SHA1_Update(&cc_ctx, output, uncompressedSize);
-  CC_SHA1_Final(cc_value, &cc_ctx);
-  for (size_t i = 0; i != CC_SHA1_DIGEST_LENGTH; ++i)
-    printf("%x", cc_value[i]);
-#else // OpenSSL
-  EVP_MD_CTX mdctx;
-  const EVP_MD *md = EVP_sha1();
-  unsigned char md_value[EVP_MAX_MD_SIZE];
-  unsigned int md_len;
-  EVP_MD_CTX_init(&mdctx);
-  EVP_DigestInit_ex(&mdctx, md, NULL);
-  EVP_DigestUpdate(&mdctx, (unsigned char const*)output, uncompressedSize);
-  EVP_DigestFinal_ex(&mdctx, md_value, &md_len);  
-  for (size_t i = 0; i != md_len; ++i)
-    printf("%x", md_value[i]);
-  EVP_MD_CTX_cleanup(&mdctx);
-#endif
-  printf("%s","\n");
-  if (compressor)
-   delete[] output;
-}
-
-void
-streamHash(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  int Nbytes = getInt(keyHeaderSpec, buffer, "Nbytes");
-  if ((current.pos + Nbytes) < context.fSeekFree)
-    states.push_back({0, IN_STREAM_HASH, current.pos + Nbytes});           
-  hashKey(buffer, current, states, context);  
-}
-
-void
-hashFile(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  context.fSeekFree = getInt(fileHeaderSpec, buffer, "fSeekFree");
-  states.push_back({0, IN_STREAM_HASH, (size_t) getInt(fileHeaderSpec, buffer, "fBEGIN")});            
-  //states.push_back({0, IN_STREAM_STREAMER_INFO, getInt(fileHeaderSpec, buffer, "fSeekInfo")});
-}
-
-void
-parseKey(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  size_t keyStart = current.pos;
-
-  size_t seekKey = 0;
-  if (getShort(keyHeaderSpec, buffer, "Version") > 1000)
-    seekKey = getInt64(keyHeaderSpec, buffer, "SeekKey");
-  else
-    seekKey = getInt(keyHeaderSpec, buffer, "SeekKey");
-
-  if (seekKey != keyStart)
-  {
-    printf("%lu: not a real key\n", keyStart);
-    dump_hex(buffer, specSize(keyHeaderSpec),(int) keyStart);
-    states.clear();
-    return;
-  }
-
-  // Skipping metadata.
-  if (keyIsA("IdToParameterSetsBlobs",keyHeaderSpec, buffer) 
-      || strncmp("MetaData",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
-      || strncmp("Runs",  getString(keyHeaderSpec, buffer, "Title.value"), (size_t)getChar(keyHeaderSpec, buffer, "Title.size")) == 0
-      || keyIsA("LuminosityBlockAuxiliary", keyHeaderSpec, buffer)
-      || keyIsA("EventAuxiliary", keyHeaderSpec, buffer))
-  {
-    size_t s = getChar(keyHeaderSpec, buffer, "Name.size") + 1; 
-    char buf[s];
-    snprintf(buf, s, "%s", getString(keyHeaderSpec, buffer, "Name.value"));
-    printf("Ignoring %s\n", buf);
-    return;
-  }
-  size_t keySize = getShort(keyHeaderSpec, buffer, "KeyLen");
-  unsigned long objSize = getInt(keyHeaderSpec, buffer, "Nbytes")-keySize;
-  unsigned long uncompressedSize = getInt(keyHeaderSpec, buffer, "ObjLen");
-
-  size_t keyHeaderSize = specRealSize(keyHeaderSpec, buffer);
-  printf("Key of lenght %lu found:\n", keyHeaderSize);
-  printBuf(keyHeaderSpec, buffer);
-  const size_t objectStart = seekKey + keySize;
-  printf("Object contents (starting at %lu):\n", objectStart);
-  char const*objBuffer = buffer + keySize;
-  char const*output = objBuffer;
-  // FIXME: Find a better way to decide if we need to uncompress buffers.
-  size_t size = objSize;
-  CompressorFunc compressor = getCompressorFor(compressorSpecs, (unsigned char*)objBuffer );
-
-  if (compressor)
-  {
-    output = new char[uncompressedSize];
-    int result = compressor((unsigned char*)output, uncompressedSize, 
-                                  (unsigned char*)objBuffer, objSize);
-    size = uncompressedSize;
-    if (result != Z_OK &&  false)
-    {
-      printf("\nError while decompressing object: %s (%i)\n", zError(result), result);
-      return;
-    }
-  }
-
-  if (keyIsA("FileFormatVersion", keyHeaderSpec, buffer))
-  {
-    printBuf(FileFormatVersionSpec, output);
-  }
-  else
-  {
-    printf("%s","Hash: ");
-#if __APPLE__ // CommonCrypto
-  unsigned char cc_value[CC_SHA1_DIGEST_LENGTH];
-  CC_SHA1_CTX cc_ctx;
-  CC_SHA1_Init(&cc_ctx);
-  CC_SHA1_Update(&cc_ctx, output, uncompressedSize);
-  CC_SHA1_Final(cc_value, &cc_ctx);
-  for (size_t i = 0; i != CC_SHA1_DIGEST_LENGTH; ++i)
-    printf("%x", cc_value[i]);
-#else // OpenSSL
-  EVP_MD_CTX mdctx;
-  const EVP_MD *md = EVP_sha1();
-  unsigned char md_value[EVP_MAX_MD_SIZE];
-  unsigned int md_len;
-  EVP_MD_CTX_init(&mdctx);
-  EVP_DigestInit_ex(&mdctx, md, NULL);
-  EVP_DigestUpdate(&mdctx, (unsigned char const*)output, uncompressedSize);
-  EVP_DigestFinal_ex(&mdctx, md_value, &md_len);  
-  for (size_t i = 0; i != md_len; ++i)
-    printf("%x", md_value[i]);
-  EVP_MD_CTX_cleanup(&mdctx);
-#endif
-    printf("%s","\n");
-    dump_hex(output, size , 0, context.optMaxLinesInDump);
-  }
-  if (compressor)
-   delete[] output;
-}
-
-
-void
-parseSubDir(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &/*context*/)
-{
-  size_t subDirStart = current.pos;
-  if ((size_t) getInt(subDirSpec, buffer, "fSeekDir") != subDirStart)
-  {
-    printf("Malformed subdir at %i.\n", (int)subDirStart);
-    dump_hex(buffer, subDirStart, getInt(subDirSpec, buffer, "fSeekDir"));
-  }    
-  printf("%s","Parsing subdir with contents:\n");
-  dump_hex(buffer, sizeof(buffer), (int) subDirStart);  
-  printBuf(subDirSpec, buffer);
-}
-
-void
-parseTopDir(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &/*context*/)
-{
-  printBuf(topDirSpec, buffer);
-}
-
-void
-parseStreamerInfo(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &/*context*/)
-{
-  printf("---\n");
-  Object aList(TListSpec, buffer);
-  aList.printBuf();
-
-  size_t nObjects = (size_t) aList.getInt("nObjects");
-  Object aClass = aList.next(TClassSpec);
-
-  for (size_t i = 0 ; i < nObjects ; ++i)
-  {
-    aClass.printBuf(2);
-    char const *className = aClass.getString("Name");
-
-    if (strcmp(className, "TStreamerInfo") == 0)
-    {
-      Object aObj =  aClass.next(TStreamerInfoSpec); 
-      aObj.printBuf(2);
-      printf("---\n");
-
-      Object arrayObjClass = aObj.next(TClassSpec);
-      size_t arraySize = (size_t) aObj.getInt("ObjectArray.nObjects");
-      for (size_t j = 0; j < arraySize; ++j)
-      {
-        printf("_--- Element %lu, %s\n", j, arrayObjClass.getString("Name"));
-        char const *arrayObjClassName = arrayObjClass.getString("Name");
-        if (strcmp(arrayObjClassName, "TStreamerBase") == 0)
-        {
-          Object arrayObj = arrayObjClass.next(TStreamerBaseSpec);
-          arrayObj.printBuf(4);
-          arrayObjClass = arrayObj.next(TClassSpec);
-        }
-        else if (strcmp(arrayObjClassName, "TStreamerString") == 0)
-        {
-          Object arrayObj = arrayObjClass.next(TStreamerStringSpec);
-          arrayObj.printBuf(4);
-          arrayObjClass = arrayObj.next(TNamedSpec);
-          arrayObjClass.buffer += 20;
-          arrayObjClass.printBuf(4);
-          arrayObjClass = arrayObjClass.next(TClassSpec);
-          dump_hex(arrayObjClass.buffer, 100, 0);
-        }
-        else
-        {
-          printf("Unknown class %s\n", arrayObjClassName);
-        }
-      }
-    }
-    else
-    {
-      break;
-    }
-    // char const *nch = aObj.nextByte();
-    // int nbig = *nch;
-    // if (*nch == 255)  {
-    //   nbig = bswap_32(*(int *)(nch+1));
-    // }
-    // printf("next at %i\n", nbig);
-    // aClass.buffer = nch + nbig;
-    break;
-  }
-}
-// TODO: decode the TObjArray
-// void
-// parseStreamerInfo(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &/*context*/)
-// {
-//   Object aInfo(StreamerInfoSpec, buffer);
-//   aInfo.printBuf();
-//   Object klass = aInfo.next(TClassSpec);
-//   klass.printBuf();
-//   printf("---\n");
-//   Object aList(TListSpec, buffer);
-//   aList.printBuf();
-
-//   int nObjects = aList.getInt("nObjects");
-//   Object aClass = aList.next(TClassSpec);
-//   for (size_t i = 0 ; i < nObjects ; ++i)
-//   {
-//     aClass.printBuf();
-//     char const *className = aClass.getString("Name");
-//     printf("Reading object %lu at %lx, %s\n", i, (size_t) aClass.buffer, className);
-    
-//     if (strcmp(className, "TStreamerInfo") == 0)
-//     {
-//       Object obj = aClass.next(TStreamerInfoSpec);
-//       obj.printBuf();
-//       int arraySize = obj.getInt("ObjectArray.nObjects");
-//       printf("_-- Object array has %i objects.\n", arraySize);
-//       Object arrayObjClass = obj.next(TClassSpec);
-      
-
-//       for (size_t j = 0; j < arraySize; ++j)
-//       {
-
-//         printf("_--- Element %lu, %s\n", j, arrayObjClass.getString("Name"));
-
-//         // Object obj = arrayObjClass.next(TStreamerBaseSpec);
-//         // obj.printBuf();
-//         // arrayObjClass = obj.next(TClassSpec);
-//         char const *className = arrayObjClass.getString("Name");
-//         if (strcmp(className, "TStreamerBase") == 0)
-//         {
-//             Object arrayObj = arrayObjClass.next(TStreamerBaseSpec);
-//             arrayObj.printBuf();
-//             arrayObjClass = arrayObj.next(TClassSpec);
-//         }
-//         else if (strcmp(className, "TStreamerString") == 0)
-//         {
-//            Object arrayObj = arrayObjClass.next(TStreamerStringSpec);
-//            arrayObj.printBuf();
-//            arrayObjClass = arrayObj.next(TClassSpec);
-//         }
-//         else if (strcmp(className, "TStreamerBasicType") == 0)
-//         {
-//            Object arrayObj = arrayObjClass.next(TStreamerBasicTypeSpec);
-//            arrayObj.printBuf();
-//            arrayObjClass = arrayObj.next(TClassSpec);
-//         }
-//         else
-//         {
-// //          printf("Unknown object %s\n", className);
-//           j--;
-//           arrayObjClass.buffer += 1;
-//         }
-//       }
-//       aClass.buffer = arrayObjClass.nextByte();
-//       dump_hex(aClass.buffer, 200, 0);
-//       // Object streamerBase = obj.next(TStreamerBaseSpec);
-//       // streamerBase.printBuf();
-//       // aClass = streamerBase.next(TClassSpec);
-//     }
-//     else
-//     {
-//       i--;
-//       printf("Unknown object %s\n", className);      
-//       aClass.buffer += 1;
-//     }
-//   }
-
-//   // if (strcmp(infoSpec.getString("Class.Name"), "TStreamerInfo") == 0)
-//   // {
-//   //   Object header = infoSpec.next(TStreamerInfoSpec);
-//   //   header.printBuf();
-//   //   Object klass = header.next(TClassSpec); 
-//   //   dump_hex(klass.buffer, 200, 0);
-//   //   for (size_t i = 0; i < header.getInt("ObjectArray.nObjects"); ++i)
-//   //   {
-//   //     dump_hex(klass.buffer, 200, (size_t)klass.buffer);
-//   //     char const *className = klass.getString("Name");
-//   //     printf("Reading object %lu at %lx, %s\n", i, (size_t) klass.buffer, className);
-//   //     // FIXME: make it a map.
-//   //     if (strcmp(className, "TStreamerBase") == 0)
-//   //     {
-//   //       Object streamerBase = klass.next(TStreamerBaseSpec);
-//   //       streamerBase.printBuf();
-//   //       printf("StreamerElement.Version.value: %i\n", streamerBase.getShort("StreamerElement.Version.value"));
-//   //       klass = streamerBase.next(TClassSpec);
-//   //     }
-//   //     else if (strcmp(className, "TStreamerString") == 0)
-//   //     {
-//   //       Object stringStreamer = klass.next(TStreamerStringSpec);
-//   //       stringStreamer.printBuf();
-//   //       klass = stringStreamer.next(TClassSpec);
-//   //     }
-//   //     else
-//   //     {
-//   //       printf("Reading a generic object\n");
-//   //     }
-//   //   }
-//   //  }
-// }
-
-void
-streamStreamerInfo(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  ParserContext newContext = context;
-  newContext.optMaxLinesInDump = 20;
-  parseKey(buffer, current, states, newContext);
-
-  size_t keySize = getShort(keyHeaderSpec, buffer, "KeyLen");
-  unsigned long objSize = getInt(keyHeaderSpec, buffer, "Nbytes")-keySize;
-  unsigned long uncompressedSize = getInt(keyHeaderSpec, buffer, "ObjLen");
-  char const*objBuffer = buffer + keySize;
-  char const*output = objBuffer;
-  CompressorFunc compressor = getCompressorFor(compressorSpecs, (unsigned char*)objBuffer ); 
-
-  if (compressor)
-  {
-    output = new char[uncompressedSize];
-    int result = compressor((unsigned char*)output, uncompressedSize, 
-                                  (unsigned char*)objBuffer, objSize);
-    if (result != Z_OK &&  false)
-    {
-      printf("\nError while decompressing object: %s (%i)\n", zError(result), result);
-      return;
-    }
-  }
-  // Output now contains a streamer info object.
-  parseStreamerInfo(output, current, states, context);
-}
-
-void
-listStreamerInfo(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  context.fSeekFree = getInt(fileHeaderSpec, buffer, "fSeekFree");
-  states.push_back({0, IN_STREAM_STREAMER_INFO, (size_t) getInt(fileHeaderSpec, buffer, "fSeekInfo")});
-}
-
-void
-parseRandomRange(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &/*context*/)
-{
-  dump_hex(buffer, current.size, 0);
-}
-
-void
-parseFileHeader(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &/*context*/)
-{
-  dump_hex(buffer, specSize(fileHeaderSpec), 0);
-  printBuf(fileHeaderSpec, buffer);
-}
-
-void
-streamFile(char const *buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  printf("Streaming all the keys for the file\n");
-  context.fSeekFree = getInt(fileHeaderSpec, buffer, "fSeekFree");
-  // Get all the streamer infos.
-  states.push_back({0, IN_STREAM_KEY, (size_t) getInt(fileHeaderSpec, buffer, "fBEGIN")});            
-  //states.push_back({0, IN_STREAM_STREAMER_INFO, getInt(fileHeaderSpec, buffer, "fSeekInfo")});
-}
-
-void
-streamKey(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  int Nbytes = getInt(keyHeaderSpec, buffer, "Nbytes");
-  if ((current.pos + Nbytes) < context.fSeekFree)
-    states.push_back({0, IN_STREAM_KEY, current.pos + Nbytes});           
-  ParserContext newContext = context;
-  newContext.optMaxLinesInDump = 10;
-  parseKey(buffer, current, states, newContext);
-}
-
-void
-parseUnknownNode(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  printf("Unknown node.\n");
-  states.clear();
-}
-
-struct NodeProcessingSpec {
-  NodeType        type;
-  NodeProcessing  func;
-};
-
-constexpr NodeProcessing processingFunc(NodeProcessingSpec const*specs, NodeType type)
-{
-  return specs->type == UNKNOWN_NODE    ? specs->func
-       : specs->type == type            ? specs->func
-       :                                  processingFunc(specs + 1, type); 
-}
-
-void
-prepareToQuit(char const*buffer, ParserState const &current, std::vector<ParserState> &states, ParserContext &context)
-{
-  exit(0);
-}
-
-constexpr NodeProcessingSpec processingSpecs[] = {
-  {IN_FILE_HEADER, parseFileHeader},
-  {IN_KEY_HEADER, parseKey},
-  {IN_SUBDIR_HEADER, parseSubDir},
-  {IN_TOP_DIR_HEADER, parseTopDir},
-  {IN_STREAMER_INFO, parseStreamerInfo},
-  {IN_RANDOM_RANGE, parseRandomRange},
-  {IN_STREAM_FILE, streamFile},
-  {IN_STREAM_KEY, streamKey},
-  {IN_HASH_FILE, hashFile},
-  {IN_STREAM_HASH, streamHash},
-  {IN_HASH_KEY, hashKey},
-  {IN_STREAM_STREAMER_INFO, streamStreamerInfo},
-  {IN_LIST_STREAMER_INFO, listStreamerInfo},
-  {PREPARE_TO_QUIT, prepareToQuit},
-  {UNKNOWN_NODE, parseUnknownNode},
-};
 
 enum CommandId {
   COMMAND_NOT_FOUND = 0,
   STREAM_KEYS,
   STREAM_HASHES,
   LIST_STREAMER_INFO,
+  LIST_BRANCH_HASHES,
+  COMPARE_BRANCHES,
+  LIST_STREAM_HASHES,
+  COMPARE_STREAMS,
+  LIST_ENTRY_HASHES,
+  COMPARE_ENTRIES,
+  LIST_EVENTS,
+  FIND_EVENT,
+  LIST_EVENT_HASHES,
+  COMPARE_EVENTS,
+  EXPORT,
+  LIST_HISTOGRAMS,
+  COMPARE_HISTOGRAMS,
+  SUMMARIZE,
+  LIST_MERKLE,
+  COMPARE_MERKLE,
+  LIST_CHUNKS,
+  COMPARE_CHUNKS,
+  LIST_SAMPLE,
+  COMPARE_SAMPLE,
+  CORPUS,
+  QUERY,
+  DISK_USAGE,
+  RECOMPRESS_BENCH,
+  DIFF_OBJECT,
+  COMPARE_META,
+  CANONICALIZE,
+  EXTRACT,
   DUMP_ADDRESS,
   SCAN_RANGE,
   EXAMINE,
+  STATS,
+  TRACE,
   QUIT,
   HELP
 };
@@ -622,8 +60,38 @@ constexpr CommandSpec commandSpecs[] = {
   {"listkeys", STREAM_KEYS, "listkeys"},
   {"listhashes", STREAM_HASHES, "listhashes"},
   {"liststreamerinfo", LIST_STREAMER_INFO, "liststreamerinfo"},
+  {"listbranchhashes", LIST_BRANCH_HASHES, "listbranchhashes [<branch> ...]"},
+  {"comparebranches", COMPARE_BRANCHES, "comparebranches <listbranchhashes-output> [<branch> ...]"},
+  {"liststreamhashes", LIST_STREAM_HASHES, "liststreamhashes [<branch> ...]"},
+  {"comparestreams", COMPARE_STREAMS, "comparestreams <liststreamhashes-output> [<branch> ...]"},
+  {"listentryhashes", LIST_ENTRY_HASHES, "listentryhashes [<branch> ...]"},
+  {"compareentries", COMPARE_ENTRIES, "compareentries <listentryhashes-output> [<branch> ...]"},
+  {"listevents", LIST_EVENTS, "listevents"},
+  {"findevent", FIND_EVENT, "findevent <run>:<lumi>:<event>"},
+  {"listeventhashes", LIST_EVENT_HASHES, "listeventhashes [<branch> ...]"},
+  {"compareevents", COMPARE_EVENTS, "compareevents <listeventhashes-output> [<branch> ...]"},
+  {"export", EXPORT, "export <output-file> <branch>:<type> [<branch>:<type> ...]"},
+  {"listmerkle", LIST_MERKLE, "listmerkle"},
+  {"comparemerkle", COMPARE_MERKLE, "comparemerkle <listmerkle-output>"},
+  {"listchunks", LIST_CHUNKS, "listchunks"},
+  {"comparechunks", COMPARE_CHUNKS, "comparechunks <listchunks-output>"},
+  {"listsample", LIST_SAMPLE, "listsample [seed=<seed>] [budget=<bytes>]"},
+  {"comparesample", COMPARE_SAMPLE, "comparesample <listsample-output>"},
+  {"corpus", CORPUS, "corpus <store> [<other-root-file> ...]"},
+  {"du", DISK_USAGE, "du [verify]"},
+  {"recompress-bench", RECOMPRESS_BENCH, "recompress-bench [budget=<bytes>] [ndjson=<output-file>]"},
+  {"select", QUERY, "select <*|class|name|algorithm> [where <column><op><value> [and ...]] [order by <column> [desc]] [limit <n>]"},
+  {"diffobj", DIFF_OBJECT, "diffobj <offset> <other-offset> [<other-root-file>]"},
+  {"comparemeta", COMPARE_META, "comparemeta <root-file>"},
+  {"canonicalize", CANONICALIZE, "canonicalize <output-file>"},
+  {"extract", EXTRACT, "extract <output-directory> <(offset|name|class=<class>)> [...]"},
+  {"summarize", SUMMARIZE, "summarize <branch>:<type> [<branch>:<type> ...]"},
+  {"listhistograms", LIST_HISTOGRAMS, "listhistograms"},
+  {"comparehistograms", COMPARE_HISTOGRAMS, "comparehistograms <root-file> [abs=<tolerance>] [rel=<tolerance>] [ulps=<tolerance>]"},
   {"scan", SCAN_RANGE, "scan <key|file|subdir> <start-offset>:<end-offset>"},
   {"examine", EXAMINE, "examine <start-offset>:<end-offset>"},
+  {"stats", STATS, "stats"},
+  {"trace", TRACE, "trace <start|stop <output-file>>"},
   {"quit", QUIT, "quit"},
   {"help", HELP, "This help"},
   {0, COMMAND_NOT_FOUND, 0}
@@ -636,6 +104,45 @@ constexpr enum CommandId commandId(const CommandSpec *specs, char const *command
        :                               specs->id;
 }
 
+// Commands working on the baskets of the selected branches.
+// - @a done     the node processing the baskets once they are all collected.
+// - @a argument what the mandatory first argument is, if any.
+// - @a branches whether the command takes a list of branches to work on.
+// - @a required a branch the command needs in any case.
+struct BasketCommandSpec {
+  enum CommandId id;
+  NodeType       done;
+  char const     *argument;
+  bool           branches;
+  char const     *required;
+};
+
+constexpr BasketCommandSpec basketCommandSpecs[] = {
+  {LIST_BRANCH_HASHES, IN_BRANCH_HASH_DONE, 0, true, 0},
+  {COMPARE_BRANCHES, IN_BRANCH_HASH_DONE, "the listing to compare with", true, 0},
+  {LIST_STREAM_HASHES, IN_STREAM_HASH_DONE, 0, true, 0},
+  {COMPARE_STREAMS, IN_STREAM_HASH_DONE, "the listing to compare with", true, 0},
+  {LIST_ENTRY_HASHES, IN_ENTRY_HASH_DONE, 0, true, 0},
+  {COMPARE_ENTRIES, IN_ENTRY_HASH_DONE, "the listing to compare with", true, 0},
+  {LIST_EVENTS, IN_LIST_EVENTS_DONE, 0, false, eventAuxiliaryBranch},
+  {FIND_EVENT, IN_FIND_EVENT_DONE, "the event, as <run>:<lumi>:<event>", false, eventAuxiliaryBranch},
+  {LIST_EVENT_HASHES, IN_EVENT_HASH_DONE, 0, true, eventAuxiliaryBranch},
+  {COMPARE_EVENTS, IN_EVENT_HASH_DONE, "the listing to compare with", true, eventAuxiliaryBranch},
+  {EXPORT, IN_EXPORT_DONE, "the file to export to", true, 0},
+  {SUMMARIZE, IN_SUMMARIZE_DONE, 0, true, 0},
+  {LIST_MERKLE, IN_MERKLE_DONE, 0, false, 0},
+  {COMPARE_MERKLE, IN_MERKLE_DONE, "the listing to compare with", false, 0},
+  {LIST_CHUNKS, IN_CHUNKS_DONE, 0, false, 0},
+  {COMPARE_CHUNKS, IN_CHUNKS_DONE, "the listing to compare with", false, 0},
+  {COMMAND_NOT_FOUND, UNKNOWN_NODE, 0, false, 0}
+};
+
+constexpr BasketCommandSpec const *basketCommand(BasketCommandSpec const *specs, CommandId id)
+{
+  return specs->id == COMMAND_NOT_FOUND || specs->id == id ? specs
+       :                                                     basketCommand(specs + 1, id);
+}
+
 bool parseRange(char const *range, int &begin, int &end)
 {
   char *error;
@@ -671,108 +178,126 @@ bool parseRange(char const *range, int &begin, int &end)
   return true;
 }
 
+// The label of the processing function of each node type, for the stats.
+char const *stageLabels[statsMaxStages];
+
+void
+printStatsAtExit()
+{
+  fflush(stdout);
+  statsWrite(2, stageLabels);
+}
+
+void
+printStatsOnSignal(int)
+{
+  statsWrite(2, stageLabels);
+}
+
+/** Stop tracing and write the events to @a filename.
+    @return false if it could not be written.
+  */
+bool
+writeTrace(char const *filename)
+{
+  traceStop();
+  FILE *out = fopen(filename, "w");
+  if (!out)
+  {
+    printf("Unable to open %s\n", filename);
+    return false;
+  }
+  uint64_t events, dropped;
+  bool written = traceWrite(out, events, dropped);
+  if (fclose(out) != 0 || !written)
+  {
+    printf("Unable to write %s\n", filename);
+    return false;
+  }
+  printf("Trace written to %s: %llu events, %llu dropped.\n", filename, (unsigned long long) events,
+         (unsigned long long) dropped);
+  return true;
+}
+
+char const *optTrace = 0;
+
+void
+writeTraceAtExit()
+{
+  writeTrace(optTrace);
+  fflush(stdout);
+}
+
 int
 main(int argc, char **argv)
 {
   char *optCommand = 0;
+  bool optStats = false;
   int ch;
-  while ( (ch = getopt(argc, argv, "c:")) != -1) {
+  static struct option longOptions[] = {
+    {"stats", no_argument, 0, 's'},
+    {"trace", required_argument, 0, 't'},
+    {0, 0, 0, 0}
+  };
+  while ( (ch = getopt_long(argc, argv, "c:", longOptions, 0)) != -1) {
     switch(ch)
     {
       case 'c':
         optCommand = strdup(optarg);
+        break;
+      case 's':
+        optStats = true;
+        break;
+      case 't':
+        optTrace = strdup(optarg);
     }
   }
 
   if (optind + 1 != argc)
   {
-    printf("Syntax: brut <root-file>\n");     
-    exit(1);
+    printf("Syntax: brut [-c <command>] [--stats] [--trace=<output-file>] <root-file>\n");     
+    return 1;
   }
 
+  for (NodeProcessingSpec const *spec = processingSpecs;; ++spec)
+  {
+    if (spec->type < statsMaxStages)
+      stageLabels[spec->type] = spec->label;
+    if (spec->type == UNKNOWN_NODE)
+      break;
+  }
+  statsCountOutput();
+  if (optStats)
+    atexit(printStatsAtExit);
+  if (optTrace)
+  {
+    atexit(writeTraceAtExit);
+    traceStart();
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = printStatsOnSignal;
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, 0);
+
   int fd = open(argv[optind], O_RDONLY);
   std::vector<ParserState> states;
-  // The idea is to use a sliding mmap window to read the
-  // file rather than fread.
-  // This means that we always try to align the window at
-  constexpr int defaultWindowSize = 1<<24; // 16 MB of read window.
-  constexpr int windowMask = defaultWindowSize-1; // Mask for the read window.
-  off_t windowOffset = 0;
-  int windowSize = defaultWindowSize;
-  char *readWindow = 0;
-  ParserContext context = {0, -1};
+  BasketScan basketScan;
+  KeyCatalog catalog;
+  EventIndex events;
+  ParserContext context = {0, -1, fd, &basketScan, {0, 0, 0}, argv[optind], &catalog, &events, stdout,
+                           {0, 0, defaultWindowSize}, false};
   if (!optCommand)
     printf("%s", "Welcome to Binary Root UTilities shell.\n"
                  "Type \"help\" to list available commands.\n");
 
   while (true)
   {
-    while (!states.empty())
-    {
-      try
-      {
-        // Move to the next node. Obsolete API.
-        ParserState state = states.back();
-        states.pop_back();
-
-        // Update the read window in case its needed.
-        // - If the read window does not exist.
-        // - If the current position is not within the first half of the read 
-        // window, move the read windows so that this is actually the case.
-        int nextWindow = state.pos & (~windowMask);
-        int nextSubwindow = state.pos & (~(windowMask>>1));
-        int currentWindow = (windowOffset & (~windowMask)); 
-        int currentSubwindow = windowOffset & (~(windowMask>>1));
-        constexpr bool debugReads = false;
-        if (debugReads)
-        { 
-          printf("Read requested at position %lu.\n", state.pos);
-          printf("This is inside the window %#x, with subwindow %#x\n", nextWindow, nextSubwindow);
-          if (!readWindow)
-            printf("No current window. Creating it.\n");
-          else if (currentSubwindow == nextSubwindow)
-            printf("Current window at %#x, subwindow %#x. Same subwindow as before, nothing to do.\n", currentWindow, currentSubwindow);
-          else
-            printf("Current window at %#x, subwindow %#x. Different subwindow, moving window to be aligned to it.\n", currentWindow, currentSubwindow);
-        }
-
-        if ((readWindow == 0) || (currentSubwindow != nextSubwindow))
-        {
-          windowOffset = nextSubwindow;
-          int error = 0;
-          if (readWindow)
-            error = munmap(readWindow, windowSize);
-          if (error)
-          {
-            printf("%s", "File error.\n");
-            exit(1);
-          }
-          readWindow = (char*) mmap(0, windowSize, PROT_READ, MAP_SHARED, fd, windowOffset);
-          if (readWindow == MAP_FAILED)
-          {
-            printf("%s", "File error.\n");
-            exit(1);
-          }
-          if (debugReads)
-            printf("Memory window allocated at %p with size %i at offset %p\n", (void *)readWindow, (int) windowSize, (void*) windowOffset);
-        }
-        if (debugReads)
-          printf("Offset in mapped buffer %lu\n", state.pos - windowOffset);
-        char const*readBuffer = state.buffer ? state.buffer 
-                                             : readWindow + state.pos - windowOffset;
-        NodeProcessing func = processingFunc(processingSpecs, state.type);
-        func(readBuffer, state, states, context);
-      }
-      catch(ParseError const&error)
-      {
-        printf("%s:%s\n", error.error_, error.where_);        
-      }
-      catch(char const *str)
-      {
-        printf("%s\n", str);
-      }
-    }
-    while(states.empty())
+    if (!runParser(states, context))
+      return 1;
+    if (context.quit)
+      return 0;
+    while(states.empty() && !context.quit)
     {
       try
       {
@@ -792,14 +317,15 @@ main(int argc, char **argv)
 #else
           printf("> ");
           cp = fgets(stringBuf, 256, stdin); 
-          if (!cp)
-            exit(0);
-          if (cp[strlen(cp)-1] == '\n')
+          if (cp && cp[strlen(cp)-1] == '\n')
             cp[strlen(cp)-1] = 0;
 #endif // __HAVE_READLINE__
         }
         if (!cp)
-          exit(0);
+        {
+          context.quit = true;
+          continue;
+        }
 
         size_t lineSize = strlen(cp) + 1; 
         char forHistory[lineSize];
@@ -833,6 +359,245 @@ main(int argc, char **argv)
             states.push_back({0, IN_LIST_STREAMER_INFO, 0});
             break;
           }          
+          case LIST_BRANCH_HASHES:
+          case COMPARE_BRANCHES:
+          case LIST_STREAM_HASHES:
+          case COMPARE_STREAMS:
+          case LIST_ENTRY_HASHES:
+          case COMPARE_ENTRIES:
+          case LIST_EVENTS:
+          case FIND_EVENT:
+          case LIST_EVENT_HASHES:
+          case COMPARE_EVENTS:
+          case EXPORT:
+          case SUMMARIZE:
+          case LIST_MERKLE:
+          case COMPARE_MERKLE:
+          case LIST_CHUNKS:
+          case COMPARE_CHUNKS:
+          {
+            BasketCommandSpec const *spec = basketCommand(basketCommandSpecs, commandId(commandSpecs, command));
+            basketScan.clear();
+            if (spec->argument)
+            {
+              char *argument = strtok(0, " ");
+              if (!argument)
+              {
+                printf("Please specify %s.\n", spec->argument);
+                break;
+              }
+              basketScan.argument = argument;
+            }
+            while (char *branch = spec->branches ? strtok(0, " ") : 0)
+            {
+              if (char *option = strchr(branch, ':'))
+              {
+                *option = 0;
+                basketScan.options[branch] = option + 1;
+              }
+              basketScan.selection.push_back(branch);
+            }
+            // An empty selection means all the branches.
+            if (spec->required && (!spec->branches || !basketScan.selection.empty()))
+              basketScan.selection.push_back(spec->required);
+            states.push_back({0, spec->done, 0});
+            states.push_back({0, IN_SCAN_BASKETS, 0});
+            break;
+          }
+          case LIST_HISTOGRAMS:
+          case COMPARE_HISTOGRAMS:
+          {
+            basketScan.clear();
+            Tolerance tolerance = {0, 0, 0};
+            if (commandId(commandSpecs, command) == COMPARE_HISTOGRAMS)
+            {
+              char *reference = strtok(0, " ");
+              if (!reference)
+              {
+                printf("Please specify the file to compare with.\n");
+                break;
+              }
+              basketScan.argument = reference;
+            }
+            bool valid = true;
+            while (char *option = strtok(0, " "))
+            {
+              char *value = strchr(option, '=');
+              char *error = 0;
+              if (value && strncmp(option, "abs=", 4) == 0)
+                tolerance.absolute = strtod(value + 1, &error);
+              else if (value && strncmp(option, "rel=", 4) == 0)
+                tolerance.relative = strtod(value + 1, &error);
+              else if (value && strncmp(option, "ulps=", 5) == 0)
+                tolerance.ulps = strtoull(value + 1, &error, 10);
+              if (!error || *error || error == value + 1)
+              {
+                printf("Wrong tolerance %s, expecting abs=, rel= or ulps=.\n", option);
+                valid = false;
+                break;
+              }
+            }
+            if (!valid)
+              break;
+            context.tolerance = tolerance;
+            states.push_back({0, IN_HISTOGRAMS_DONE, 0});
+            break;
+          }
+          case LIST_SAMPLE:
+          case COMPARE_SAMPLE:
+          {
+            basketScan.clear();
+            if (commandId(commandSpecs, command) == COMPARE_SAMPLE)
+            {
+              char *reference = strtok(0, " ");
+              if (!reference)
+              {
+                printf("Please specify the listing to compare with.\n");
+                break;
+              }
+              basketScan.argument = reference;
+            }
+            bool valid = true;
+            while (char *option = strtok(0, " "))
+            {
+              char *value = strchr(option, '=');
+              char *error = 0;
+              if (value && (strncmp(option, "seed=", 5) == 0 || strncmp(option, "budget=", 7) == 0))
+                strtoull(value + 1, &error, 10);
+              if (!error || *error || error == value + 1 || !basketScan.argument.empty())
+              {
+                printf("Wrong option %s, expecting seed= or budget=.\n", option);
+                valid = false;
+                break;
+              }
+              basketScan.options[std::string(option, value - option)] = value + 1;
+            }
+            if (!valid)
+              break;
+            states.push_back({0, IN_SAMPLE_DONE, 0});
+            break;
+          }
+          case CORPUS:
+          {
+            char *store = strtok(0, " ");
+            basketScan.clear();
+            if (!store)
+            {
+              printf("Please specify the store.\n");
+              break;
+            }
+            basketScan.argument = store;
+            while (char *file = strtok(0, " "))
+              basketScan.selection.push_back(file);
+            states.push_back({0, IN_CORPUS_DONE, 0});
+            break;
+          }
+          case QUERY:
+          {
+            basketScan.clear();
+            while (char *token = strtok(0, " "))
+              basketScan.selection.push_back(token);
+            states.push_back({0, IN_QUERY_DONE, 0});
+            break;
+          }
+          case DISK_USAGE:
+          {
+            char *verify = strtok(0, " ");
+            basketScan.clear();
+            if (verify && strcmp(verify, "verify") != 0)
+            {
+              printf("Wrong option %s, expecting verify.\n", verify);
+              break;
+            }
+            if (verify)
+              basketScan.argument = verify;
+            states.push_back({0, IN_DU_DONE, 0});
+            break;
+          }
+          case RECOMPRESS_BENCH:
+          {
+            basketScan.clear();
+            bool valid = true;
+            while (char *option = strtok(0, " "))
+            {
+              char *value = strchr(option, '=');
+              char *error = 0;
+              if (value && strncmp(option, "budget=", 7) == 0)
+                strtoull(value + 1, &error, 10);
+              else if (value && strncmp(option, "ndjson=", 7) == 0 && value[1])
+                error = value + strlen(value);
+              if (!error || *error || error == value + 1)
+              {
+                printf("Wrong option %s, expecting budget= or ndjson=.\n", option);
+                valid = false;
+                break;
+              }
+              basketScan.options[std::string(option, value - option)] = value + 1;
+            }
+            if (!valid)
+              break;
+            states.push_back({0, IN_RECOMPRESS_BENCH_DONE, 0});
+            break;
+          }
+          case DIFF_OBJECT:
+          {
+            char *first = strtok(0, " ");
+            char *second = first ? strtok(0, " ") : 0;
+            char *error = 0;
+            size_t offset = first ? strtoul(first, &error, 10) : 0;
+            size_t otherOffset = second && !*error ? strtoul(second, &error, 10) : 0;
+            if (!second || *error)
+            {
+              printf("Please specify the offsets of the two keys.\n");
+              break;
+            }
+            basketScan.clear();
+            if (char *other = strtok(0, " "))
+              basketScan.argument = other;
+            states.push_back({0, IN_DIFF_OBJECT_DONE, offset, otherOffset});
+            break;
+          }
+          case COMPARE_META:
+          {
+            char *reference = strtok(0, " ");
+            if (!reference)
+            {
+              printf("Please specify the file to compare with.\n");
+              break;
+            }
+            basketScan.clear();
+            basketScan.argument = reference;
+            states.push_back({0, IN_COMPARE_META_DONE, 0});
+            break;
+          }
+          case CANONICALIZE:
+          {
+            char *output = strtok(0, " ");
+            if (!output)
+            {
+              printf("Please specify the file to write to.\n");
+              break;
+            }
+            basketScan.clear();
+            basketScan.argument = output;
+            states.push_back({0, IN_CANONICALIZE_DONE, 0});
+            break;
+          }
+          case EXTRACT:
+          {
+            char *output = strtok(0, " ");
+            basketScan.clear();
+            while (char *selector = output ? strtok(0, " ") : 0)
+              basketScan.selection.push_back(selector);
+            if (basketScan.selection.empty())
+            {
+              printf("Please specify the directory to write to and the objects to extract.\n");
+              break;
+            }
+            basketScan.argument = output;
+            states.push_back({0, IN_EXTRACT_DONE, 0});
+            break;
+          }
           case DUMP_ADDRESS:
           {
             char *type = strtok(0, " ");
@@ -884,8 +649,32 @@ main(int argc, char **argv)
             }
             break;
           }
+          case STATS:
+          {
+            StatsSnapshot snapshot;
+            char buffer[8192];
+            statsSnapshot(snapshot);
+            statsFormat(snapshot, stageLabels, buffer, sizeof(buffer));
+            fputs(buffer, stdout);
+            break;
+          }
+          case TRACE:
+          {
+            char const *action = strtok(0, " ");
+            char const *output = strtok(0, " ");
+            if (action && strcmp(action, "start") == 0 && !output)
+            {
+              traceStart();
+              printf("Tracing.\n");
+            }
+            else if (action && strcmp(action, "stop") == 0 && output)
+              writeTrace(output);
+            else
+              printf("Syntax: trace <start|stop <output-file>>\n");
+            break;
+          }
           case QUIT:
-            exit(0);
+            context.quit = true;
           break;
         }
 #ifdef __HAVE_READLINE__
@@ -0,0 +1,105 @@
+#include "GeneratorHelpers.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/** Write a synthetic ROOT file, see GeneratorHelpers.h, and its golden
+    manifest: the Merkle tree of its objects, in the format of listmerkle,
+    so that "comparemerkle <manifest>" checks that brut reads it right.
+
+        brut_gen [keys=<n>] [size=<bytes>] [min=<bytes>] [max=<bytes>]
+                 [baskets=<fraction>] [branches=<n>] [zlib=<fraction>]
+                 [lzma=<fraction>] [level=<n>] [chunk=<bytes>] [big]
+                 [seed=<n>] <output> [<manifest>]
+
+    The manifest defaults to "<output>.merkle".
+  */
+void usage()
+{
+  fprintf(stderr, "Syntax: brut_gen [keys=<n>] [size=<bytes>] [min=<bytes>] [max=<bytes>] "
+                  "[baskets=<fraction>] [branches=<n>] [zlib=<fraction>] [lzma=<fraction>] "
+                  "[level=<n>] [chunk=<bytes>] [big] [seed=<n>] <output> [<manifest>]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  GeneratorOptions options = generatorDefaults;
+  std::string output;
+  std::string manifest;
+  for (int i = 1; i < argc; ++i)
+  {
+    char const *arg = argv[i];
+    char const *equal = strchr(arg, '=');
+    char const *value = equal ? equal + 1 : "";
+    std::string option(arg, equal ? value - arg : 0);
+    if (option == "keys=")
+      options.keys = strtoull(value, 0, 10);
+    else if (option == "size=")
+      options.size = strtoull(value, 0, 10);
+    else if (option == "min=")
+      options.minSize = strtoull(value, 0, 10);
+    else if (option == "max=")
+      options.maxSize = strtoull(value, 0, 10);
+    else if (option == "baskets=")
+      options.baskets = atof(value);
+    else if (option == "branches=")
+      options.branches = strtoul(value, 0, 10);
+    else if (option == "zlib=")
+      options.zlib = atof(value);
+    else if (option == "lzma=")
+      options.lzma = atof(value);
+    else if (option == "level=")
+      options.level = atoi(value);
+    else if (option == "chunk=")
+      options.chunk = strtoull(value, 0, 10);
+    else if (option == "seed=")
+      options.seed = strtoull(value, 0, 10);
+    else if (strcmp(arg, "big") == 0)
+      options.big = true;
+    else if (output.empty() && !equal)
+      output = arg;
+    else if (manifest.empty() && !equal)
+      manifest = arg;
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+  if (output.empty())
+  {
+    usage();
+    return 1;
+  }
+  if (!options.minSize || options.maxSize < options.minSize || !options.chunk || options.chunk > generatorMaxChunk)
+  {
+    fprintf(stderr, "Object sizes must be 0 < min <= max, and chunks 0 < chunk <= %lu.\n",
+            (unsigned long) generatorMaxChunk);
+    return 1;
+  }
+  if (manifest.empty())
+    manifest = output + ".merkle";
+
+  MerkleTree tree;
+  if (!generateFile(output.c_str(), options, tree))
+  {
+    fprintf(stderr, "Unable to write %s: %s\n", output.c_str(), strerror(errno));
+    return 1;
+  }
+  FILE *f = fopen(manifest.c_str(), "w");
+  if (!f)
+  {
+    fprintf(stderr, "Unable to write %s: %s\n", manifest.c_str(), strerror(errno));
+    return 1;
+  }
+  tree.print(merkleRoot, f);
+  if (fclose(f) != 0)
+  {
+    fprintf(stderr, "Unable to write %s\n", manifest.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include "BasketHelpers.h"
+#include <vector>
+
+// A TBasket key for branch "br" of tree "Events" at offset 100, with 3
+// entries, whose payload is 40 bytes of data followed by the offsets array.
+constexpr char basketKey[] = {
+  0, 0, 0, 123,           // Nbytes
+  0, 4,                   // Version
+  0, 0, 0, 60,            // ObjLen
+  0, 0, 0, 0,             // Datetime
+  0, 63,                  // KeyLen
+  0, 1,                   // Cycle
+  0, 0, 0, 100,           // SeekKey
+  0, 0, 0, 0,             // SeekPdir
+  7, 'T', 'B', 'a', 's', 'k', 'e', 't',
+  2, 'b', 'r',
+  6, 'E', 'v', 'e', 'n', 't', 's',
+  0, 2,                   // Version
+  0, 0, 0x7d, 0,          // fBufferSize
+  0, 0, 0, 0,             // fNevBufSize
+  0, 0, 0, 3,             // fNevBuf
+  0, 0, 0, 103,           // fLast
+  0                       // flag
+};
+
+// Compress @a size bytes of @a data as a single ROOT zlib chunk.
+void appendChunk(std::vector<unsigned char> &out, unsigned char const *data, size_t size)
+{
+  uLongf zipSize = compressBound(size);
+  std::vector<unsigned char> zip(zipSize);
+  assert(compress(&zip[0], &zipSize, data, size) == Z_OK);
+  unsigned char header[9] = {'Z', 'L', Z_DEFLATED,
+                             (unsigned char) zipSize, (unsigned char)(zipSize >> 8), (unsigned char)(zipSize >> 16),
+                             (unsigned char) size, (unsigned char)(size >> 8), (unsigned char)(size >> 16)};
+  out.insert(out.end(), header, header + 9);
+  out.insert(out.end(), zip.begin(), zip.begin() + zipSize);
+}
+
+int
+main(int argc, char **argv)
+{
+  assert(keyClassIs("TBasket", basketKey));
+  assert(keyString(basketKey, "Name") == "br");
+  assert(keyString(basketKey, "Title") == "Events");
+  assert(basketHeader(basketKey) == basketKey + 44);
+
+  BasketScan scan;
+  assert(addBasket(scan, basketKey, 100));
+  assert(scan.branches.size() == 1 && scan.branches[0] == "Events/br");
+  BasketInfo const &basket = scan.baskets[0];
+  assert(basket.seekKey == 100);
+  assert(basket.nbytes == 123);
+  assert(basket.objLen == 60);
+  assert(basket.keyLen == 63);
+  assert(basket.nevBuf == 3);
+  assert(basket.nevBufSize == 0);
+  assert(basketDataSize(basket) == 40);
+
+  // 40 bytes of entries data followed by the offsets array.
+  char payload[60] = {0};
+  char const offsets[] = {0, 0, 0, 4, 0, 0, 0, 63, 0, 0, 0, 73, 0, 0, 0, 93, 0, 0, 0, 0};
+  memcpy(payload + 40, offsets, sizeof(offsets));
+  std::vector<std::pair<size_t, size_t> > entries;
+  assert(basketEntries(basket, payload, entries));
+  assert(entries.size() == 3);
+  assert(entries[0] == std::make_pair((size_t) 0, (size_t) 10));
+  assert(entries[1] == std::make_pair((size_t) 10, (size_t) 30));
+  assert(entries[2] == std::make_pair((size_t) 30, (size_t) 40));
+  payload[51] = 10;
+  assert(!basketEntries(basket, payload, entries));
+
+  // Fixed size entries have no offsets array.
+  BasketInfo fixed = basket;
+  fixed.objLen = 40;
+  fixed.nevBuf = 10;
+  fixed.nevBufSize = 4;
+  assert(basketEntries(fixed, payload, entries));
+  assert(entries.size() == 10);
+  assert(entries[9] == std::make_pair((size_t) 36, (size_t) 40));
+
+  scan.clear();
+  scan.selection.push_back("Events/other");
+  assert(!addBasket(scan, basketKey, 100));
+  scan.selection.push_back("br");
+  assert(addBasket(scan, basketKey, 100));
+
+  // Objects bigger than a chunk are compressed in many chunks.
+  unsigned char data[1000];
+  for (size_t i = 0; i < sizeof(data); ++i)
+    data[i] = i % 7;
+  std::vector<unsigned char> zipped;
+  appendChunk(zipped, data, 600);
+  appendChunk(zipped, data + 600, 400);
+  unsigned char output[1000];
+  assert(uncompressObject(output, sizeof(output), &zipped[0], zipped.size()) == 0);
+  assert(memcmp(output, data, sizeof(data)) == 0);
+  assert(uncompressObject(output, sizeof(output), &zipped[0], zipped.size() - 1) != 0);
+}
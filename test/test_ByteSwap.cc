@@ -0,0 +1,96 @@
+#include "ByteSwapHelpers.h"
+#include "ROOTSchema.h"
+#include <vector>
+
+// Check the kernels of @a level against the scalar ones, for all sizes up
+// to a few vectors and for unaligned source and destination.
+void checkKernels(SimdLevel level)
+{
+  ByteSwapKernels kernels = byteSwapKernels(level);
+  ByteSwapKernels scalar = byteSwapKernels(SIMD_SCALAR);
+  unsigned char src[1024 + 8];
+  for (size_t i = 0; i < sizeof(src); ++i)
+    src[i] = i * 7 + 3;
+  unsigned char expected[1024 + 8];
+  unsigned char result[1024 + 8];
+  for (size_t size = 2; size <= 8; size *= 2)
+  {
+    ByteSwapKernel kernel = size == 2 ? kernels.swap16 : size == 4 ? kernels.swap32 : kernels.swap64;
+    ByteSwapKernel reference = size == 2 ? scalar.swap16 : size == 4 ? scalar.swap32 : scalar.swap64;
+    for (size_t count = 0; count < 1024 / size; count += 1 + count / 8)
+    {
+      for (size_t offset = 0; offset < 4; ++offset)
+      {
+        memset(expected, 0, sizeof(expected));
+        memset(result, 0, sizeof(result));
+        reference(expected + offset, src + 3, count);
+        kernel(result + offset, src + 3, count);
+        assert(memcmp(expected, result, sizeof(result)) == 0);
+        // In place.
+        memcpy(result + offset, src + 3, count * size);
+        kernel(result + offset, result + offset, count);
+        assert(memcmp(expected + offset, result + offset, count * size) == 0);
+      }
+    }
+  }
+}
+
+// A TArrayF of 3 values, then a TArrayD of 2.
+constexpr char arrays[] = {
+  0, 0, 0, 3,
+  0x3f, (char) 0x80, 0, 0,    // 1.
+  0x40, 0, 0, 0,              // 2.
+  (char) 0xc0, 0x40, 0, 0,    // -3.
+  0, 0, 0, 2,
+  0x3f, (char) 0xf0, 0, 0, 0, 0, 0, 0,   // 1.
+  0x40, 0x24, 0, 0, 0, 0, 0, 0           // 10.
+};
+
+int
+main(int argc, char **argv)
+{
+  assert(byteSwapKernels(SIMD_SCALAR).level == SIMD_SCALAR);
+  for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+    checkKernels((SimdLevel) level);
+
+  float floats[3];
+  assert(getArraySize(ArrayFSpec, arrays, "") == 3);
+  size_t count = getArray(ArrayFSpec, arrays, "", floats, 3);
+  assert(count == 3);
+  assert(floats[0] == 1.f && floats[1] == 2.f && floats[2] == -3.f);
+  // The specs know the size of the values, so they can walk the arrays.
+  assert(specRealSize(ArrayFSpec, arrays) == 16);
+  char const *second = next(ArrayFSpec, arrays);
+  assert(second == arrays + 16);
+  assert(next(ArrayDSpec, second) == arrays + sizeof(arrays));
+  double doubles[2];
+  count = getArray(ArrayDSpec, second, "", doubles, 2);
+  assert(count == 2);
+  assert(doubles[0] == 1. && doubles[1] == 10.);
+
+  // A TArrayS of 2 values, a TArrayL64 of 1, and an empty TArrayC.
+  char const moreArrays[] = {0, 0, 0, 2, 0x12, 0x34, (char) 0xff, (char) 0xfe,
+                             0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0x01, 0x00,
+                             0, 0, 0, 0};
+  assert(next(ArraySSpec, moreArrays) == moreArrays + 8);
+  assert(next(ArrayL64Spec, moreArrays + 8) == moreArrays + 20);
+  assert(next(ArrayCSpec, moreArrays + 20) == moreArrays + sizeof(moreArrays));
+  int64_t longs[1];
+  count = getArray(ArrayL64Spec, moreArrays + 8, "", longs, 1);
+  assert(count == 1 && longs[0] == 256);
+  bool thrown = false;
+  try
+  {
+    getArray(ArrayFSpec, arrays, "", floats, 2);
+  }
+  catch (char const *)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  int16_t shorts[2];
+  char const shortData[] = {0x12, 0x34, (char) 0xff, (char) 0xfe};
+  decodeBigEndian(shortData, 2, shorts);
+  assert(shorts[0] == 0x1234 && shorts[1] == -2);
+}
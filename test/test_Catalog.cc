@@ -0,0 +1,61 @@
+#include "CatalogHelpers.h"
+#include <cassert>
+#include <vector>
+
+int
+main(int argc, char **argv)
+{
+  // Values around the sign bit, which AVX2 compares as signed.
+  std::vector<uint64_t> values;
+  uint64_t state = 1;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    values.push_back(i % 3 ? state : i % 2 ? 1ULL << 63 : 42);
+  }
+  uint64_t const pivots[] = {0, 42, 1ULL << 63, ~0ULL, values[500]};
+  for (size_t n = 0; n <= values.size(); n += 333)
+    for (size_t p = 0; p < 5; ++p)
+      for (int op = OP_EQ; op <= OP_GE; ++op)
+      {
+        std::vector<uint64_t> expected((n + 63) / 64 + 1, ~0ULL);
+        filterScalar(&values[0], n, (CompareOp) op, pivots[p], &expected[0]);
+        for (size_t i = 0; i < n; ++i)
+          assert(((expected[i / 64] >> (i % 64)) & 1) == compareValue(values[i], (CompareOp) op, pivots[p]));
+        for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+        {
+          std::vector<uint64_t> selected((n + 63) / 64 + 1, ~0ULL);
+          filterKernel((SimdLevel) level)(&values[0], n, (CompareOp) op, pivots[p], &selected[0]);
+          assert(selected == expected);
+        }
+      }
+
+  KeyCatalog catalog;
+  for (unsigned i = 0; i < 100; ++i)
+  {
+    KeyInfo key = {100 + i * 1000, 0, 1000, i * 100, 64, 1, i % 10 ? "TBasket" : "TTree", "events", "", {'Z', 'L', 8}};
+    catalog.add(key);
+  }
+  char const *tokens[] = {"*", "where", "class=TBasket", "and", "objlen>=5k", "order", "by", "objlen", "desc", "limit", "3"};
+  CatalogQuery query;
+  bool parsed = parseQuery(catalog, std::vector<std::string>(tokens, tokens + 11), query);
+  assert(parsed);
+  assert(query.group == CATALOG_COLUMNS && query.where.size() == 2 && query.limit == 3 && query.descending);
+  std::vector<uint64_t> selected;
+  selectKeys(catalog, query.where, selected);
+  std::vector<size_t> keys;
+  selectedKeys(selected, keys);
+  assert(keys.size() == 44);
+
+  char const *grouped[] = {"class", "where", "algorithm=ZL"};
+  parsed = parseQuery(catalog, std::vector<std::string>(grouped, grouped + 3), query);
+  assert(parsed);
+  selectKeys(catalog, query.where, selected);
+  std::vector<CatalogGroup> groups;
+  groupKeys(catalog, selected, query.group, groups);
+  assert(groups.size() == 2 && groups[0].keys + groups[1].keys == 100);
+
+  char const *wrong[] = {"*", "where", "class>TBasket"};
+  parsed = parseQuery(catalog, std::vector<std::string>(wrong, wrong + 3), query);
+  assert(!parsed);
+}
@@ -0,0 +1,75 @@
+#include "ChunkHelpers.h"
+#include <cassert>
+#include <vector>
+
+int
+main(int argc, char **argv)
+{
+  std::vector<char> data(3 << 20);
+  uint64_t state = 1;
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    data[i] = state >> 56;
+  }
+
+  // All the kernels find the same candidates.
+  std::vector<size_t> scalar;
+  gearCandidatesScalar((unsigned char const *) &data[0], 0, data.size(), chunkMask, scalar);
+  assert(!scalar.empty());
+  for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+  {
+    std::vector<size_t> candidates;
+    gearKernel((SimdLevel) level)((unsigned char const *) &data[0], 0, data.size(), chunkMask, candidates);
+    assert(candidates == scalar);
+  }
+
+  std::vector<Chunk> chunks;
+  chunkObject(&data[0], data.size(), chunks);
+  assert(chunks.size() > 1);
+  assert(chunks.back().offset + chunks.back().size == data.size());
+  for (size_t i = 0; i < chunks.size(); ++i)
+    assert(chunks[i].size <= chunkMaxSize && (chunks[i].size >= chunkMinSize || i + 1 == chunks.size()));
+
+  // The chunks are cut at the boundaries, whatever the pieces the object is
+  // given in, down to single bytes.
+  std::vector<size_t> ends;
+  chunkBoundaries(&data[0], data.size(), ends);
+  assert(ends.size() == chunks.size());
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    assert(chunks[i].offset + chunks[i].size == ends[i]);
+    unsigned char digest[SHA1_SIZE];
+    sha1(&data[chunks[i].offset], chunks[i].size, digest);
+    assert(chunks[i].digest == digestToHex(digest));
+  }
+  size_t const pieceSizes[] = {1, 63, 64, 65, 4096, 100003};
+  for (size_t p = 0; p < sizeof(pieceSizes) / sizeof(pieceSizes[0]); ++p)
+  {
+    std::vector<Chunk> streamed;
+    ChunkStream stream(streamed);
+    for (size_t done = 0; done < data.size(); done += pieceSizes[p])
+      stream.update(&data[done], std::min(pieceSizes[p], data.size() - done));
+    stream.finish();
+    assert(streamed.size() == chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i)
+      assert(streamed[i].offset == chunks[i].offset && streamed[i].size == chunks[i].size
+             && streamed[i].digest == chunks[i].digest);
+  }
+
+  // Insert a few bytes in the middle: only the chunks around them change.
+  std::vector<char> modified(data);
+  size_t where = data.size() / 2;
+  modified.insert(modified.begin() + where, 10, 'x');
+  std::vector<Chunk> modifiedChunks;
+  chunkObject(&modified[0], modified.size(), modifiedChunks);
+  std::vector<std::pair<size_t, size_t> > ranges;
+  differingRanges(modifiedChunks, chunks, ranges);
+  assert(ranges.size() == 1);
+  assert(ranges[0].first <= where && ranges[0].second >= where + 10);
+  assert(ranges[0].second - ranges[0].first <= 2 * chunkMaxSize);
+
+  ranges.clear();
+  differingRanges(chunks, chunks, ranges);
+  assert(ranges.empty());
+}
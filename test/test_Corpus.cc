@@ -0,0 +1,98 @@
+#include "CorpusHelpers.h"
+#include <cassert>
+#include <cstdlib>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+int
+main(int argc, char **argv)
+{
+  char path[] = "/tmp/test_CorpusXXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  // Enough objects for the table to grow a few times, each added twice.
+  size_t const objects = 4 * corpusInitialCapacity;
+  {
+    CorpusStore store;
+    bool opened = store.open(path);
+    assert(opened);
+    for (int copy = 0; copy < 2; ++copy)
+      for (uint64_t i = 0; i < objects; ++i)
+      {
+        unsigned char digest[SHA1_SIZE] = {0};
+        uint64_t value = i * 0x9E3779B97F4A7C15ULL;
+        memcpy(digest, &value, sizeof(value));
+        CorpusEntry *entry = store.insert(digest, copy, i, i % 1000);
+        assert(entry && entry->refs == copy + 1u && entry->file == 0 && entry->offset == i);
+      }
+    assert(store.header().used == objects);
+    assert(store.header().capacity >= objects * 4 / 3);
+  }
+
+  // The store is found again when reopened.
+  CorpusStore store;
+  bool opened = store.open(path);
+  assert(opened);
+  assert(store.header().used == objects);
+  unsigned char digest[SHA1_SIZE] = {0};
+  uint64_t value = 12345 * 0x9E3779B97F4A7C15ULL;
+  memcpy(digest, &value, sizeof(value));
+  assert(store.slot(digest)->refs == 2 && store.slot(digest)->size == 345);
+
+  // Objects taken back in the reverse order leave the table as it was.
+  bool reserved = store.reserve(16);
+  assert(reserved);
+  std::vector<char> before(store.map, store.map + store.mapSize);
+  std::vector<uint64_t> values;
+  for (uint64_t i = objects - 8; i < objects + 8; ++i)
+    values.push_back(i * 0x9E3779B97F4A7C15ULL);
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    memcpy(digest, &values[i], sizeof(values[i]));
+    CorpusEntry *entry = store.insert(digest, 1, i, 1);
+    assert(entry);
+  }
+  assert(store.header().used == objects + 8);
+  for (size_t i = values.size(); i-- > 0;)
+  {
+    memcpy(digest, &values[i], sizeof(values[i]));
+    store.release(digest);
+  }
+  assert(memcmp(store.map, before.data(), before.size()) == 0);
+
+  // A table which cannot grow is left as it was.
+  std::string grown = std::string(path) + ".grow";
+  int made = mkdir(grown.c_str(), 0755);
+  assert(made == 0);
+  uint64_t capacity = store.header().capacity;
+  uint64_t added = 0;
+  for (uint64_t i = objects;; ++i)
+  {
+    value = i * 0x9E3779B97F4A7C15ULL;
+    memcpy(digest, &value, sizeof(value));
+    if (!store.insert(digest, 1, i, 1))
+      break;
+    ++added;
+  }
+  assert(added > 0 && store.header().capacity == capacity);
+  store.close();
+  rmdir(grown.c_str());
+  opened = store.open(path);
+  assert(opened);
+  assert(store.header().used == objects + added && store.header().capacity == capacity);
+  value = 12345 * 0x9E3779B97F4A7C15ULL;
+  memcpy(digest, &value, sizeof(value));
+  assert(store.slot(digest)->refs == 2 && store.slot(digest)->size == 345);
+  store.close();
+
+  // Anything else is not a store.
+  FILE *f = fopen(path, "w");
+  fprintf(f, "not a store");
+  fclose(f);
+  opened = store.open(path);
+  assert(!opened);
+  unlink(path);
+}
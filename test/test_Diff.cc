@@ -0,0 +1,79 @@
+#include "DiffHelpers.h"
+#include "LayoutHelpers.h"
+#include "MetaHelpers.h"
+#include "ROOTSchema.h"
+#include <cassert>
+#include <vector>
+
+int
+main(int argc, char **argv)
+{
+  std::vector<char> a(1000), b;
+  for (size_t i = 0; i < a.size(); ++i)
+    a[i] = i * 7;
+  b = a;
+
+  // All the kernels find the same mismatches, wherever they are.
+  for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+  {
+    MismatchKernel kernel = mismatchKernel((SimdLevel) level);
+    assert(kernel(&a[0], &b[0], 0, a.size()) == a.size());
+    for (size_t pos = 0; pos < a.size(); pos += 37)
+    {
+      b[pos] ^= 1;
+      assert(kernel(&a[0], &b[0], 0, a.size()) == pos);
+      assert(kernel(&a[0], &b[0], pos + 1, a.size()) == a.size());
+      assert(kernel(&a[0], &b[0], 0, pos) == pos);
+      b[pos] ^= 1;
+    }
+  }
+
+  // Differences are reported in whole lines, consecutive ones merged.
+  b[5] = 1;
+  b[20] = 1;
+  b[100] = 1;
+  b[999] = 1;
+  std::vector<DiffRange> ranges;
+  diffRanges(&a[0], &b[0], a.size(), ranges);
+  assert(ranges.size() == 3);
+  assert(ranges[0].begin == 0 && ranges[0].end == 32);
+  assert(ranges[1].begin == 96 && ranges[1].end == 112);
+  assert(ranges[2].begin == 992 && ranges[2].end == 1000);
+
+  // A version 4 key header, with 32 bits seeks.
+  char key[] = "\0\0\0\x80" "\0\x04" "\0\0\0\x50" "\0\0\0\0" "\0\x2a" "\0\x01"
+               "\0\0\0\x64" "\0\0\0\0" "\x04TKey" "\x02" "ab" "\0";
+  std::vector<FieldLayout> fields;
+  size_t size = specLayout(keyHeaderSpec, key, sizeof(key) - 1, fields);
+  assert(size == sizeof(key) - 1);
+  assert(fields.size() == 13);
+  assert(fields[6].name == "SeekKey" && fields[6].offset == 18 && fields[6].size == 4);
+  assert(fields[8].name == "ClassName.size" && fields[8].offset == 26);
+  assert(fields[9].name == "ClassName.value" && fields[9].size == 4);
+  assert(formatField(fields[6], key) == "100");
+  assert(formatField(fields[9], key) == "\"TKey\"");
+  assert(fields[11].name == "Name.value" && formatField(fields[11], key) == "\"ab\"");
+
+  // The key Datetime is MUTABLE, so changing it does not matter.
+  char otherKey[sizeof(key)];
+  memcpy(otherKey, key, sizeof(key));
+  otherKey[12] = 0x7f;
+  MetaRecords records;
+  for (int i = 0; i < 5; ++i)
+    records.add("key", key, otherKey, sizeof(key) - 1, fields);
+  std::vector<size_t> differ;
+  for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+  {
+    records.compare(differ, maskedMismatchKernel((SimdLevel) level));
+    assert(differ.empty());
+  }
+  // Anything else does.
+  records.b[records.records[1].offset + 19] = 1;
+  records.b[records.records[3].offset + 30] = 'x';
+  for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+  {
+    differ.clear();
+    records.compare(differ, maskedMismatchKernel((SimdLevel) level));
+    assert(differ.size() == 2 && differ[0] == 1 && differ[1] == 3);
+  }
+}
@@ -0,0 +1,41 @@
+#include "EventHelpers.h"
+
+// A streamed edm::EventAuxiliary (version 11) for event 1:2:3, truncated
+// after its EventID.
+constexpr char eventAuxiliary[] = {
+  0x40, 0, 0, 50, 0, 11,                            // EventAuxiliary
+  0x40, 0, 0, 19, 0, 10,                            // processHistoryID
+  16, 'p', 'p', 'p', 'p', 'p', 'p', 'p', 'p',
+      'p', 'p', 'p', 'p', 'p', 'p', 'p', 'p',
+  0x40, 0, 0, 18, 0, 11,                            // id_
+  0, 0, 0, 1,                                       // run
+  0, 0, 0, 2,                                       // luminosityBlock
+  0, 0, 0, 0, 0, 0, 0, 3                            // event
+};
+
+int
+main(int argc, char **argv)
+{
+  EventId id;
+  assert(decodeEventAuxiliary(eventAuxiliary, id));
+  assert(id.run == 1 && id.lumi == 2 && id.event == 3);
+
+  assert(parseEventId("1:2:3", id));
+  assert(id.run == 1 && id.lumi == 2 && id.event == 3);
+  assert(!parseEventId("1:2", id));
+  assert(!parseEventId("1:2:3x", id));
+
+  EventIndex index;
+  for (uint64_t i = 0; i < 100; ++i)
+  {
+    EventId event = {1, (uint32_t)(1 + (i % 7)), (99 - i) * 3};
+    index.add(event, i);
+  }
+  index.sort();
+  for (size_t i = 1; i < index.items.size(); ++i)
+    assert(index.items[i - 1].id < index.items[i].id);
+  EventId some = {1, 1 + (42 % 7), (99 - 42) * 3};
+  assert(index.find(some) == 42);
+  EventId missing = {1, 1, 1};
+  assert(index.find(missing) == -1);
+}
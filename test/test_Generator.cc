@@ -0,0 +1,90 @@
+#include "GeneratorHelpers.h"
+#include "CompressionHelpers.h"
+#include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
+// Read back all the objects of @a path, and check that they give the
+// Merkle tree written with it.
+void check(char const *path, GeneratorOptions const &options, MerkleTree const &manifest, bool big)
+{
+  int fd = open(path, O_RDONLY);
+  assert(fd >= 0);
+  char header[64];
+  bool read = preadAll(fd, header, sizeof(header), 0);
+  assert(read);
+  assert((getInt(fileHeaderSpec, header, "fVersion") >= 1000000) == big);
+  assert(fileHeaderSeek(header, "fEND") == (size_t) lseek(fd, 0, SEEK_END));
+
+  std::vector<KeyInfo> keys;
+  read = readKeys(fd, keys);
+  assert(read);
+  // The TFile key, the objects and the keys list.
+  assert(keys.size() == options.keys + 2);
+  assert(topDirectoryPosition(header, keys) > generatorBegin);
+  char record[64];
+  read = preadAll(fd, record, sizeof(record), topDirectoryPosition(header, keys));
+  assert(read);
+  assert((getShort(topDirSpec, record, "Version") > 1000) == big);
+
+  MerkleTree tree;
+  std::map<std::string, size_t> basketIndex;
+  std::vector<char> scratch;
+  size_t compressed = 0, baskets = 0;
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    if (merkleIgnored(keys[i]))
+      continue;
+    std::vector<char> object(keys[i].objLen);
+    read = readKey(fd, keys[i], scratch, &object[0]);
+    assert(read);
+    compressed += keys[i].compression[0] != 0;
+    baskets += keys[i].className == "TBasket";
+    unsigned char digest[SHA1_SIZE];
+    sha1(&object[0], object.size(), digest);
+    tree.addLeaf(merkleLeaf(keys[i], "", basketIndex[keys[i].title + "/" + keys[i].name]++), digestToHex(digest));
+  }
+  tree.update();
+  assert(tree.digests == manifest.digests);
+  assert(compressed > 0 && compressed < options.keys);
+  assert(baskets > 0 && baskets < options.keys);
+  close(fd);
+}
+
+int
+main(int argc, char **argv)
+{
+  char path[] = "/tmp/test_GeneratorXXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  // Small chunks, so that most compressed objects have several of them.
+  GeneratorOptions options = generatorDefaults;
+  options.keys = 200;
+  options.zlib = 0.4;
+  options.lzma = 0.3;
+  options.chunk = 4096;
+  MerkleTree manifest;
+  bool generated = generateFile(path, options, manifest);
+  assert(generated);
+  check(path, options, manifest, false);
+
+  // The same options give the same file.
+  MerkleTree again;
+  generated = generateFile(path, options, again);
+  assert(generated);
+  assert(again.digests[merkleRoot] == manifest.digests[merkleRoot]);
+
+  // Big headers everywhere, and a different seed.
+  options.big = true;
+  options.seed = 2;
+  MerkleTree big;
+  generated = generateFile(path, options, big);
+  assert(generated);
+  check(path, options, big, true);
+  assert(big.digests[merkleRoot] != manifest.digests[merkleRoot]);
+
+  unlink(path);
+  return 0;
+}
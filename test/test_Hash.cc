@@ -0,0 +1,67 @@
+#include "HashHelpers.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+// Check the entry kernel of @a level against fastHash64, for entries of all
+// sizes up to a few stripes, next to each other in a mixed order, so that
+// the lanes of a vector finish at different times.
+void checkKernel(SimdLevel level)
+{
+  EntryHashKernel kernel = entryHashKernel(level);
+  std::vector<char> payload(20000);
+  for (size_t i = 0; i < payload.size(); ++i)
+    payload[i] = i * 31 + i / 251;
+  std::vector<std::pair<size_t, size_t> > ranges;
+  size_t offset = 1;
+  for (size_t size = 0; size < 150; ++size)
+  {
+    size_t mixed = size % 2 ? 150 - size : size;
+    ranges.push_back(std::make_pair(offset, offset + mixed));
+    offset += mixed;
+  }
+  for (size_t count = 0; count <= ranges.size(); count += 1 + count / 4)
+  {
+    std::vector<uint64_t> digests(count + 1, 42);
+    kernel(payload.data(), ranges.data(), count, digests.data());
+    for (size_t e = 0; e < count; ++e)
+      assert(digests[e] == fastHash64(&payload[ranges[e].first], ranges[e].second - ranges[e].first));
+    assert(digests[count] == 42);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+    checkKernel((SimdLevel) level);
+
+  // Entries are loaded in order; those out of it, or which do not parse,
+  // are rejected rather than making room for them.
+  char path[] = "/tmp/test_HashXXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  FILE *f = fopen(path, "w");
+  fprintf(f, "Hash for entry br:0: 000000000000000a\n"
+             "Hash for entry br:1: 000000000000000b\n"
+             "Hash for entry br:4000000000: 000000000000000c\n"
+             "Hash for entry br:x: 000000000000000c\n"
+             "Hash for entry br:2: zz\n"
+             "Hash for entry other:1: 000000000000000d\n"
+             "Hash for entry a:b:0: 000000000000000e\n"
+             "Something else\n");
+  fclose(f);
+  std::map<std::string, std::vector<uint64_t> > branches;
+  size_t rejected;
+  bool loaded = loadEntryDigests(path, "Hash for entry ", branches, rejected);
+  assert(loaded && rejected == 4);
+  assert(branches.size() == 2 && branches["br"].size() == 2 && branches["br"][1] == 0xb);
+  assert(branches["a:b"].size() == 1 && branches["a:b"][0] == 0xe);
+  unlink(path);
+  loaded = loadEntryDigests(path, "Hash for entry ", branches, rejected);
+  assert(!loaded);
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "HistogramHelpers.h"
+#include <vector>
+
+void appendVersioned(std::vector<char> &out, short version, std::vector<char> const &body)
+{
+  unsigned int byteCount = 0x40000000 | (body.size() + 2);
+  char header[6] = {(char)(byteCount >> 24), (char)(byteCount >> 16), (char)(byteCount >> 8), (char) byteCount,
+                    (char)(version >> 8), (char) version};
+  out.insert(out.end(), header, header + 6);
+  out.insert(out.end(), body.begin(), body.end());
+}
+
+template <class T>
+void appendBigEndian(std::vector<char> &out, T value)
+{
+  char bytes[sizeof(T)];
+  memcpy(bytes, &value, sizeof(T));
+  for (size_t i = 0; i < sizeof(T); ++i)
+    out.push_back(bytes[sizeof(T) - 1 - i]);
+}
+
+// A streamed TH1F with 4 cells.
+std::vector<char> makeTH1F(float const *contents)
+{
+  std::vector<char> opaque(10, 0);
+  std::vector<char> th1;
+  for (int i = 0; i < 4; ++i)       // TNamed, TAttLine, TAttFill, TAttMarker
+    appendVersioned(th1, 1, opaque);
+  appendBigEndian(th1, (int) 4);    // fNcells
+  for (int i = 0; i < 3; ++i)       // The axes
+    appendVersioned(th1, 10, opaque);
+  appendBigEndian(th1, (short) 0);
+  appendBigEndian(th1, (short) 1000);
+  appendBigEndian(th1, 12.);        // fEntries
+  for (int i = 0; i < 7; ++i)
+    appendBigEndian(th1, 1.);
+  appendBigEndian(th1, (int) 0);    // fContour
+  appendBigEndian(th1, (int) 0);    // fSumw2
+  th1.insert(th1.end(), 9, 0);      // fOption, fFunctions, fBufferSize
+  std::vector<char> th1f;
+  appendVersioned(th1f, 8, th1);
+  appendBigEndian(th1f, (int) 4);
+  for (int i = 0; i < 4; ++i)
+    appendBigEndian(th1f, contents[i]);
+  std::vector<char> result;
+  appendVersioned(result, 3, th1f);
+  return result;
+}
+
+int
+main(int argc, char **argv)
+{
+  assert(isHistogramClass("TH1F") && isHistogramClass("TH2D") && isHistogramClass("TProfile"));
+  assert(!isHistogramClass("TH1K") && !isHistogramClass("TTree"));
+
+  float contents[4] = {0.f, 1.f, 2.5f, 0.f};
+  std::vector<char> streamed = makeTH1F(contents);
+  Histogram histogram;
+  decodeHistogram("TH1F", &streamed[0], streamed.size(), histogram);
+  assert(histogram.ncells == 4);
+  assert(histogram.entries == 12.);
+  assert(histogram.contents.size() == 4 && histogram.contents[2] == 2.5);
+  assert(histogram.sumw2.empty() && histogram.binEntries.empty());
+
+  bool thrown = false;
+  try
+  {
+    decodeHistogram("TH1F", &streamed[0], streamed.size() - 1, histogram);
+  }
+  catch (char const *)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  Tolerance exact = {0, 0, 0};
+  assert(ulpDistance(1., nextafter(1., 2.), false) == 1);
+  assert(ulpDistance(-0., 0., false) == 1);
+  assert(ulpDistance(1., nextafter(1., 2.), true) == 0);
+  assert(withinTolerance(NAN, NAN, exact, false));
+  assert(!withinTolerance(HUGE_VAL, 1., Tolerance{0, 1, 0}, false));
+
+  // All the kernels agree with the scalar one.
+  std::vector<double> a(103), b(103);
+  for (size_t i = 0; i < a.size(); ++i)
+    a[i] = b[i] = i * 0.5;
+  b[7] = nextafter(b[7], 100.);
+  b[50] += 1e-3;
+  b[101] = NAN;
+  Tolerance ulps = {0, 0, 1};
+  Tolerance relative = {0, 1e-2, 0};
+  for (int level = SIMD_SCALAR; level <= bestSimdLevel(); ++level)
+  {
+    CompareKernel kernel = compareKernel((SimdLevel) level);
+    size_t first;
+    assert(kernel(&a[0], &b[0], a.size(), exact, false, first) == 3 && first == 7);
+    assert(kernel(&a[0], &b[0], a.size(), ulps, false, first) == 2 && first == 50);
+    assert(kernel(&a[0], &b[0], a.size(), relative, false, first) == 1 && first == 101);
+  }
+
+  Histogram reference = histogram;
+  assert(compareHistograms(histogram, reference, exact).empty());
+  reference.contents[1] = 1.5;
+  assert(!compareHistograms(histogram, reference, exact).empty());
+
+  // The statistics sums are compared with the same tolerance.
+  reference = histogram;
+  reference.stats[2] = histogram.stats[2] * (1 + 1e-6);
+  assert(compareHistograms(histogram, reference, exact).find("fTsumwx ") == 0);
+  assert(compareHistograms(histogram, reference, relative).empty());
+}
@@ -0,0 +1,147 @@
+#include "BrutNodes.h"
+#include "GeneratorHelpers.h"
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Parse @a path as the shell would for a command ending with the node
+// @a done, preceded by a basket scan if @a baskets, with the @a argument of
+// the command, and return the output.
+std::string parse(char const *path, NodeType done, bool baskets, char const *argument = "")
+{
+  FILE *out = tmpfile();
+  assert(out);
+  BasketScan basketScan;
+  KeyCatalog catalog;
+  EventIndex events;
+  basketScan.argument = argument;
+  int fd = open(path, O_RDONLY);
+  assert(fd >= 0);
+  ParserContext context = {0, -1, fd, &basketScan, {0, 0, 0}, path, &catalog, &events, out,
+                           {0, 0, defaultWindowSize}, false};
+  std::vector<ParserState> states;
+  states.push_back({0, PREPARE_TO_QUIT, 0});
+  states.push_back({0, done, 0});
+  if (baskets)
+    states.push_back({0, IN_SCAN_BASKETS, 0});
+  bool parsed = runParser(states, context);
+  assert(parsed && context.quit && states.empty());
+  unmapWindow(context.window);
+  close(fd);
+
+  std::string text(ftell(out), 0);
+  rewind(out);
+  size_t read = fread(&text[0], 1, text.size(), out);
+  assert(read == text.size());
+  fclose(out);
+  return text;
+}
+
+struct Outputs {
+  std::string keys;
+  std::string hashes;
+  std::string merkle;
+};
+
+void parseAll(char const *path, Outputs &outputs)
+{
+  outputs.keys = parse(path, IN_STREAM_FILE, false);
+  outputs.hashes = parse(path, IN_HASH_FILE, false);
+  outputs.merkle = parse(path, IN_MERKLE_DONE, true);
+}
+
+int
+main(int argc, char **argv)
+{
+  char paths[2][32] = {"/tmp/test_ParserXXXXXX", "/tmp/test_ParserXXXXXX"};
+  MerkleTree manifests[2];
+  for (int f = 0; f < 2; ++f)
+  {
+    int fd = mkstemp(paths[f]);
+    assert(fd >= 0);
+    close(fd);
+    GeneratorOptions options = generatorDefaults;
+    options.keys = 300;
+    options.seed = f + 1;
+    options.big = f == 1;
+    bool generated = generateFile(paths[f], options, manifests[f]);
+    assert(generated);
+  }
+
+  // One file at a time, as the shell does.
+  Outputs serial[2];
+  for (int f = 0; f < 2; ++f)
+  {
+    parseAll(paths[f], serial[f]);
+    assert(serial[f].keys.find("Ignoring") != std::string::npos);
+    std::string root = std::string(merklePrefix) + merkleRoot + ": " + manifests[f].digests[merkleRoot] + "\n";
+    assert(serial[f].merkle.compare(0, root.size(), root) == 0);
+  }
+  assert(serial[0].hashes != serial[1].hashes);
+
+  // A file has the same metadata as itself, including the keys sharing the
+  // name and cycle of the TFile key.
+  for (int f = 0; f < 2; ++f)
+  {
+    std::string meta = parse(paths[f], IN_COMPARE_META_DONE, false, paths[f]);
+    assert(meta == "304 compared, 0 differ.\n");
+  }
+  std::string meta = parse(paths[0], IN_COMPARE_META_DONE, false, paths[1]);
+  assert(meta.find(" 0 differ.") == std::string::npos);
+
+  // Both kinds of file headers are canonicalized, but never in place.
+  for (int f = 0; f < 2; ++f)
+  {
+    std::string copy = std::string(paths[f]) + ".canonical";
+    std::string canonical = parse(paths[f], IN_CANONICALIZE_DONE, false, copy.c_str());
+    assert(canonical.find(" fields zeroed in ") != std::string::npos);
+    char header[fileHeaderBigSize];
+    int fd = open(copy.c_str(), O_RDONLY);
+    size_t headerSize = readFileHeader(fd, header);
+    assert(headerSize == (f ? fileHeaderBigSize : fileHeaderSmallSize));
+    assert(std::string(header + headerSize - 18, 18) == std::string(18, 0));
+    close(fd);
+    unlink(copy.c_str());
+    canonical = parse(paths[f], IN_CANONICALIZE_DONE, false, paths[f]);
+    assert(canonical == std::string(paths[f]) + " is the file itself.\n");
+  }
+
+  // Both files at the same time, each parser with its own context and its
+  // own output, gives the same results.
+  for (int round = 0; round < 4; ++round)
+  {
+    Outputs concurrent[2];
+    std::vector<std::thread> threads;
+    for (int f = 0; f < 2; ++f)
+      threads.push_back(std::thread([&paths, &concurrent, f] { parseAll(paths[f], concurrent[f]); }));
+    for (size_t t = 0; t < threads.size(); ++t)
+      threads[t].join();
+    for (int f = 0; f < 2; ++f)
+    {
+      assert(concurrent[f].keys == serial[f].keys);
+      assert(concurrent[f].hashes == serial[f].hashes);
+      assert(concurrent[f].merkle == serial[f].merkle);
+    }
+  }
+
+  // A file which cannot be mapped is reported to the output of its parser,
+  // which gives up rather than exiting.
+  FILE *out = tmpfile();
+  BasketScan basketScan;
+  KeyCatalog catalog;
+  EventIndex events;
+  ParserContext context = {0, -1, -1, &basketScan, {0, 0, 0}, "missing", &catalog, &events, out,
+                           {0, 0, defaultWindowSize}, false};
+  std::vector<ParserState> states;
+  states.push_back({0, IN_STREAM_FILE, 0});
+  bool parsed = runParser(states, context);
+  assert(!parsed && states.empty());
+  assert(ftell(out) == (long) strlen("File error.\n"));
+  fclose(out);
+
+  for (int f = 0; f < 2; ++f)
+    unlink(paths[f]);
+  return 0;
+}
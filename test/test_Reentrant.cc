@@ -0,0 +1,93 @@
+#include "BrutHeaders.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr FieldSpec SomeSpec[] = {
+  {fixed_size(4), "anInt", false, METADATA, SCALAR},
+  {zero_delimited(), "aString", false, METADATA, STRING},
+  {fixed_size(8), "someBytes", false, METADATA, HEX},
+  LAST_FIELD
+};
+
+char const someBuffer[] = "\x2a\x00\x00\x00" "brut\x00" "\x01\x02\x03\x04\x05\x06\x07\x08";
+
+// Print @a buffer to a temporary file, as a node would, and read it back.
+std::string printed(char const *buffer)
+{
+  FILE *f = tmpfile();
+  assert(f);
+  printBuf(SomeSpec, buffer, 0, f);
+  dump_hex(buffer, sizeof(someBuffer) - 1, 0, -1, f);
+  std::string text(ftell(f), 0);
+  rewind(f);
+  size_t read = fread(&text[0], 1, text.size(), f);
+  assert(read == text.size());
+  fclose(f);
+  return text;
+}
+
+int
+main(int argc, char **argv)
+{
+  // Errors only point to literals, so they can be looked at once the stack
+  // of the function which threw them is gone.
+  try
+  {
+    getInt(SomeSpec, someBuffer, "missing");
+    assert(false);
+  }
+  catch (ParseError const &error)
+  {
+    assert(strcmp(error.error_, "Field not found") == 0);
+    assert(strcmp(error.where_, "missing") == 0);
+  }
+  try
+  {
+    getString(SomeSpec, someBuffer, "missingString");
+    assert(false);
+  }
+  catch (ParseError const &error)
+  {
+    assert(strcmp(error.error_, "Field not found") == 0);
+    assert(strcmp(error.where_, "missingString") == 0);
+  }
+
+  // Many threads parsing and failing at the same time each get their own
+  // error and write their own output.
+  std::string reference = printed(someBuffer);
+  assert(reference.find("\"anInt\": 42,\n") != std::string::npos);
+  assert(reference.find("\"aString\": \"brut\",\n") != std::string::npos);
+  std::vector<std::string> outputs(8);
+  std::vector<int> errors(outputs.size(), 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < outputs.size(); ++t)
+    threads.push_back(std::thread([&outputs, &errors, t] {
+      char const *labels[] = {"missing", "notThere", "gone"};
+      for (int i = 0; i < 300; ++i)
+      {
+        char const *label = labels[(t + i) % 3];
+        try
+        {
+          getInt(SomeSpec, someBuffer, label);
+        }
+        catch (ParseError const &error)
+        {
+          errors[t] += error.where_ == label && strcmp(error.error_, "Field not found") == 0;
+        }
+        assert(getInt(SomeSpec, someBuffer, "anInt") == 42);
+      }
+      outputs[t] = printed(someBuffer);
+    }));
+  for (size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+  for (size_t t = 0; t < outputs.size(); ++t)
+  {
+    assert(errors[t] == 300);
+    assert(outputs[t] == reference);
+  }
+  return 0;
+}
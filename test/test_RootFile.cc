@@ -0,0 +1,84 @@
+#include "RootFile.h"
+#include "GeneratorHelpers.h"
+#include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
+int
+main(int argc, char **argv)
+{
+  char path[] = "/tmp/test_RootFileXXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  GeneratorOptions options = generatorDefaults;
+  options.keys = 100;
+  options.chunk = 8192;
+  MerkleTree manifest;
+  bool generated = generateFile(path, options, manifest);
+  assert(generated);
+
+  brut::RootFile file;
+  bool opened = file.open("/nonexistent.root");
+  assert(!opened && !file.error().empty());
+  opened = file.open(argv[0]);
+  assert(!opened && !file.error().empty());
+  opened = file.open(path);
+  assert(opened);
+
+  // The same keys, in the same order, as readKeys.
+  fd = open(path, O_RDONLY);
+  std::vector<KeyInfo> keys;
+  bool read = readKeys(fd, keys);
+  assert(read);
+  close(fd);
+  assert(file.size() == keys.size());
+  size_t i = 0;
+  for (brut::Key const &key : file)
+  {
+    assert(key.offset == keys[i].seekKey && key.nbytes == keys[i].nbytes && key.objLen == keys[i].objLen);
+    assert(key.className.str() == keys[i].className && key.name.str() == keys[i].name);
+    assert(key.title.str() == keys[i].title && key.directory == "");
+    assert(key.compressed() == (keys[i].compression[0] != 0));
+    ++i;
+  }
+  assert(file[0].className == "TFile" && file[0].className != "TKey");
+
+  // Payloads and digests give the tree of the generator.
+  MerkleTree tree;
+  std::map<std::string, size_t> basketIndex;
+  std::vector<char> payload;
+  for (size_t k = 0; k < keys.size(); ++k)
+  {
+    if (merkleIgnored(keys[k]))
+      continue;
+    read = file.read(file[k], payload);
+    assert(read && payload.size() == keys[k].objLen);
+    unsigned char digest[SHA1_SIZE];
+    sha1(&payload[0], payload.size(), digest);
+    tree.addLeaf(merkleLeaf(keys[k], "", basketIndex[keys[k].title + "/" + keys[k].name]++), digestToHex(digest));
+  }
+  tree.update();
+  assert(tree.digests == manifest.digests);
+
+  size_t calls = 0;
+  MerkleTree hashed;
+  basketIndex.clear();
+  size_t failed = file.hash([&](brut::Key const &key, unsigned char const *digest) {
+    assert(digest && key.offset == keys[calls].seekKey);
+    if (!merkleIgnored(keys[calls]))
+      hashed.addLeaf(merkleLeaf(keys[calls], "", basketIndex[keys[calls].title + "/" + keys[calls].name]++),
+                     digestToHex(digest));
+    ++calls;
+  });
+  assert(failed == 0 && calls == keys.size());
+  hashed.update();
+  assert(hashed.digests == manifest.digests);
+
+  brut::Key key = file[1];
+  file.close();
+  read = file.read(key, payload);
+  assert(file.size() == 0 && !read);
+  unlink(path);
+  return 0;
+}
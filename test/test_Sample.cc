@@ -0,0 +1,45 @@
+#include "SampleHelpers.h"
+#include <cassert>
+#include <set>
+#include <vector>
+
+int
+main(int argc, char **argv)
+{
+  std::vector<SampleCandidate> candidates;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "basket%lu", i);
+    SampleCandidate candidate = {sampleStratum("TBasket", 1000), sampleRank(name, 42), 1000};
+    candidates.push_back(candidate);
+  }
+  SampleCandidate rare = {sampleStratum("TH1F", 100000), sampleRank("histogram", 42), 100000};
+  candidates.push_back(rare);
+
+  // The budget is respected, but every stratum is sampled.
+  std::vector<size_t> selected;
+  selectSample(candidates, 150000, selected);
+  assert(selected.size() == 51);
+  assert(selected.back() == candidates.size() - 1);
+  std::set<size_t> unique(selected.begin(), selected.end());
+  assert(unique.size() == selected.size());
+
+  // The same seed selects the same objects, another one different ones.
+  std::vector<size_t> again;
+  selectSample(candidates, 150000, again);
+  assert(again == selected);
+  for (size_t i = 0; i + 1 < candidates.size(); ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "basket%lu", i);
+    candidates[i].rank = sampleRank(name, 43);
+  }
+  std::vector<size_t> other;
+  selectSample(candidates, 150000, other);
+  assert(other.size() == selected.size() && other != selected);
+
+  assert(sampleStratum("TBasket", 1000) != sampleStratum("TBasket", 3000));
+  assert(sampleBound(0) == 1);
+  assert(sampleBound(300) > 0.009 && sampleBound(300) < 0.011);
+}
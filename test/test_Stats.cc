@@ -0,0 +1,44 @@
+#include "StatsHelpers.h"
+#include "ThreadHelpers.h"
+#include <cassert>
+#include <cstring>
+
+int
+main(int argc, char **argv)
+{
+  StatsSnapshot snapshot;
+  statsSnapshot(snapshot);
+  assert(snapshot.counters[STAT_BYTES_HASHED] == 0);
+
+  // Counts from many threads, several times so that blocks are reused,
+  // all end up in the snapshot.
+  for (int round = 0; round < 4; ++round)
+    parallelFor(1000, [](size_t i, unsigned) {
+      statsAdd(STAT_BYTES_HASHED, i);
+      statsAdd(STAT_KEYS_VISITED, 1);
+    });
+  statsSnapshot(snapshot);
+  assert(snapshot.counters[STAT_BYTES_HASHED] == 4 * 999 * 1000 / 2);
+  assert(snapshot.counters[STAT_KEYS_VISITED] == 4000);
+  for (unsigned i = 0; i < statsMaxThreads - 1; ++i)
+    assert(!statsCounters().blocks[i].used || i == 0);
+
+  statsStage(3, 1500);
+  statsStage(3, 500);
+  statsStage(statsMaxStages, 1);
+  char const *labels[statsMaxStages] = {0};
+  labels[3] = "streamKey";
+  statsSnapshot(snapshot);
+  char buffer[4096];
+  size_t length = statsFormat(snapshot, labels, buffer, sizeof(buffer));
+  assert(length == strlen(buffer));
+  assert(strstr(buffer, "Stat keys visited: 4000\n"));
+  assert(strstr(buffer, "Stat stage streamKey: 2 nodes, 2000 ns\n"));
+
+  // Formatting never writes past the buffer.
+  char small[16];
+  length = statsFormat(snapshot, labels, small, sizeof(small));
+  assert(length == sizeof(small) - 1);
+  assert(strcmp(small, "Stat windows ma") == 0);
+  return 0;
+}
@@ -0,0 +1,41 @@
+#include "SummaryHelpers.h"
+#include <vector>
+
+int
+main(int argc, char **argv)
+{
+  std::vector<float> floats;
+  for (int i = 0; i < 37; ++i)
+    floats.push_back(i - 10.5f);
+  floats[3] = NAN;
+  floats[20] = HUGE_VALF;
+  floats[36] = -HUGE_VALF;
+
+  Summary summary = emptySummary();
+  summarizeValues(&floats[0], floats.size(), summary);
+  Summary scalar = emptySummary();
+  summarizeScalar(&floats[0], floats.size(), scalar);
+  assert(summary.count == 37 && summary.nans == 1 && summary.infs == 2);
+  assert(summary.min == -10.5 && summary.max == 24.5);
+  assert(summary.min == scalar.min && summary.max == scalar.max && summary.sum == scalar.sum);
+
+  std::vector<double> doubles(floats.begin(), floats.end());
+  Summary fromDoubles = emptySummary();
+  summarizeValues(&doubles[0], doubles.size(), fromDoubles);
+  assert(fromDoubles.sum == summary.sum && fromDoubles.nans == 1 && fromDoubles.infs == 2);
+
+  // Partials merge to the same result.
+  Summary merged = emptySummary();
+  Summary first = emptySummary();
+  Summary second = emptySummary();
+  summarizeValues(&doubles[0], 10, first);
+  summarizeValues(&doubles[10], doubles.size() - 10, second);
+  mergeSummary(merged, first);
+  mergeSummary(merged, second);
+  assert(merged.count == 37 && merged.min == -10.5 && merged.max == 24.5 && merged.sum == summary.sum);
+
+  int32_t ints[3] = {-3, 7, 2};
+  Summary intSummary = emptySummary();
+  summarize(columnType(columnTypes, "int32"), (char const *) ints, 3, intSummary);
+  assert(intSummary.min == -3 && intSummary.max == 7 && intSummary.sum == 6);
+}
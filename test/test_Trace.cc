@@ -0,0 +1,76 @@
+#include "TraceHelpers.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Write the trace to a temporary file and read it back in @a text.
+void writeTrace(std::string &text, uint64_t &events, uint64_t &dropped)
+{
+  FILE *f = tmpfile();
+  assert(f);
+  bool written = traceWrite(f, events, dropped);
+  assert(written);
+  text.resize(ftell(f));
+  rewind(f);
+  size_t read = fread(&text[0], 1, text.size(), f);
+  assert(read == text.size());
+  fclose(f);
+}
+
+size_t count(std::string const &text, char const *what)
+{
+  size_t n = 0;
+  for (size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1))
+    ++n;
+  return n;
+}
+
+int
+main(int argc, char **argv)
+{
+  std::string text;
+  uint64_t events, dropped;
+
+  // Nothing is recorded unless tracing.
+  {
+    TraceSpan span("ignored", 0);
+  }
+  traceStart();
+  {
+    TraceSpan span("main", 42);
+  }
+  // Each thread records in its own ring.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.push_back(std::thread([] {
+      for (int i = 0; i < 100; ++i)
+        TraceSpan span("work", i);
+    }));
+  for (size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+  traceStop();
+  {
+    TraceSpan span("ignored", 0);
+  }
+  writeTrace(text, events, dropped);
+  assert(events == 401 && dropped == 0);
+  assert(count(text, "\"ph\": \"X\"") == 401);
+  assert(count(text, "\"name\": \"work\"") == 400);
+  assert(count(text, "ignored") == 0);
+  assert(text.find("{\"name\": \"main\", \"cat\": \"brut\", \"ph\": \"X\", \"pid\": 1, \"tid\": 0,") != std::string::npos);
+  assert(text.find("\"args\": {\"arg\": 42}}") != std::string::npos);
+  assert(text.compare(text.size() - 4, 4, "\n]}\n") == 0);
+
+  // Once full, rings keep the latest events.
+  traceStart();
+  for (size_t i = 0; i < traceRingSize + 10; ++i)
+    TraceSpan span("many", i);
+  traceStop();
+  writeTrace(text, events, dropped);
+  assert(events == traceRingSize && dropped == 10);
+  assert(text.find("\"args\": {\"arg\": 9}}") == std::string::npos);
+  assert(text.find("\"args\": {\"arg\": 10}}") != std::string::npos);
+  return 0;
+}